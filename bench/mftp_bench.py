@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""Deterministic MiniFTP regression benchmarks.
+
+Runs the main scenario at several scales with fixed seeds, collects the
+BENCH line it prints with --bench, and compares the results with a stored
+baseline.  Run from the top of the ns-3 tree, with this directory in
+scratch/:
+
+    scratch/ECE547/bench/mftp_bench.py                    # compare
+    scratch/ECE547/bench/mftp_bench.py --update-baseline  # record
+
+Exits non-zero if any metric regressed by more than --threshold.
+"""
+
+import argparse
+import csv
+import os
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# every scenario runs with the same seed and run number
+SCALES = [10, 100, 1000]
+FILE_SETS = [("small", ["--fileSet=small", "--lifetime=1"]),
+             ("large", ["--fileSet=large", "--lifetime=15"])]
+MODES = [("serial", ["--pipeline=1"]),
+         ("pipelined", ["--pipeline=6"])]
+
+# metric -> True if larger is better
+METRICS = {
+    "wall_s": False,
+    "events_per_s": True,
+    "peak_rss_kb": False,
+    "mean_latency_ms": False,
+    "p99_completion_s": False,
+    "mean_completion_s": False,
+}
+
+FIELDS = ["scenario"] + sorted(METRICS) + ["events", "replies", "clients_finished"]
+
+
+def scenarios():
+    for n in SCALES:
+        for set_name, set_args in FILE_SETS:
+            for mode_name, mode_args in MODES:
+                name = "n%d-%s-%s" % (n, set_name, mode_name)
+                args = ["--numNodes=%d" % n, "--verbose=0", "--tracing=none",
+                        "--bench", "--seed=1", "--run=1"] + set_args + mode_args
+                yield name, args
+
+
+def run(program, args):
+    cmd = ["./waf", "--run", "%s %s" % (program, " ".join(args))]
+    out = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                         universal_newlines=True, check=True).stdout
+    for line in out.splitlines():
+        if line.startswith("BENCH "):
+            return dict(kv.split("=", 1) for kv in line.split()[1:])
+    raise RuntimeError("no BENCH line from: %s" % " ".join(cmd))
+
+
+def load(path):
+    with open(path) as f:
+        return {row["scenario"]: row for row in csv.DictReader(f)}
+
+
+def save(path, rows):
+    with open(path, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS, extrasaction="ignore")
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+
+def compare(current, baseline, threshold):
+    regressions = 0
+    for row in current:
+        base = baseline.get(row["scenario"])
+        if base is None:
+            print("%-28s no baseline" % row["scenario"])
+            continue
+        for metric, higher_is_better in sorted(METRICS.items()):
+            old = float(base[metric])
+            new = float(row[metric])
+            if old == 0:
+                continue
+            change = (new - old) / old
+            worse = -change if higher_is_better else change
+            flag = ""
+            if worse > threshold:
+                flag = "  REGRESSION"
+                regressions += 1
+            print("%-28s %-18s %12.4g -> %12.4g  %+6.1f%%%s"
+                  % (row["scenario"], metric, old, new, 100 * change, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--program", default="ECE547",
+                        help="waf program name of the scenario (default: %(default)s)")
+    parser.add_argument("--baseline", default=os.path.join(HERE, "baseline.csv"))
+    parser.add_argument("--results", default="mftp_bench_results.csv")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative change counted as a regression (default: %(default)s)")
+    parser.add_argument("--filter", default="",
+                        help="only run scenarios whose name contains this string")
+    parser.add_argument("--update-baseline", action="store_true")
+    opts = parser.parse_args()
+
+    rows = []
+    for name, args in scenarios():
+        if opts.filter not in name:
+            continue
+        print("running %s" % name, file=sys.stderr)
+        row = run(opts.program, args)
+        row["scenario"] = name
+        rows.append(row)
+    save(opts.results, rows)
+
+    if opts.update_baseline:
+        save(opts.baseline, rows)
+        print("baseline written to %s" % opts.baseline)
+        return 0
+    if not os.path.exists(opts.baseline):
+        print("no baseline at %s; record one with --update-baseline" % opts.baseline)
+        return 0
+    return 1 if compare(rows, load(opts.baseline), opts.threshold) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
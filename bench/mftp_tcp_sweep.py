@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""Sweep TCP congestion control and socket buffer sizes for MiniFTP.
+
+Runs the main scenario with the large file set (1, 4, 16 and 64 KiB
+bodies) for every TCP variant and buffer size, and for the reliable
+datagram transport ("rdt", send buffer only), and tabulates reply
+latency and per-client completion times.  Run from the top of the ns-3
+tree, like mftp_bench.py:
+
+    scratch/ECE547/bench/mftp_tcp_sweep.py
+    scratch/ECE547/bench/mftp_tcp_sweep.py --variants TcpNewReno,TcpVegas --buffers 8192
+"""
+
+import argparse
+import csv
+import sys
+
+from mftp_bench import run
+
+VARIANTS = ["TcpNewReno", "TcpWestwood", "TcpVegas", "TcpHybla", "TcpHighSpeed",
+            "TcpScalable", "TcpVeno", "TcpBic", "TcpYeah", "TcpIllinois", "TcpHtcp",
+            "rdt"]
+# 0 keeps the TcpSocket default of 128 KiB
+BUFFERS = [4096, 16384, 65536, 0]
+
+FIELDS = ["variant", "buffer", "mean_latency_ms", "max_latency_ms",
+          "mean_completion_s", "p99_completion_s", "clients_finished",
+          "replies", "timeouts"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--program", default="ECE547",
+                        help="waf program name of the scenario (default: %(default)s)")
+    parser.add_argument("--variants", default=",".join(VARIANTS),
+                        help="comma separated TcpCongestionOps names")
+    parser.add_argument("--buffers", default=",".join(str(b) for b in BUFFERS),
+                        help="comma separated send and receive buffer sizes, 0 for default")
+    parser.add_argument("--numNodes", type=int, default=10)
+    parser.add_argument("--pipeline", type=int, default=1)
+    parser.add_argument("--results", default="mftp_tcp_sweep.csv")
+    opts = parser.parse_args()
+
+    rows = []
+    for variant in opts.variants.split(","):
+        for buf in [int(b) for b in opts.buffers.split(",")]:
+            print("running %s buffer=%d" % (variant, buf), file=sys.stderr)
+            args = ["--numNodes=%d" % opts.numNodes, "--pipeline=%d" % opts.pipeline,
+                    "--fileSet=large", "--lifetime=15", "--verbose=0",
+                    "--tracing=none", "--bench", "--seed=1", "--run=1",
+                    "--sndBuf=%d" % buf, "--rcvBuf=%d" % buf]
+            if variant == "rdt":
+                args.append("--transport=rdt")
+            else:
+                args.append("--tcpVariant=ns3::%s" % variant)
+            row = run(opts.program, args)
+            row["variant"] = variant
+            row["buffer"] = buf if buf else "default"
+            rows.append(row)
+
+    with open(opts.results, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS, extrasaction="ignore")
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+    print("%-14s %8s %12s %12s %12s %9s" % ("variant", "buffer", "latency_ms",
+                                             "completion_s", "p99_s", "finished"))
+    for row in sorted(rows, key=lambda r: float(r["mean_completion_s"])):
+        print("%-14s %8s %12.1f %12.2f %12.2f %5s/%-3s"
+              % (row["variant"], row["buffer"], float(row["mean_latency_ms"]),
+                 float(row["mean_completion_s"]), float(row["p99_completion_s"]),
+                 row["clients_finished"], row["clients"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+"""Measure MiniFTP over Wi-Fi access as stations per access point grow.
+
+Runs the main scenario with every client a station on an 802.11g
+access point, for each rate adaptation manager and number of stations
+per AP, and tabulates goodput and reply latency.  All clients start
+together so that each cell is as loaded as its station count makes it.
+Run from the top of the ns-3 tree, like mftp_bench.py:
+
+    scratch/ECE547/bench/mftp_wifi_sweep.py
+    scratch/ECE547/bench/mftp_wifi_sweep.py --managers Minstrel --stations 1,8,32
+"""
+
+import argparse
+import csv
+import sys
+
+from mftp_bench import run
+
+MANAGERS = ["Arf", "Aarf", "Minstrel", "Ideal", "ConstantRate"]
+STATIONS = [1, 2, 4, 8, 16]
+
+FIELDS = ["manager", "stations", "goodput_kbps", "mean_latency_ms", "max_latency_ms",
+          "mean_completion_s", "p99_completion_s", "clients_finished", "replies",
+          "timeouts"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--program", default="ECE547",
+                        help="waf program name of the scenario (default: %(default)s)")
+    parser.add_argument("--managers", default=",".join(MANAGERS),
+                        help="comma separated WifiRemoteStationManager names, without the suffix")
+    parser.add_argument("--stations", default=",".join(str(s) for s in STATIONS),
+                        help="comma separated stations per access point")
+    parser.add_argument("--aps", type=int, default=2, help="access points")
+    parser.add_argument("--distance", type=float, default=10,
+                        help="metres between each station and its access point")
+    parser.add_argument("--dataRate", default="100Mbps",
+                        help="data rate of the servers' segment, fast enough not to be the bottleneck")
+    parser.add_argument("--pipeline", type=int, default=1)
+    parser.add_argument("--results", default="mftp_wifi_sweep.csv")
+    opts = parser.parse_args()
+
+    rows = []
+    for manager in opts.managers.split(","):
+        for stations in [int(s) for s in opts.stations.split(",")]:
+            print("running %s stations=%d" % (manager, stations), file=sys.stderr)
+            args = ["--wifi", "--wifiManager=ns3::%sWifiManager" % manager,
+                    "--stationsPerAp=%d" % stations, "--numNodes=%d" % (stations * opts.aps),
+                    "--wifiDistance=%g" % opts.distance, "--dataRate=%s" % opts.dataRate,
+                    "--pipeline=%d" % opts.pipeline, "--interval=0",
+                    "--fileSet=large", "--lifetime=15", "--verbose=0",
+                    "--tracing=none", "--bench", "--seed=1", "--run=1"]
+            row = run(opts.program, args)
+            row["manager"] = manager
+            row["stations"] = stations
+            rows.append(row)
+
+    with open(opts.results, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS, extrasaction="ignore")
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+    print("%-13s %8s %12s %12s %12s %9s" % ("manager", "stations", "goodput_kbps",
+                                            "latency_ms", "p99_s", "finished"))
+    for row in rows:
+        print("%-13s %8d %12.1f %12.1f %12.2f %5s/%-3s"
+              % (row["manager"], row["stations"], float(row["goodput_kbps"]),
+                 float(row["mean_latency_ms"]), float(row["p99_completion_s"]),
+                 row["clients_finished"], row["clients"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+
+"""Compare fixed and adaptive server write sizes across link rates.
+
+Runs the main scenario with the large file set and pipelined,
+multiplexed clients, so small replies compete with bulk ones on every
+connection, for each data rate of the servers' segment and each write
+size policy, and tabulates reply latency, completion times and the
+number of writes the servers made.  Run from the top of the ns-3 tree,
+like mftp_bench.py:
+
+    scratch/ECE547/bench/mftp_write_sweep.py
+    scratch/ECE547/bench/mftp_write_sweep.py --rates 56Kbps,10Mbps --sizes 1040,adaptive
+"""
+
+import argparse
+import csv
+import sys
+
+from mftp_bench import run
+
+RATES = ["56Kbps", "1Mbps", "10Mbps", "100Mbps"]
+# fixed write sizes in bytes, or "adaptive"
+SIZES = ["536", "1040", "8192", "adaptive"]
+
+FIELDS = ["rate", "writes", "mean_latency_ms", "max_latency_ms",
+          "mean_completion_s", "p99_completion_s", "clients_finished",
+          "server_writes", "events", "wall_s"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--program", default="ECE547",
+                        help="waf program name of the scenario (default: %(default)s)")
+    parser.add_argument("--rates", default=",".join(RATES),
+                        help="comma separated data rates of the servers' segment")
+    parser.add_argument("--sizes", default=",".join(SIZES),
+                        help="comma separated write sizes in bytes, or adaptive")
+    parser.add_argument("--writeLatency", type=float, default=0.1,
+                        help="seconds one adaptive write may take to drain")
+    parser.add_argument("--numNodes", type=int, default=10)
+    parser.add_argument("--pipeline", type=int, default=6)
+    parser.add_argument("--results", default="mftp_write_sweep.csv")
+    opts = parser.parse_args()
+
+    rows = []
+    for rate in opts.rates.split(","):
+        for size in opts.sizes.split(","):
+            print("running %s writes=%s" % (rate, size), file=sys.stderr)
+            args = ["--numNodes=%d" % opts.numNodes, "--pipeline=%d" % opts.pipeline,
+                    "--multiplex", "--fileSet=large", "--lifetime=15", "--verbose=0",
+                    "--tracing=none", "--bench", "--seed=1", "--run=1",
+                    "--dataRate=%s" % rate]
+            if size == "adaptive":
+                args += ["--adaptiveWrites", "--writeLatency=%g" % opts.writeLatency]
+            else:
+                args.append("--packetSize=%s" % size)
+            row = run(opts.program, args)
+            row["rate"] = rate
+            row["writes"] = size
+            rows.append(row)
+
+    with open(opts.results, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS, extrasaction="ignore")
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+    print("%-9s %9s %12s %12s %12s %9s %10s" % ("rate", "writes", "latency_ms",
+                                                "completion_s", "p99_s", "finished",
+                                                "srv_writes"))
+    for row in rows:
+        print("%-9s %9s %12.1f %12.2f %12.2f %5s/%-3s %10s"
+              % (row["rate"], row["writes"], float(row["mean_latency_ms"]),
+                 float(row["mean_completion_s"]), float(row["p99_completion_s"]),
+                 row["clients_finished"], row["clients"], row["server_writes"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -16,22 +16,75 @@
 
 #include "mftp_server_helper.h"
 #include "mftp_client_helper.h"
+#include "mftp_proxy_helper.h"
 #include "mftp_client.h"
+#include "mftp_report.h"
+#include "mftp_trace.h"
+#include "mftp_counting_simulator.h"
+#include "mftp_sampler.h"
+#include "mftp_rdt.h"
+#include "mftp_checkpoint.h"
 #include "ns3/csma-helper.h"
 
-#include <list>
+#include <cmath>
 #include <fstream>
+#include <sstream>
+#include <vector>
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/stats-module.h"
+#include "ns3/tap-bridge-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mobility-module.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("main");
 
+namespace {
+
+/**
+ * \brief Make a version history of a text file, each version a few
+ * small edits away from the one before
+ * \param size bytes of the first version
+ * \param versions number of versions
+ * \param seed picks the words and the edits
+ * \return the versions, oldest first
+ */
+std::vector<std::string>
+MakeVersions (uint32_t size, uint32_t versions, uint32_t seed)
+{
+  static const char *words[] = { "alpha", "bravo", "charlie", "delta", "echo",
+                                 "foxtrot", "golf", "hotel", "india", "juliet" };
+  uint32_t x = seed * 2654435761u + 1;
+  std::string body;
+  while (body.size () < size)
+    {
+      x = x * 1103515245 + 12345;
+      body += words[(x >> 16) % 10];
+      body += ((x >> 8) % 8 == 0) ? '\n' : ' ';
+    }
+  body.resize (size);
+
+  std::vector<std::string> history (1, body);
+  for (uint32_t v = 1; v < versions; v++)
+    {
+      for (uint32_t e = 0; e < 3; e++)
+        {
+          x = x * 1103515245 + 12345;
+          uint32_t at = (x >> 8) % body.size ();
+          body.insert (at, "revised ");
+        }
+      history.push_back (body);
+    }
+  return history;
+}
+
+} // anonymous namespace
+
 int
 main (int argc, char *argv[])
 {
@@ -43,27 +96,251 @@ main (int argc, char *argv[])
   uint32_t nPackets = 1;
   
   bool verbose = true;
-  bool tracing = true;
+  std::string tracing = "full";
+  std::string traceFile = "project_4.mftp";
+  bool flowmon = false;
   bool useV6 = false;
+  uint32_t maxConnections = 0;
+  uint32_t maxActiveTransfers = 0;
+  uint32_t maxPending = 64;
+  uint32_t pipeline = 1;
+  std::string fileSet = "small";
+  double interval = 2.0;
+  double lifetime = 1.0;
+  std::string arrival = "staggered";
+  double arrivalRate = 0.5;
+  uint32_t seed = 1;
+  uint32_t run = 1;
+  bool bench = false;
+  bool memAudit = false;
+  bool emulate = false;
+  std::string tapName = "mftp0";
+  std::string emuTarget = "sim";
+  std::string tcpVariant = "";
+  uint32_t sndBuf = 0;
+  uint32_t rcvBuf = 0;
+  std::string transport = "tcp";
+  uint32_t rdtWindow = 16;
+  std::string rdtPacing = "0bps";
+  bool swarm = false;
+  bool delta = false;
+  bool multiplex = false;
+  bool prefetch = false;
+  bool push = false;
+  std::string pushRate = "1Mbps";
+  double checkpointAt = 0;
+  std::string checkpointFile = "project_4.ckpt";
+  std::string restore = "";
+  uint32_t chunkSize = 1024;
+  uint32_t dedupChunkSize = 1024;
+  uint32_t clientLans = 0;
+  bool proxy = false;
+  std::string lanRate = "10Mbps";
+  uint32_t proxyCache = 1 << 20;
+  uint32_t workers = 0;
+  std::string dataRate = "56Kbps";
+  bool adaptiveWrites = false;
+  double writeLatency = 0.1;
+  bool wifi = false;
+  uint32_t stationsPerAp = 4;
+  std::string wifiManager = "ns3::MinstrelWifiManager";
+  double wifiDistance = 10;
+  double workDelay = 0;
+  double sampleInterval = 0;
+  std::string sampleFile = "project_4.samples";
        
   CommandLine cmd;
 
   cmd.AddValue ("useIpv6", "Use Ipv6", useV6);
-  cmd.AddValue ("packetSize", "size of application packet sent", packetSize);
+  cmd.AddValue ("packetSize", "size of application packet sent, and of each server write of a bulk reply", packetSize);
+  cmd.AddValue ("dataRate", "data rate of the servers' segment", dataRate);
+  cmd.AddValue ("adaptiveWrites", "servers size writes from each connection's measured delivery rate and round trip time", adaptiveWrites);
+  cmd.AddValue ("writeLatency", "with --adaptiveWrites, seconds one write may take to drain", writeLatency);
   cmd.AddValue ("nPackets", "number of packets generated", nPackets);
-  cmd.AddValue ("verbose", "turn off all WifiNetDevice log components", verbose);
-  cmd.AddValue ("tracing", "turn on ascii and pcap tracing", tracing);
+  cmd.AddValue ("verbose", "log client and server activity", verbose);
+  cmd.AddValue ("tracing", "full (pcap on every device), lite (one capture of the shared segment), binary (MiniFTP event log only) or none", tracing);
+  cmd.AddValue ("traceFile", "event log written with --tracing=binary", traceFile);
+  cmd.AddValue ("flowmon", "print FlowMonitor, channel utilization and goodput report at the end of the run", flowmon);
   cmd.AddValue ("numNodes", "number of nodes", numNodes);
   cmd.AddValue ("sinkNode", "Receiver node number", sinkNode);
   cmd.AddValue ("sourceNode", "Sender node number", sourceNode);
+  cmd.AddValue ("maxConnections", "connections each server accepts, 0 for no limit", maxConnections);
+  cmd.AddValue ("maxActiveTransfers", "concurrent replies per server, 0 for no limit", maxActiveTransfers);
+  cmd.AddValue ("maxPending", "requests each server queues before replying 421 Busy", maxPending);
+  cmd.AddValue ("pipeline", "commands each client keeps in flight, 1 for serial", pipeline);
+  cmd.AddValue ("fileSet", "files the servers hold: small (the original four), large or versioned (four versions of each large file)", fileSet);
+  cmd.AddValue ("interval", "seconds between client start times", interval);
+  cmd.AddValue ("lifetime", "seconds each client runs", lifetime);
+  cmd.AddValue ("arrival", "client start times: staggered (every --interval seconds) or poisson", arrival);
+  cmd.AddValue ("arrivalRate", "mean client arrivals per second with --arrival=poisson", arrivalRate);
+  cmd.AddValue ("seed", "random number generator seed", seed);
+  cmd.AddValue ("run", "random number generator run number", run);
+  cmd.AddValue ("bench", "count events and print a BENCH summary line at the end of the run", bench);
+  cmd.AddValue ("memAudit", "report resident memory per client node and per connection", memAudit);
+  cmd.AddValue ("emulate", "run in real time and bridge the segment to a TAP device on the host", emulate);
+  cmd.AddValue ("tapName", "name of the host TAP device with --emulate", tapName);
+  cmd.AddValue ("emuTarget", "server the simulated clients use with --emulate: sim (server node 0) or host (a process on the TAP device)", emuTarget);
+  cmd.AddValue ("tcpVariant", "TCP congestion control of every app, e.g. ns3::TcpWestwood; empty for the default", tcpVariant);
+  cmd.AddValue ("sndBuf", "TCP send buffer of every app in bytes, 0 for the default", sndBuf);
+  cmd.AddValue ("rcvBuf", "TCP receive buffer of every app in bytes, 0 for the default", rcvBuf);
+  cmd.AddValue ("transport", "transport under MiniFTP: tcp or rdt (reliable datagrams over UDP)", transport);
+  cmd.AddValue ("rdtWindow", "segments in flight per connection with --transport=rdt", rdtWindow);
+  cmd.AddValue ("rdtPacing", "pacing rate per connection with --transport=rdt, 0bps for none", rdtPacing);
+  cmd.AddValue ("swarm", "clients fetch file chunks from each other where the server's manifest allows", swarm);
+  cmd.AddValue ("chunkSize", "bytes per chunk in the manifests the servers hand out with --swarm", chunkSize);
+  cmd.AddValue ("dedupChunkSize", "mean bytes per content-defined chunk in the servers' file stores and the clients' held files", dedupChunkSize);
+  cmd.AddValue ("delta", "clients hold the oldest version of each file and fetch the latest with DELTA", delta);
+  cmd.AddValue ("multiplex", "tag commands with streams so replies to pipelined commands interleave", multiplex);
+  cmd.AddValue ("prefetch", "servers learn which file follows which and cache the likely next reply", prefetch);
+  cmd.AddValue ("push", "with --prefetch and --multiplex, servers also push the likely next file", push);
+  cmd.AddValue ("pushRate", "cap on each server's pushed bytes with --push", pushRate);
+  cmd.AddValue ("checkpointAt", "seconds at which to write --checkpointFile and end the run, 0 for never", checkpointAt);
+  cmd.AddValue ("checkpointFile", "application state written with --checkpointAt", checkpointFile);
+  cmd.AddValue ("restore", "checkpoint file to resume from instead of starting at 0s", restore);
+  cmd.AddValue ("clientLans", "put the clients on this many LANs, each routed to the servers' segment through a node of its own; 0 for one shared segment", clientLans);
+  cmd.AddValue ("lanRate", "data rate of each client LAN with --clientLans", lanRate);
+  cmd.AddValue ("proxy", "with --clientLans, the node in front of each LAN runs a caching proxy the clients fetch through", proxy);
+  cmd.AddValue ("workers", "threads per server building GET and DELTA replies off the simulator thread, 0 for none", workers);
+  cmd.AddValue ("workDelay", "simulated seconds a reply built by the workers takes", workDelay);
+  cmd.AddValue ("wifi", "put the clients on 802.11g access points, one client LAN per AP, instead of wired LANs", wifi);
+  cmd.AddValue ("stationsPerAp", "clients associated with each access point with --wifi", stationsPerAp);
+  cmd.AddValue ("wifiManager", "rate adaptation of every station and AP with --wifi, e.g. ns3::ArfWifiManager", wifiManager);
+  cmd.AddValue ("wifiDistance", "metres between each station and its access point with --wifi", wifiDistance);
+  cmd.AddValue ("proxyCache", "bytes of files each proxy caches with --proxy", proxyCache);
+  cmd.AddValue ("sampleInterval", "simulated seconds between samples of server and client counters written to --sampleFile, 0 for none", sampleInterval);
+  cmd.AddValue ("sampleFile", "time series written with --sampleInterval; read it with tools/mftp_sample_reader", sampleFile);
   cmd.Parse (argc, argv);
 
+  RngSeedManager::SetSeed (seed);
+  RngSeedManager::SetRun (run);
+  if (bench || sampleInterval > 0)
+    {
+      GlobalValue::Bind ("SimulatorImplementationType",
+                         StringValue ("ns3::MftpCountingSimulatorImpl"));
+    }
+  if (emulate)
+    {
+      if (bench || useV6)
+        {
+          NS_FATAL_ERROR ("--emulate works with neither --bench nor --useIpv6");
+        }
+      if (emuTarget != "sim" && emuTarget != "host")
+        {
+          NS_FATAL_ERROR ("Unknown --emuTarget '" << emuTarget << "'");
+        }
+      // the host's stack checks what the simulated nodes send it
+      GlobalValue::Bind ("SimulatorImplementationType",
+                         StringValue ("ns3::RealtimeSimulatorImpl"));
+      GlobalValue::Bind ("ChecksumEnabled", BooleanValue (true));
+    }
+  std::string protocol = "ns3::TcpSocketFactory";
+  if (transport == "rdt")
+    {
+      protocol = "ns3::MftpRdtSocketFactory";
+      Config::SetDefault ("ns3::MftpRdtSocket::Window", UintegerValue (rdtWindow));
+      Config::SetDefault ("ns3::MftpRdtSocket::PacingRate", DataRateValue (DataRate (rdtPacing)));
+    }
+  else if (transport != "tcp")
+    {
+      NS_FATAL_ERROR ("Unknown --transport '" << transport << "'");
+    }
+  if (arrival != "staggered" && arrival != "poisson")
+    {
+      NS_FATAL_ERROR ("Unknown --arrival '" << arrival << "'");
+    }
+  if (arrival == "poisson" && arrivalRate <= 0)
+    {
+      NS_FATAL_ERROR ("--arrivalRate must be positive");
+    }
+  if (swarm && (checkpointAt > 0 || !restore.empty ()))
+    {
+      NS_FATAL_ERROR ("--swarm state cannot be checkpointed");
+    }
+  uint32_t numClients = numNodes > 2 ? numNodes : 2;
+  if (wifi)
+    {
+      if (clientLans > 0 || stationsPerAp == 0)
+        {
+          NS_FATAL_ERROR ("--wifi takes --stationsPerAp, at least 1, instead of --clientLans");
+        }
+      clientLans = (numClients + stationsPerAp - 1) / stationsPerAp;
+    }
+  if (clientLans > 0 && (emulate || useV6))
+    {
+      NS_FATAL_ERROR ("--clientLans works with neither --emulate nor --useIpv6");
+    }
+  if (clientLans > 253)
+    {
+      NS_FATAL_ERROR ("--clientLans is at most 253");
+    }
+  if (proxy && clientLans == 0)
+    {
+      NS_FATAL_ERROR ("--proxy needs --clientLans");
+    }
+  if (proxy && (swarm || multiplex || push || checkpointAt > 0 || !restore.empty ()))
+    {
+      NS_FATAL_ERROR ("--proxy works with none of --swarm, --multiplex, --push and checkpoints");
+    }
+  if (fileSet != "small" && fileSet != "large" && fileSet != "versioned")
+    {
+      NS_FATAL_ERROR ("Unknown --fileSet '" << fileSet << "'");
+    }
 
+  // older scripts pass --tracing=1 / --tracing=0
+  if (tracing == "1" || tracing == "true")
+    {
+      tracing = "full";
+    }
+  else if (tracing == "0" || tracing == "false")
+    {
+      tracing = "none";
+    }
+  if (tracing != "full" && tracing != "lite" && tracing != "binary" && tracing != "none")
+    {
+      NS_FATAL_ERROR ("Unknown --tracing mode '" << tracing << "'");
+    }
+
+
+  uint64_t rssStart = MftpReport::GetCurrentRss ();
   NodeContainer nodesClient;
   NodeContainer nodesServer;
+  NodeContainer nodesProxy;
   nodesServer.Create(2);
-  nodesClient.Create(numNodes >2 ? numNodes : 2);
+  nodesClient.Create(numClients);
+  nodesProxy.Create (clientLans);
+
+  // with --clientLans, LAN k holds its router (or proxy) and a
+  // contiguous block of clients; with --wifi, blocks of stationsPerAp
+  uint32_t groups = clientLans > 0 ? clientLans : 1;
+  std::vector<NodeContainer> clientGroups (groups);
+  for (uint32_t c = 0; c < nodesClient.GetN (); c++)
+    {
+      uint32_t group = wifi ? c / stationsPerAp : c * groups / nodesClient.GetN ();
+      clientGroups[group].Add (nodesClient.Get (c));
+    }
+
+  // client start times; the last client stops at appsEnd, and the
+  // servers with it
+  std::vector<double> startTimes;
+  Ptr<ExponentialRandomVariable> arrivalGap = CreateObject<ExponentialRandomVariable> ();
+  arrivalGap->SetAttribute ("Mean", DoubleValue (1.0 / arrivalRate));
+  double nextStart = 1.0;
+  for (uint32_t c = 0; c < nodesClient.GetN (); c++)
+    {
+      startTimes.push_back (nextStart);
+      nextStart += arrival == "poisson" ? arrivalGap->GetValue () : interval;
+    }
+  double appsEnd = startTimes.back () + lifetime;
   NodeContainer nodes(nodesServer,nodesClient);
+  nodes.Add (nodesProxy);
+  // with --emulate, a ghost node at the end of the segment stands in for
+  // the host; its TAP bridge gets the ghost's MAC and IP
+  NodeContainer ghost;
+  if (emulate)
+    {
+      ghost.Create (1);
+      nodes.Add (ghost);
+    }
   
 
   if(verbose){
@@ -71,26 +348,123 @@ main (int argc, char *argv[])
 	LogComponentEnable("MiniFTP",LOG_INFO);	
   } 
 
+  DataRate channelRate (dataRate);
   CsmaHelper csma;
-  csma.SetChannelAttribute ("DataRate", StringValue ("56Kbps"));
+  csma.SetChannelAttribute ("DataRate", DataRateValue (channelRate));
   csma.SetChannelAttribute ("Delay", StringValue ("2ms"));
 
+  // the servers' segment; behind LANs it carries only what the routers
+  // or proxies relay
   NetDeviceContainer devices;
-  devices = csma.Install (nodes); 
+  devices = csma.Install (clientLans > 0 ? NodeContainer (nodesServer, nodesProxy) : nodes);
+  CsmaHelper lanCsma;
+  lanCsma.SetChannelAttribute ("DataRate", DataRateValue (DataRate (lanRate)));
+  lanCsma.SetChannelAttribute ("Delay", StringValue ("2ms"));
+  std::vector<NetDeviceContainer> lanDevices;
+  WifiHelper wifiHelper;
+  wifiHelper.SetStandard (WIFI_PHY_STANDARD_80211g);
+  wifiHelper.SetRemoteStationManager (wifiManager);
+  YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
+  wifiPhy.SetPcapDataLinkType (YansWifiPhyHelper::DLT_IEEE802_11_RADIO);
+  WifiMacHelper wifiMac;
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t k = 0; k < clientLans; k++)
+    {
+      if (!wifi)
+        {
+          NodeContainer lan (nodesProxy.Get (k));
+          lan.Add (clientGroups[k]);
+          lanDevices.push_back (lanCsma.Install (lan));
+          continue;
+        }
+      // each cell on a channel of its own, so cells do not contend with
+      // each other; the AP's device comes first, as the router's does on
+      // a wired LAN
+      wifiPhy.SetChannel (YansWifiChannelHelper::Default ().Create ());
+      std::ostringstream name;
+      name << "mftp-" << k;
+      Ssid ssid (name.str ());
+      wifiMac.SetType ("ns3::ApWifiMac", "Ssid", SsidValue (ssid));
+      NetDeviceContainer cell = wifiHelper.Install (wifiPhy, wifiMac, nodesProxy.Get (k));
+      wifiMac.SetType ("ns3::StaWifiMac", "Ssid", SsidValue (ssid),
+                       "ActiveProbing", BooleanValue (false));
+      cell.Add (wifiHelper.Install (wifiPhy, wifiMac, clientGroups[k]));
+      lanDevices.push_back (cell);
+
+      // stations on a circle around their AP
+      Vector ap (1000.0 * k, 0, 0);
+      positions->Add (ap);
+      for (uint32_t s = 0; s < clientGroups[k].GetN (); s++)
+        {
+          double angle = 2 * M_PI * s / clientGroups[k].GetN ();
+          positions->Add (Vector (ap.x + wifiDistance * std::cos (angle),
+                                  ap.y + wifiDistance * std::sin (angle), 0));
+        }
+    }
+  if (wifi)
+    {
+      // in the order positions were added: each AP, then its stations
+      NodeContainer placed;
+      for (uint32_t k = 0; k < clientLans; k++)
+        {
+          placed.Add (nodesProxy.Get (k));
+          placed.Add (clientGroups[k]);
+        }
+      mobility.SetPositionAllocator (positions);
+      mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+      mobility.Install (placed);
+    }
   InternetStackHelper stack;
   stack.Install (nodes);
+  if (transport == "rdt")
+    {
+      MftpRdtSocketFactory::Install (nodes);
+    }
 
   uint16_t sinkPort = 8080;
   Address sinkAddress;
   Address anyAddress;
   std::string probeType;
   std::string tracePath;
-  if (useV6 == false)
+  std::vector<Address> lanPeers;
+  if (clientLans > 0)
+    {
+      // the servers' segment is 10.1/16 and LAN k is 10.(k + 2)/16; the
+      // proxy on each LAN is its first address
+      Ipv4AddressHelper address;
+      address.SetBase ("10.1.0.0", "255.255.0.0", "0.0.1.1");
+      Ipv4InterfaceContainer interfaces = address.Assign (devices);
+      sinkAddress = InetSocketAddress (interfaces.GetAddress (0), sinkPort);
+      for (uint32_t k = 0; k < clientLans; k++)
+        {
+          std::ostringstream network;
+          network << "10." << k + 2 << ".0.0";
+          address.SetBase (network.str ().c_str (), "255.255.0.0", "0.0.1.1");
+          Ipv4InterfaceContainer lan = address.Assign (lanDevices[k]);
+          lanPeers.push_back (InetSocketAddress (lan.GetAddress (0), sinkPort));
+        }
+      anyAddress = InetSocketAddress (Ipv4Address::GetAny (), sinkPort);
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+  else if (useV6 == false)
     {
+      // a /8 so that large runs do not run out of addresses; numbering
+      // still starts at 10.1.1.1
       Ipv4AddressHelper address;
-      address.SetBase ("10.1.1.0", "255.255.255.0");
+      address.SetBase ("10.0.0.0", "255.0.0.0", "0.1.1.1");
       Ipv4InterfaceContainer interfaces = address.Assign (devices);
       sinkAddress = InetSocketAddress (interfaces.GetAddress (0), sinkPort);//1 to 7
+      if (emulate)
+        {
+          Ipv4Address host = interfaces.GetAddress (nodes.GetN () - 1);
+          NS_LOG_INFO ("Host side of " << tapName << " is " << host
+                       << ", server 0 is " << interfaces.GetAddress (0));
+          if (emuTarget == "host")
+            {
+              sinkAddress = InetSocketAddress (host, sinkPort);
+            }
+        }
       anyAddress = InetSocketAddress (Ipv4Address::GetAny (), sinkPort);
     }
   else
@@ -102,41 +476,208 @@ main (int argc, char *argv[])
       anyAddress = Inet6SocketAddress (Ipv6Address::GetAny (), sinkPort);
     }
 
-     PacketSinkHelper packetSinkHelper ("ns3::TcpSocketFactory", anyAddress);
+     PacketSinkHelper packetSinkHelper (protocol, anyAddress);
+     packetSinkHelper.SetAttribute ("MaxConnections", UintegerValue (maxConnections));
+     packetSinkHelper.SetAttribute ("MaxActiveTransfers", UintegerValue (maxActiveTransfers));
+     packetSinkHelper.SetAttribute ("MaxPendingRequests", UintegerValue (maxPending));
+     packetSinkHelper.SetAttribute ("MeasureCpu", BooleanValue (emulate));
+     packetSinkHelper.SetAttribute ("TcpVariant", StringValue (tcpVariant));
+     packetSinkHelper.SetAttribute ("SndBufSize", UintegerValue (sndBuf));
+     packetSinkHelper.SetAttribute ("RcvBufSize", UintegerValue (rcvBuf));
+     packetSinkHelper.SetAttribute ("ChunkSize", UintegerValue (chunkSize));
+     packetSinkHelper.SetAttribute ("DedupChunkSize", UintegerValue (dedupChunkSize));
+     packetSinkHelper.SetAttribute ("Prefetch", BooleanValue (prefetch || push));
+     packetSinkHelper.SetAttribute ("PrefetchPush", BooleanValue (push));
+     packetSinkHelper.SetAttribute ("PushRate", DataRateValue (DataRate (pushRate)));
+     packetSinkHelper.SetAttribute ("Workers", UintegerValue (workers));
+     packetSinkHelper.SetAttribute ("WriteSize", UintegerValue (packetSize));
+     packetSinkHelper.SetAttribute ("AdaptiveWriteSize", BooleanValue (adaptiveWrites));
+     packetSinkHelper.SetAttribute ("WriteLatency", TimeValue (Seconds (writeLatency)));
+     packetSinkHelper.SetAttribute ("WorkDelay", TimeValue (Seconds (workDelay)));
      ApplicationContainer sinkApps2 = packetSinkHelper.Install (nodesServer);
      sinkApps2.Start (Seconds (0.));
-     sinkApps2.Stop (Seconds (20));
+     sinkApps2.Stop (Seconds (appsEnd));
 
-     MyAppHelper MyAppHelper ("ns3::TcpSocketFactory", anyAddress);
-     ApplicationContainer sourceApps2 = MyAppHelper.Install (nodesClient);
+     if (fileSet == "large")
+       {
+         // same names, bodies of 1, 4, 16 and 64 KiB
+         const char *names[] = { "little.txt", "big.txt", "huge.txt", "giant.txt" };
+         for (uint32_t f = 0; f < 4; f++)
+           {
+             std::string body (1024 << (2 * f), 'a' + f);
+             for (ApplicationContainer::Iterator i = sinkApps2.Begin (); i != sinkApps2.End (); ++i)
+               {
+                 DynamicCast<PacketSink> (*i)->AddFile (names[f], body);
+               }
+           }
+       }
+
+     ApplicationContainer proxyApps;
+     if (proxy)
+       {
+         MftpProxyHelper proxyHelper (protocol, anyAddress, sinkAddress);
+         proxyHelper.SetAttribute ("CacheSize", UintegerValue (proxyCache));
+         proxyApps = proxyHelper.Install (nodesProxy);
+         proxyApps.Start (Seconds (1.));
+         proxyApps.Stop (Seconds (appsEnd));
+       }
+
+     // one helper per LAN, so each group of clients has its own peer;
+     // clients stay in node order across groups
+     ApplicationContainer sourceApps2;
+     for (uint32_t g = 0; g < groups; g++)
+       {
+         MyAppHelper clientHelper (protocol, proxy ? lanPeers[g] : sinkAddress);
+         clientHelper.SetAttribute ("PipelineDepth", UintegerValue (pipeline));
+         clientHelper.SetAttribute ("TcpVariant", StringValue (tcpVariant));
+         clientHelper.SetAttribute ("SndBufSize", UintegerValue (sndBuf));
+         clientHelper.SetAttribute ("RcvBufSize", UintegerValue (rcvBuf));
+         clientHelper.SetAttribute ("Swarm", BooleanValue (swarm));
+         clientHelper.SetAttribute ("DeltaFetch", BooleanValue (delta));
+         clientHelper.SetAttribute ("DedupChunkSize", UintegerValue (dedupChunkSize));
+         clientHelper.SetAttribute ("Multiplex", BooleanValue (multiplex));
+         clientHelper.GetConfig ()->packetSize = packetSize;
+         clientHelper.GetConfig ()->nPackets = nPackets;
+         clientHelper.GetConfig ()->dataRate = DataRate ("56kbps");
+         sourceApps2.Add (clientHelper.Install (clientGroups[g]));
+       }
+
+     if (fileSet == "versioned")
+       {
+         // the latest version under the plain name, older ones as
+         // "<name>;<version>"; the store keeps their common chunks once
+         const char *names[] = { "little.txt", "big.txt", "huge.txt", "giant.txt" };
+         for (uint32_t f = 0; f < 4; f++)
+           {
+             std::vector<std::string> history = MakeVersions (1024 << (2 * f), 4, f);
+             for (ApplicationContainer::Iterator i = sinkApps2.Begin (); i != sinkApps2.End (); ++i)
+               {
+                 Ptr<PacketSink> sink = DynamicCast<PacketSink> (*i);
+                 for (uint32_t v = 0; v + 1 < history.size (); v++)
+                   {
+                     std::ostringstream name;
+                     name << names[f] << ";" << v + 1;
+                     sink->AddFile (name.str (), history[v]);
+                   }
+                 sink->AddFile (names[f], history.back ());
+               }
+             if (delta)
+               {
+                 for (ApplicationContainer::Iterator i = sourceApps2.Begin (); i != sourceApps2.End (); ++i)
+                   {
+                     DynamicCast<MyApp> (*i)->AddFile (names[f], history.front ());
+                   }
+               }
+           }
+       }
 
      sinkApps2.Start (Seconds (1.));
-     sinkApps2.Stop (Seconds (20));
+     sinkApps2.Stop (Seconds (appsEnd));
 
-  std::list <Ptr<Socket> > socket_list;
-  uint32_t index = 0;
-  for (NodeContainer::Iterator i = nodesClient.Begin (); i != nodesClient.End (); ++i)
+  // each MyApp creates its socket from its Protocol attribute when it
+  // starts and drops it when it finishes
+  for (uint32_t c = 0; c < sourceApps2.GetN (); c++)
   {
-    Ptr<Socket> sock = Socket::CreateSocket ( *i, TcpSocketFactory::GetTypeId ());
-    socket_list.push_back(sock);
-    Ptr<Application> myapp = (*i)->GetApplication(0);
-    Ptr<MyApp> *app = (Ptr<MyApp> *) &myapp;
-    (*app)->Setup(sock, sinkAddress, packetSize, nPackets, DataRate ("56kbps"));
-    (*app)->SetStartTime(Seconds(2*index + 1.0));
-    (*app)->SetStopTime(Seconds(2*index + 2.0));
-    index++;
+    Ptr<Application> app = sourceApps2.Get (c);
+    app->SetStartTime(Seconds(startTimes[c]));
+    app->SetStopTime(Seconds(startTimes[c] + lifetime));
   }
+  if (!restore.empty ())
+    {
+      // after the start times: restoring moves them to the checkpoint
+      Time at = MftpCheckpoint::Load (restore, sinkApps2, sourceApps2);
+      std::cout << "Resuming from " << restore << " at " << at.GetSeconds () << "s" << std::endl;
+    }
 
 
-  if (tracing == true)
+  if (tracing == "full")
     {
       csma.EnablePcapAll ("project_4");
+      lanCsma.EnablePcapAll ("project_4-lan");
+      if (wifi)
+        {
+          wifiPhy.EnablePcapAll ("project_4-wifi");
+        }
       csma.EnablePcap ("project_4", devices.Get (0), true); // output packets from server 0
       csma.EnablePcap ("project_4", devices.Get (1), true); // output packets from server 1
     }
+  else if (tracing == "lite")
+    {
+      // the segment is a shared medium, so one promiscuous capture on
+      // server 0 already sees every frame
+      csma.EnablePcap ("project_4", devices.Get (0), true);
+    }
+  else if (tracing == "binary")
+    {
+      // request-level events from every app go to one file; read it
+      // back with tools/mftp_trace_reader
+      MftpTraceWriter::Enable (traceFile);
+    }
+
+  if (emulate)
+    {
+      TapBridgeHelper tapBridge;
+      tapBridge.SetAttribute ("Mode", StringValue ("ConfigureLocal"));
+      tapBridge.SetAttribute ("DeviceName", StringValue (tapName));
+      tapBridge.Install (ghost.Get (0), devices.Get (devices.GetN () - 1));
+    }
+
+  MftpReport report;
+  report.AddServers (sinkApps2);
+  report.AddClients (sourceApps2);
+  report.AddProxies (proxyApps);
+  if (flowmon)
+    {
+      report.EnableFlowMonitor (nodes, useV6);
+      report.WatchChannel (devices, channelRate);
+    }
+  if (emulate)
+    {
+      report.WatchRealtimeLag (MilliSeconds (100));
+    }
+  if (sampleInterval > 0)
+    {
+      // events per interval stay 0 with --emulate, which keeps the
+      // realtime simulator rather than the counting one
+      Ptr<MftpSampler> sampler = CreateObject<MftpSampler> ();
+      sampler->SetAttribute ("Interval", TimeValue (Seconds (sampleInterval)));
+      sampler->SetAttribute ("File", StringValue (sampleFile));
+      sampler->AddServers (sinkApps2);
+      sampler->AddClients (sourceApps2);
+      nodesServer.Get (0)->AddApplication (sampler);
+      sampler->SetStartTime (Seconds (0));
+      sampler->SetStopTime (Seconds (appsEnd));
+    }
   
-  Simulator::Stop (Seconds (23));
+  uint64_t rssSetup = MftpReport::GetCurrentRss ();
+  Simulator::Stop (Seconds (appsEnd + 3));
+  if (checkpointAt > 0)
+    {
+      Simulator::Schedule (Seconds (checkpointAt), &MftpCheckpoint::Save,
+                           checkpointFile, sinkApps2, sourceApps2);
+      Simulator::Stop (Seconds (checkpointAt));
+    }
+  SystemWallClockMs wallClock;
+  wallClock.Start ();
   Simulator::Run ();
+  double wallSeconds = wallClock.End () / 1000.0;
+  if (flowmon)
+    {
+      report.Print (std::cout);
+    }
+  if (bench)
+    {
+      report.PrintBenchmark (std::cout, wallSeconds);
+    }
+  if (emulate)
+    {
+      report.PrintRealtime (std::cout);
+    }
+  if (memAudit)
+    {
+      report.PrintMemoryAudit (std::cout, rssStart, rssSetup);
+    }
+  MftpTraceWriter::Disable ();
   Simulator::Destroy ();
 
   return 0;
@@ -0,0 +1,92 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_checkpoint.h"
+#include "mftp_server.h"
+#include "mftp_client.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <fstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MftpCheckpoint");
+
+void
+MftpCheckpoint::Save (std::string filename, ApplicationContainer servers,
+                      ApplicationContainer clients)
+{
+  std::ofstream os (filename.c_str (), std::ios::binary);
+  if (!os)
+    {
+      NS_FATAL_ERROR ("Cannot write checkpoint " << filename);
+    }
+  os << "MFTP-CHECKPOINT 1\n"
+     << "time " << Simulator::Now ().GetNanoSeconds () << "\n"
+     << "servers " << servers.GetN () << "\n";
+  for (ApplicationContainer::Iterator i = servers.Begin (); i != servers.End (); ++i)
+    {
+      DynamicCast<PacketSink> (*i)->SaveState (os);
+    }
+  os << "clients " << clients.GetN () << "\n";
+  for (ApplicationContainer::Iterator i = clients.Begin (); i != clients.End (); ++i)
+    {
+      DynamicCast<MyApp> (*i)->SaveState (os);
+    }
+  NS_LOG_INFO ("Checkpoint at " << Simulator::Now ().GetSeconds () << "s written to " << filename);
+}
+
+Time
+MftpCheckpoint::Load (std::string filename, ApplicationContainer servers,
+                      ApplicationContainer clients)
+{
+  std::ifstream is (filename.c_str (), std::ios::binary);
+  std::string magic;
+  std::string word;
+  uint32_t version = 0;
+  int64_t at = 0;
+  uint32_t n = 0;
+  if (!(is >> magic >> version) || magic != "MFTP-CHECKPOINT" || version != 1
+      || !(is >> word >> at) || word != "time")
+    {
+      NS_FATAL_ERROR (filename << ": not a MiniFTP checkpoint");
+    }
+  if (!(is >> word >> n) || word != "servers" || n != servers.GetN ())
+    {
+      NS_FATAL_ERROR (filename << ": saved " << n << " servers, this run has " << servers.GetN ());
+    }
+  for (ApplicationContainer::Iterator i = servers.Begin (); i != servers.End (); ++i)
+    {
+      if (!DynamicCast<PacketSink> (*i)->LoadState (is, NanoSeconds (at)))
+        {
+          NS_FATAL_ERROR (filename << ": bad server state");
+        }
+    }
+  if (!(is >> word >> n) || word != "clients" || n != clients.GetN ())
+    {
+      NS_FATAL_ERROR (filename << ": saved " << n << " clients, this run has " << clients.GetN ());
+    }
+  for (ApplicationContainer::Iterator i = clients.Begin (); i != clients.End (); ++i)
+    {
+      if (!DynamicCast<MyApp> (*i)->LoadState (is, NanoSeconds (at)))
+        {
+          NS_FATAL_ERROR (filename << ": bad client state");
+        }
+    }
+  return NanoSeconds (at);
+}
+
+} // namespace ns3
@@ -0,0 +1,65 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_CHECKPOINT_H
+#define MFTP_CHECKPOINT_H
+
+#include <string>
+#include "ns3/nstime.h"
+#include "ns3/application-container.h"
+
+namespace ns3 {
+
+/**
+ * \brief Application-level snapshot of a MiniFTP run.
+ *
+ * Save writes, at the current simulation time, the file store and
+ * counters of every PacketSink and the progress, statistics and held
+ * files of every MyApp.  Load puts them back into freshly built
+ * applications of a new run and moves every start to the checkpoint
+ * time, so the run skips straight to that point: the simulator has no
+ * events before it.  Sockets, queues and in-flight packets are not
+ * saved; resumed clients reconnect and resend their unanswered commands.
+ *
+ * Load expects the same number of servers and clients as Save saw.  A
+ * continuation may change anything else, such as link parameters or the
+ * start times of clients that had not started.
+ */
+class MftpCheckpoint
+{
+public:
+  /**
+   * \brief Write a checkpoint of the current simulation time
+   * \param filename the checkpoint file, replaced if it exists
+   * \param servers the PacketSink applications
+   * \param clients the MyApp applications
+   */
+  static void Save (std::string filename, ApplicationContainer servers,
+                    ApplicationContainer clients);
+  /**
+   * \brief Restore a checkpoint; call after setting the start and stop
+   * times of the applications and before Simulator::Run
+   * \param filename the checkpoint file
+   * \param servers the PacketSink applications
+   * \param clients the MyApp applications
+   * \return the time the checkpoint was taken
+   */
+  static Time Load (std::string filename, ApplicationContainer servers,
+                    ApplicationContainer clients);
+};
+
+} // namespace ns3
+
+#endif /* MFTP_CHECKPOINT_H */
@@ -0,0 +1,268 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_chunk_store.h"
+#include <algorithm>
+
+namespace ns3 {
+
+namespace {
+
+/// One random word per byte value, the same on every run.
+struct Gear
+{
+  uint32_t table[256]; //!< Word per byte value
+
+  Gear ()
+  {
+    // splitmix64
+    uint64_t x = 0x4d465450;
+    for (uint32_t i = 0; i < 256; i++)
+      {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        table[i] = (z ^ (z >> 31)) >> 32;
+      }
+  }
+};
+
+/**
+ * \return the gear table, built once even when workers split files
+ * concurrently
+ */
+const uint32_t *
+GearTable (void)
+{
+  static const Gear gear;
+  return gear.table;
+}
+
+} // anonymous namespace
+
+MftpChunkStore::MftpChunkStore ()
+  : m_storedBytes (0),
+    m_logicalBytes (0)
+{
+  SetAverageChunkSize (1024);
+}
+
+void
+MftpChunkStore::SetAverageChunkSize (uint32_t bytes)
+{
+  uint32_t average = 64;
+  uint32_t bits = 6;
+  while (average * 2 <= bytes)
+    {
+      average *= 2;
+      bits++;
+    }
+  // the high bits of the hash depend on the last 32 bytes, the low bits
+  // only on the last few
+  m_mask = (average - 1) << (32 - bits);
+  m_averageSize = average;
+  m_minSize = average / 4;
+  m_maxSize = average * 4;
+
+  std::map<std::string, std::string> files;
+  for (std::map<std::string, std::vector<uint64_t> >::const_iterator i = m_files.begin ();
+       i != m_files.end (); ++i)
+    {
+      Get (i->first, files[i->first]);
+    }
+  for (std::map<std::string, std::string>::const_iterator i = files.begin (); i != files.end (); ++i)
+    {
+      Put (i->first, i->second);
+    }
+}
+
+uint32_t
+MftpChunkStore::GetAverageChunkSize (void) const
+{
+  return m_averageSize;
+}
+
+void
+MftpChunkStore::Split (const std::string &content, std::vector<uint32_t> &ends) const
+{
+  const uint32_t *gear = GearTable ();
+  ends.clear ();
+  uint32_t start = 0;
+  uint32_t hash = 0;
+  for (uint32_t i = 0; i < content.size (); i++)
+    {
+      // each byte shifts out of the hash after 32 more
+      hash = (hash << 1) + gear[(uint8_t) content[i]];
+      uint32_t length = i + 1 - start;
+      if ((length >= m_minSize && (hash & m_mask) == 0) || length == m_maxSize)
+        {
+          ends.push_back (i + 1);
+          start = i + 1;
+          hash = 0;
+        }
+    }
+  if (start < content.size ())
+    {
+      ends.push_back (content.size ());
+    }
+}
+
+uint64_t
+MftpChunkStore::Hash (const char *data, uint32_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint32_t i = 0; i < size; i++)
+    {
+      hash = (hash ^ (uint8_t) data[i]) * 0x100000001b3ULL;
+    }
+  return hash;
+}
+
+void
+MftpChunkStore::Put (const std::string &name, const std::string &content)
+{
+  std::vector<uint32_t> ends;
+  Split (content, ends);
+  std::vector<uint64_t> recipe;
+  recipe.reserve (ends.size ());
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < ends.size (); i++)
+    {
+      uint64_t id = Hash (content.data () + start, ends[i] - start);
+      Chunk &chunk = m_chunks[id];
+      if (chunk.refs++ == 0)
+        {
+          chunk.data.assign (content, start, ends[i] - start);
+          m_storedBytes += chunk.data.size ();
+        }
+      recipe.push_back (id);
+      start = ends[i];
+    }
+
+  // add before removing, so chunks shared with the old version stay
+  Remove (name);
+  m_files[name].swap (recipe);
+  m_sizes[name] = content.size ();
+  m_logicalBytes += content.size ();
+}
+
+void
+MftpChunkStore::Remove (const std::string &name)
+{
+  std::map<std::string, std::vector<uint64_t> >::iterator file = m_files.find (name);
+  if (file == m_files.end ())
+    {
+      return;
+    }
+  for (uint32_t i = 0; i < file->second.size (); i++)
+    {
+      std::map<uint64_t, Chunk>::iterator chunk = m_chunks.find (file->second[i]);
+      if (--chunk->second.refs == 0)
+        {
+          m_storedBytes -= chunk->second.data.size ();
+          m_chunks.erase (chunk);
+        }
+    }
+  m_logicalBytes -= m_sizes[name];
+  m_sizes.erase (name);
+  m_files.erase (file);
+}
+
+bool
+MftpChunkStore::Get (const std::string &name, std::string &content) const
+{
+  std::map<std::string, std::vector<uint64_t> >::const_iterator file = m_files.find (name);
+  if (file == m_files.end ())
+    {
+      return false;
+    }
+  content.clear ();
+  content.reserve (m_sizes.find (name)->second);
+  for (uint32_t i = 0; i < file->second.size (); i++)
+    {
+      content += m_chunks.find (file->second[i])->second.data;
+    }
+  return true;
+}
+
+const std::vector<uint64_t> *
+MftpChunkStore::GetRecipe (const std::string &name) const
+{
+  std::map<std::string, std::vector<uint64_t> >::const_iterator file = m_files.find (name);
+  return file == m_files.end () ? 0 : &file->second;
+}
+
+const std::string *
+MftpChunkStore::GetChunk (uint64_t id) const
+{
+  std::map<uint64_t, Chunk>::const_iterator chunk = m_chunks.find (id);
+  return chunk == m_chunks.end () ? 0 : &chunk->second.data;
+}
+
+void
+MftpChunkStore::Save (std::ostream &os) const
+{
+  // names never hold blanks: commands are split on them
+  os << "files " << m_files.size () << "\n";
+  std::string content;
+  for (std::map<std::string, std::vector<uint64_t> >::const_iterator i = m_files.begin ();
+       i != m_files.end (); ++i)
+    {
+      Get (i->first, content);
+      os << i->first << " " << content.size () << "\n" << content << "\n";
+    }
+}
+
+bool
+MftpChunkStore::Load (std::istream &is)
+{
+  std::string word;
+  uint32_t files;
+  if (!(is >> word >> files) || word != "files")
+    {
+      return false;
+    }
+  for (uint32_t f = 0; f < files; f++)
+    {
+      std::string name;
+      uint32_t size;
+      if (!(is >> name >> size) || is.get () != '\n')
+        {
+          return false;
+        }
+      std::string content (size, '\0');
+      if (size > 0 && !is.read (&content[0], size))
+        {
+          return false;
+        }
+      Put (name, content);
+    }
+  return true;
+}
+
+uint64_t
+MftpChunkStore::GetStoredBytes (void) const
+{
+  return m_storedBytes;
+}
+
+uint64_t
+MftpChunkStore::GetLogicalBytes (void) const
+{
+  return m_logicalBytes;
+}
+
+} // namespace ns3
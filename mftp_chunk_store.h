@@ -0,0 +1,150 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_CHUNK_STORE_H
+#define MFTP_CHUNK_STORE_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * DELTA fetches a file the client holds an older version of:
+ *
+ *   DELTA <file> <id>...   200 OK with "<size> <chunks>\n" then, per
+ *                          chunk in order, "= <id>\n" for a chunk the
+ *                          client listed or "+ <id> <length>\n<bytes>"
+ *
+ * Chunk ids are the 16 hex digit MftpChunkStore::Hash of the chunk.
+ */
+
+namespace ns3 {
+
+/**
+ * \brief Deduplicated file store with content-defined chunk boundaries.
+ *
+ * Files are cut where a gear rolling hash over the last bytes matches a
+ * mask, so an edit moves only the boundaries next to it and the versions
+ * of a file share every chunk the edit did not touch.  Each distinct
+ * chunk is kept once, indexed by its hash; a file is the list of its
+ * chunk ids.
+ */
+class MftpChunkStore
+{
+public:
+  MftpChunkStore ();
+
+  /**
+   * \brief Set the mean chunk size and re-chunk the files already held.
+   *
+   * Chunks are at least a quarter and at most four times the mean.
+   *
+   * \param bytes the mean chunk size, rounded down to a power of two
+   */
+  void SetAverageChunkSize (uint32_t bytes);
+  /**
+   * \return the mean chunk size
+   */
+  uint32_t GetAverageChunkSize (void) const;
+
+  /**
+   * \brief Add or replace a file
+   * \param name the file name
+   * \param content the file body
+   */
+  void Put (const std::string &name, const std::string &content);
+  /**
+   * \brief Reassemble a file
+   * \param name the file name
+   * \param content set to the file body
+   * \return false if there is no such file
+   */
+  bool Get (const std::string &name, std::string &content) const;
+  /**
+   * \param name the file name
+   * \return the chunk ids of the file in order, or null if there is no
+   * such file
+   */
+  const std::vector<uint64_t> *GetRecipe (const std::string &name) const;
+  /**
+   * \param id a chunk id
+   * \return the chunk, or null if no file holds it
+   */
+  const std::string *GetChunk (uint64_t id) const;
+
+  /**
+   * \return bytes of distinct chunks held
+   */
+  uint64_t GetStoredBytes (void) const;
+  /**
+   * \return bytes of all files held, as if each were stored whole
+   */
+  uint64_t GetLogicalBytes (void) const;
+
+  /**
+   * \brief Write every file, for MftpCheckpoint
+   * \param os the stream to write to
+   */
+  void Save (std::ostream &os) const;
+  /**
+   * \brief Add the files written by Save
+   * \param is the stream to read from
+   * \return false on a malformed stream
+   */
+  bool Load (std::istream &is);
+
+  /**
+   * \brief Find the chunk boundaries of a body
+   * \param content the body
+   * \param ends set to the offset just past each chunk
+   */
+  void Split (const std::string &content, std::vector<uint32_t> &ends) const;
+  /**
+   * \param data the bytes to hash
+   * \param size the number of bytes
+   * \return the 64-bit FNV-1a hash used as chunk id
+   */
+  static uint64_t Hash (const char *data, uint32_t size);
+
+private:
+  /// A distinct chunk.
+  struct Chunk
+  {
+    std::string data; //!< Chunk bytes
+    uint32_t    refs; //!< Uses over all file recipes
+  };
+
+  /**
+   * \brief Drop a file and every chunk no other file uses
+   * \param name the file name
+   */
+  void Remove (const std::string &name);
+
+  std::map<uint64_t, Chunk> m_chunks;                   //!< Chunk index
+  std::map<std::string, std::vector<uint64_t> > m_files; //!< File recipes
+  std::map<std::string, uint64_t> m_sizes;               //!< File sizes
+  uint64_t m_storedBytes;  //!< Bytes of distinct chunks
+  uint64_t m_logicalBytes; //!< Bytes of all files
+  uint32_t m_mask;         //!< Boundary when the rolling hash & mask is 0
+  uint32_t m_averageSize;  //!< Mean chunk size
+  uint32_t m_minSize;      //!< Smallest chunk but the last
+  uint32_t m_maxSize;      //!< Largest chunk
+};
+
+} // namespace ns3
+
+#endif /* MFTP_CHUNK_STORE_H */
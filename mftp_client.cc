@@ -15,8 +15,19 @@
  */
 #include <vector>
 #include "mftp_client.h"
+#include "mftp_trace.h"
+#include "mftp_lazy_trace.h"
+#include "mftp_socket.h"
+#include "mftp_swarm.h"
+#include "mftp_command.h"
+#include <deque>
+#include <map>
+#include <sstream>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
 #include <iostream>
 
 namespace ns3 {
@@ -25,15 +36,76 @@ NS_LOG_COMPONENT_DEFINE ("MiniFTP");
 
 NS_OBJECT_ENSURE_REGISTERED (MyApp);
 
+struct MyApp::SwarmState
+{
+  /// A connection to another client's chunk listener.
+  struct PeerLink
+  {
+    Ptr<Socket> socket;   //!< Connection to the peer
+    std::string rxBuffer; //!< Reply bytes not yet parsed
+    std::deque<std::pair<std::string, uint32_t> > pending; //!< Chunks asked for, in order
+  };
+
+  std::vector<std::string> commands; //!< Server commands, growing as chunks are found
+  std::map<std::string, std::map<uint32_t, std::string> > chunks; //!< Chunks held
+  std::map<Address, PeerLink> peers;            //!< Open peer connections
+  std::map<Ptr<Socket>, std::string> serving;   //!< Partial commands from peers
+  Ptr<Socket> listener;                         //!< Chunk listener
+  Ptr<UniformRandomVariable> pick;              //!< Chooses among holders
+  uint32_t pending;                             //!< Chunks asked of peers
+  uint64_t peerRx;                              //!< Chunk bytes from peers
+  uint64_t servedTx;                            //!< Chunk bytes served
+};
+
+struct MyApp::MuxState
+{
+  /// A reply being received on one stream.
+  struct Stream
+  {
+    std::string buffer;   //!< Reply bytes so far
+    uint32_t    unacked;  //!< Bytes received since credit was last granted
+  };
+
+  std::map<uint32_t, Stream> streams;    //!< Replies in progress, by stream
+  std::map<uint32_t, std::string> done;  //!< Replies ahead of an unanswered command
+  std::map<uint32_t, std::string> pushes; //!< Files being pushed, by stream
+  std::map<std::string, std::string> pushed; //!< Pushed replies not yet used, by file
+};
+
+MyAppConfig::MyAppConfig ()
+  : packetSize (0),
+    nPackets (1),
+    dataRate (0)
+{
+  commands.push_back ("Foobar\n\n");
+  commands.push_back ("GET UNKNOWNFILE\n\n");
+  commands.push_back ("GET little.txt\n\n");
+  commands.push_back ("GET big.txt\n\n");
+  commands.push_back ("GET huge.txt\n\n");
+  commands.push_back ("GET giant.txt\n\n");
+  timers = Create<MftpTimerWheel> (MilliSeconds (10), 512);
+}
+
 MyApp::MyApp ()
-  : m_socket (0),
-    m_peer (),
-    m_packetSize (0),
-    m_nPackets (0),
-    m_dataRate (0),
-    m_sendEvent (),
-    m_running (false),
-    m_packetsSent (0)
+  : m_sendEvent (),
+    m_socket (0),
+    m_rxTrace (0),
+    m_swarm (0),
+    m_held (0),
+    m_mux (0),
+    m_totalRx (0),
+    m_deltaReused (0),
+    m_current_command (0),
+    m_packetsSent (0),
+    m_replies (0),
+    m_epoch (0),
+    m_resentUpTo (0),
+    m_attempts (0),
+    m_timeouts (0),
+    m_dedupChunkSize (1024),
+    m_failed (false),
+    m_restored (false),
+    m_running (false)
 {
   NS_LOG_INFO("CLIENT Creation");
 }
@@ -42,6 +114,10 @@ MyApp::~MyApp ()
 {
   NS_LOG_INFO("CLIENT Destruction");
   m_socket = 0;
+  delete m_rxTrace;
+  delete m_swarm;
+  delete m_held;
+  delete m_mux;
 }
 
 /* static */
@@ -51,19 +127,97 @@ TypeId MyApp::GetTypeId (void)
     .SetParent<Application> ()
     .SetGroupName ("Tutorial")
     .AddConstructor<MyApp> ()
-    .AddAttribute ("Local",
-                   "The Address on which to Bind the rx socket.",
-                   AddressValue (),
-                   MakeAddressAccessor (&MyApp::m_local),
-                   MakeAddressChecker ())
     .AddAttribute ("Protocol",
                    "The type id of the protocol to use for the rx socket.",
                    TypeIdValue (UdpSocketFactory::GetTypeId ()),
                    MakeTypeIdAccessor (&MyApp::m_tid),
                    MakeTypeIdChecker ())
+    .AddAttribute ("PipelineDepth",
+                   "Number of commands sent ahead of their replies. "
+                   "1 waits for each reply before sending the next command.",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&MyApp::m_pipelineDepth),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("TcpVariant",
+                   "Congestion control of TCP sockets, as a TcpCongestionOps "
+                   "type name such as ns3::TcpWestwood. Empty for the node default.",
+                   StringValue (""),
+                   MakeStringAccessor (&MyApp::m_tcpVariant),
+                   MakeStringChecker ())
+    .AddAttribute ("SndBufSize",
+                   "TCP send buffer size in bytes. Zero for the TcpSocket default.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&MyApp::m_sndBufSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RcvBufSize",
+                   "TCP receive buffer size in bytes. Zero for the TcpSocket default.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&MyApp::m_rcvBufSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Swarm",
+                   "Download GET files chunk by chunk, from other clients "
+                   "where the server's manifest lists any, and serve the "
+                   "chunks held to other clients.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MyApp::m_swarmEnabled),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SwarmPort",
+                   "Port on which chunks are served to other clients.",
+                   UintegerValue (8081),
+                   MakeUintegerAccessor (&MyApp::m_swarmPort),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("DeltaFetch",
+                   "Fetch each GET file with DELTA, downloading only the "
+                   "chunks missing from the copy the client holds, and "
+                   "keep the result.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MyApp::m_deltaFetch),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DedupChunkSize",
+                   "Mean size, in bytes, of the content-defined chunks "
+                   "held files are split into; must match the server's "
+                   "DedupChunkSize for DeltaFetch to reuse any.",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&MyApp::SetDedupChunkSize,
+                                         &MyApp::GetDedupChunkSize),
+                   MakeUintegerChecker<uint32_t> (64))
+    .AddAttribute ("Multiplex",
+                   "Tag each command with a stream and take the replies in "
+                   "frames, so a short reply need not wait behind a long "
+                   "one sent before it. Useful with PipelineDepth above 1.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MyApp::m_multiplex),
+                   MakeBooleanChecker ())
+    .AddAttribute ("StreamWindow",
+                   "Bytes of one multiplexed reply the server may send "
+                   "ahead of the client's credit.",
+                   UintegerValue (65535),
+                   MakeUintegerAccessor (&MyApp::m_streamWindow),
+                   MakeUintegerChecker<uint32_t> (2))
+    .AddAttribute ("InitialRto",
+                   "Reply timeout before any response time was measured.",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&MyApp::m_rto),
+                   MakeTimeChecker ())
+    .AddAttribute ("MinRto",
+                   "Lower bound of the adaptive reply timeout.",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&MyApp::m_minRto),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRto",
+                   "Upper bound of the reply timeout, backoff included.",
+                   TimeValue (Seconds (60)),
+                   MakeTimeAccessor (&MyApp::m_maxRto),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRetries",
+                   "Consecutive timeouts after which the client reconnects "
+                   "no more and gives up.",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&MyApp::m_maxRetries),
+                   MakeUintegerChecker<uint32_t> ())
     .AddTraceSource ("Rx",
                      "A packet has been received",
-                     MakeTraceSourceAccessor (&MyApp::m_rxTrace),
+                     MakeLazyTraceSourceAccessor (&MyApp::m_rxTrace),
                      "ns3::Packet::AddressTracedCallback")
     ;
   return tid;
@@ -71,24 +225,316 @@ TypeId MyApp::GetTypeId (void)
 
 void
 MyApp::Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate)
+{
+  Ptr<MyAppConfig> config = Create<MyAppConfig> ();
+  config->peer = address;
+  config->packetSize = packetSize;
+  config->nPackets = nPackets;
+  config->dataRate = dataRate;
+  SetConfig (config);
+  Setup (socket);
+}
+
+void
+MyApp::Setup (Ptr<Socket> socket)
 {
   NS_LOG_INFO("CLIENT Setup");
   m_socket = socket;
-  m_peer = address;
-  m_packetSize = packetSize;
-  m_nPackets = nPackets;
-  m_dataRate = dataRate;
   m_current_command = 0;
 }
 
+void
+MyApp::SetConfig (Ptr<const MyAppConfig> config)
+{
+  m_config = config;
+}
+
+uint64_t
+MyApp::GetTotalRx (void) const
+{
+  return m_totalRx;
+}
+
+uint32_t
+MyApp::GetRepliesReceived (void) const
+{
+  return m_replies;
+}
+
+uint32_t
+MyApp::GetOutstanding (void) const
+{
+  return m_running ? m_current_command - m_replies : 0;
+}
+
+Time
+MyApp::GetTotalLatency (void) const
+{
+  return m_latencySum;
+}
+
+Time
+MyApp::GetMaxLatency (void) const
+{
+  return m_latencyMax;
+}
+
+Time
+MyApp::GetCompletionTime (void) const
+{
+  if (m_finishTime.IsZero ())
+    {
+      return Time (0);
+    }
+  return m_finishTime - m_startTime;
+}
+
+bool
+MyApp::GetActiveSpan (Time &start, Time &end) const
+{
+  if (Simulator::Now () < Application::m_startTime)
+    {
+      return false;
+    }
+  start = m_startTime;
+  end = Simulator::Now ();
+  if (!m_finishTime.IsZero ())
+    {
+      end = m_finishTime;
+    }
+  else if (!Application::m_stopTime.IsZero ())
+    {
+      end = Min (end, Application::m_stopTime);
+    }
+  return true;
+}
+
+uint32_t
+MyApp::GetTimeouts (void) const
+{
+  return m_timeouts;
+}
+
+bool
+MyApp::HasFailed (void) const
+{
+  return m_failed;
+}
+
+uint64_t
+MyApp::GetPeerRx (void) const
+{
+  return m_swarm ? m_swarm->peerRx : 0;
+}
+
+uint64_t
+MyApp::GetServedTx (void) const
+{
+  return m_swarm ? m_swarm->servedTx : 0;
+}
+
+void
+MyApp::AddFile (std::string name, std::string content)
+{
+  if (!m_held)
+    {
+      m_held = new MftpChunkStore;
+      m_held->SetAverageChunkSize (m_dedupChunkSize);
+    }
+  m_held->Put (name, content);
+}
+
+void
+MyApp::SetDedupChunkSize (uint32_t bytes)
+{
+  m_dedupChunkSize = bytes;
+  if (m_held)
+    {
+      m_held->SetAverageChunkSize (bytes);
+    }
+}
+
+uint32_t
+MyApp::GetDedupChunkSize (void) const
+{
+  return m_dedupChunkSize;
+}
+
+uint64_t
+MyApp::GetDeltaReused (void) const
+{
+  return m_deltaReused;
+}
+
+void
+MyApp::SaveState (std::ostream &os) const
+{
+  bool started = Application::m_startTime <= Simulator::Now ();
+  os << "client " << started
+     << " " << m_startTime.GetNanoSeconds ()
+     << " " << Application::m_stopTime.GetNanoSeconds ()
+     << " " << m_finishTime.GetNanoSeconds ()
+     << " " << m_replies
+     << " " << m_totalRx
+     << " " << m_latencySum.GetNanoSeconds ()
+     << " " << m_latencyMax.GetNanoSeconds ()
+     << " " << m_srtt.GetNanoSeconds ()
+     << " " << m_rttvar.GetNanoSeconds ()
+     << " " << m_rto.GetNanoSeconds ()
+     << " " << m_timeouts
+     << " " << m_failed
+     << " " << m_deltaReused << "\n";
+  if (m_held)
+    {
+      m_held->Save (os);
+    }
+  else
+    {
+      os << "files 0\n";
+    }
+}
+
+bool
+MyApp::LoadState (std::istream &is, Time at)
+{
+  std::string word;
+  bool started;
+  int64_t start, stop, finish, latencySum, latencyMax, srtt, rttvar, rto;
+  if (!(is >> word >> started >> start >> stop >> finish >> m_replies >> m_totalRx
+        >> latencySum >> latencyMax >> srtt >> rttvar >> rto >> m_timeouts
+        >> m_failed >> m_deltaReused) || word != "client")
+    {
+      return false;
+    }
+  if (!m_held)
+    {
+      m_held = new MftpChunkStore;
+      m_held->SetAverageChunkSize (m_dedupChunkSize);
+    }
+  if (!m_held->Load (is))
+    {
+      return false;
+    }
+
+  m_current_command = m_replies;
+  m_resentUpTo = m_replies;
+  m_latencySum = NanoSeconds (latencySum);
+  m_latencyMax = NanoSeconds (latencyMax);
+  m_srtt = NanoSeconds (srtt);
+  m_rttvar = NanoSeconds (rttvar);
+  m_rto = NanoSeconds (rto);
+  if (started)
+    {
+      m_restored = true;
+      m_startTime = NanoSeconds (start);
+      m_finishTime = NanoSeconds (finish);
+      SetStartTime (at);
+      if (stop != 0)
+        {
+          SetStopTime (Max (NanoSeconds (stop), at));
+        }
+    }
+  else if (Application::m_startTime < at)
+    {
+      SetStartTime (at);
+    }
+  return true;
+}
+
+std::string
+MyApp::WireCommand (uint32_t i) const
+{
+  const std::string &command = GetCommand (i);
+  std::string wire = m_deltaFetch && 0 == command.compare (0, 4, "GET ")
+    ? DeltaCommand (command) : command;
+  if (m_mux)
+    {
+      // stream 0 is the connection, so command i goes on stream i + 1
+      std::ostringstream prefix;
+      prefix << "S" << i + 1 << " ";
+      wire.insert (0, prefix.str ());
+    }
+  return wire;
+}
+
+std::string
+MyApp::DeltaCommand (const std::string &command) const
+{
+  std::string name = command.substr (4, command.size () - 6);
+  std::string delta = "DELTA " + name;
+  const std::vector<uint64_t> *recipe = m_held ? m_held->GetRecipe (name) : 0;
+  if (recipe)
+    {
+      std::vector<uint64_t> ids (*recipe);
+      std::sort (ids.begin (), ids.end ());
+      ids.erase (std::unique (ids.begin (), ids.end ()), ids.end ());
+      for (uint32_t k = 0; k < ids.size (); k++)
+        {
+          char hex[18];
+          std::snprintf (hex, sizeof (hex), " %016llx", (unsigned long long) ids[k]);
+          delta += hex;
+        }
+    }
+  return delta + "\n\n";
+}
+
+const std::string &
+MyApp::GetCommand (uint32_t i) const
+{
+  return m_swarm ? m_swarm->commands[i] : m_config->commands[i];
+}
+
+uint32_t
+MyApp::GetCommandCount (void) const
+{
+  return m_swarm ? m_swarm->commands.size () : m_config->commands.size ();
+}
+
 void
 MyApp::StartApplication (void)
 {
   NS_LOG_INFO("CLIENT StartApplication");
   NS_LOG_FUNCTION_NOARGS();
+  if (m_restored)
+    {
+      // resumed from a checkpoint: keep the original start time
+      if (!m_finishTime.IsZero () || m_failed
+          || (!Application::m_stopTime.IsZero () && Application::m_stopTime <= Simulator::Now ()))
+        {
+          return;
+        }
+    }
+  else
+    {
+      m_startTime = Simulator::Now ();
+    }
   m_running = true;
   m_packetsSent = 0;
-  if (InetSocketAddress::IsMatchingType (m_peer))
+  if (m_swarmEnabled)
+    {
+      StartSwarm ();
+    }
+  if (m_multiplex && !m_mux)
+    {
+      m_mux = new MuxState;
+    }
+  m_sendTimes.resize (GetCommandCount ());
+  OpenSocket ();
+  SendNextCommand();
+  
+}
+
+void
+MyApp::OpenSocket (void)
+{
+  if (!m_socket)
+    {
+      // created only now, so clients that have not started or have
+      // finished hold no socket
+      m_socket = MftpCreateSocket (GetNode (), m_tid, m_tcpVariant,
+                                   m_sndBufSize, m_rcvBufSize);
+    }
+  if (InetSocketAddress::IsMatchingType (m_config->peer))
     {
       NS_LOG_INFO("CLIENT Calling Bind");
       m_socket->Bind ();
@@ -102,28 +548,165 @@ MyApp::StartApplication (void)
     }
 
   m_socket->SetRecvCallback (MakeCallback (&MyApp::HandleRead, this));
-  m_socket->Connect (m_peer);
-  SendNextCommand();
-  
+  m_socket->Connect (m_config->peer);
+  if (m_mux)
+    {
+      // sets the window of every stream opened on this connection
+      std::ostringstream credit;
+      credit << "CREDIT 0 " << m_streamWindow << "\n\n";
+      SendPacket (credit.str ());
+    }
 }
 
 void
 MyApp::SendNextCommand(void)
 {
-  const char * commands[] = { "Foobar\n\n", 
-                              "GET UNKNOWNFILE\n\n", 
-                              "GET little.txt\n\n",
-                              "GET big.txt\n\n",
-                              "GET huge.txt\n\n",
-			      "GET giant.txt\n\n"
-                      };
+  if (!m_socket)
+    {
+      return;
+    }
+  if (m_sendTimes.size () < GetCommandCount ())
+    {
+      // swarm mode adds commands as manifests come in
+      m_sendTimes.resize (GetCommandCount ());
+    }
 
-  if (m_current_command < 6)//4
+  // with PipelineDepth 1 this sends one command per reply
+  bool taken = true;
+  while (taken)
   {
-    SendPacket (commands[m_current_command], strlen(commands[m_current_command])+1); 
-    m_current_command++;
+    taken = false;
+    while (m_current_command < GetCommandCount ()
+           && m_current_command < m_replies + m_pipelineDepth)
+    {
+      uint32_t request = m_current_command++;
+      if (m_mux && TakePushed (request))
+      {
+        taken = true;
+        continue;
+      }
+      std::string command = WireCommand (request);
+      MftpTraceWriter::Record (MFTP_EV_REQUEST_START, GetNode ()->GetId (),
+                               request, 0, command.size ());
+      m_sendTimes[request] = Simulator::Now ();
+      SendPacket (command);
+      ArmTimer (request);
+    }
+    if (taken)
+    {
+      // answered on the spot, which may make room for more
+      DeliverReplies ();
+    }
   }
 }
+
+bool
+MyApp::TakePushed (uint32_t request)
+{
+  const std::string &command = GetCommand (request);
+  if (m_deltaFetch || m_swarm || 0 != command.compare (0, 4, "GET "))
+    {
+      return false;
+    }
+  std::string name = command.substr (4, command.size () - 6);
+  std::map<std::string, std::string>::iterator push = m_mux->pushed.find (name);
+  if (push == m_mux->pushed.end ())
+    {
+      return false;
+    }
+
+  // the server still hears of it, to count the push used and the step
+  // in the file sequence; its reply is dropped as already answered
+  std::ostringstream used;
+  used << "S" << request + 1 << " PUSHED " << name << "\n\n";
+  MftpTraceWriter::Record (MFTP_EV_REQUEST_START, GetNode ()->GetId (),
+                           request, 0, used.str ().size ());
+  SendPacket (used.str ());
+  MftpTraceWriter::Record (MFTP_EV_REQUEST_END, GetNode ()->GetId (),
+                           request, std::atoi (push->second.c_str ()), push->second.size ());
+  m_sendTimes[request] = Simulator::Now ();
+  m_mux->done[request].swap (push->second);
+  m_mux->pushed.erase (push);
+  return true;
+}
+
+void
+MyApp::ArmTimer (uint32_t request)
+{
+  Time timeout = m_rto;
+  for (uint32_t i = 0; i < m_attempts && timeout < m_maxRto; i++)
+    {
+      timeout = timeout * 2;
+    }
+  timeout = Min (timeout, m_maxRto);
+  m_config->timers->Schedule (timeout, MakeCallback (&MyApp::HandleTimeout, this),
+                              ((uint64_t) m_epoch << 32) | request);
+}
+
+void
+MyApp::HandleTimeout (uint64_t cookie)
+{
+  uint32_t epoch = cookie >> 32;
+  uint32_t request = cookie & 0xffffffff;
+  if (!m_running || !m_socket || epoch != m_epoch || request < m_replies
+      || (m_mux && m_mux->done.count (request)))
+    {
+      // answered, or voided by a reconnect
+      return;
+    }
+
+  m_timeouts++;
+  if (m_attempts++ == m_maxRetries)
+    {
+      NS_LOG_WARN ("CLIENT giving up after " << m_attempts << " timeouts on command " << request);
+      m_failed = true;
+      ReleaseSocket ();
+      return;
+    }
+
+  // replies come back in order on one connection, so a late one stalls
+  // everything behind it: start over on a new connection and resend
+  // whatever is unanswered
+  NS_LOG_INFO ("CLIENT command " << request << " timed out, reconnecting");
+  m_epoch++;
+  ReleaseSocket ();
+  m_rxBuffer.clear ();
+  if (m_mux)
+    {
+      m_mux->streams.clear ();
+      m_mux->pushes.clear ();
+    }
+  OpenSocket ();
+  for (uint32_t i = m_replies; i < m_current_command; i++)
+    {
+      if (m_mux && m_mux->done.count (i))
+        {
+          continue;
+        }
+      std::string command = WireCommand (i);
+      SendPacket (command);
+      ArmTimer (i);
+    }
+  m_resentUpTo = m_current_command;
+}
+
+void
+MyApp::UpdateRto (Time sample)
+{
+  // RFC 6298, on application response times
+  if (m_srtt.IsZero ())
+    {
+      m_srtt = sample;
+      m_rttvar = sample / 2;
+    }
+  else
+    {
+      Time delta = m_srtt > sample ? m_srtt - sample : sample - m_srtt;
+      m_rttvar = (m_rttvar * 3 + delta) / 4;
+      m_srtt = (m_srtt * 7 + sample) / 8;
+    }
+  m_rto = Max (m_minRto, Min (m_maxRto, m_srtt + m_rttvar * 4));
+}
 //add to header
 
 void
@@ -131,17 +714,528 @@ MyApp::HandleRead(Ptr<Socket> socket)
 {
   NS_LOG_INFO ("CLIENT HandleRead");
   Address from;
-  Ptr<Packet> packet = socket->RecvFrom (from);
+  Ptr<Packet> packet;
 
-    if (packet !=0){ 
+  // the server writes large replies in chunks, so a reply may span
+  // several reads and one read may hold several replies
+  while ((packet = socket->RecvFrom (from)))
+  {
     	uint8_t  *buffer = new uint8_t [packet->GetSize()];
     	packet->CopyData(buffer, packet->GetSize());
-    	std::string s = std::string((char*)buffer);
+    	m_rxBuffer.append ((char*)buffer, packet->GetSize());
+    	m_totalRx += packet->GetSize();
     	delete [] buffer;
+    	if (m_rxTrace)
+    	{
+    	  (*m_rxTrace) (packet, from);
+    	}
+  }
 
+  if (m_mux)
+    {
+      HandleFrames ();
+      return;
+    }
+  std::string s;
+  while (MftpExtractReply (m_rxBuffer, s))
+  {
     	NS_LOG_INFO ("CLIENT Received Packet. Payload = '" << s <<"'");
+    	// replies come back in command order
+    	RecordReply (m_replies, s);
+    	AcceptReply (s);
+    	SendNextCommand();
   }
-  SendNextCommand();
+}
+
+void
+MyApp::HandleFrames (void)
+{
+  std::string::size_type newline;
+  while ((newline = m_rxBuffer.find ('\n')) != std::string::npos)
+    {
+      char *next;
+      uint32_t stream = std::strtoul (m_rxBuffer.c_str () + 1, &next, 10);
+      if (m_rxBuffer[0] == 'P' && stream != 0 && *next == ' ')
+        {
+          // "P<stream> <file>\n": the stream carries a file not asked for
+          std::string::size_type blank = next - m_rxBuffer.c_str ();
+          m_mux->pushes[stream] = m_rxBuffer.substr (blank + 1, newline - blank - 1);
+          m_rxBuffer.erase (0, newline + 1);
+          continue;
+        }
+      // "D<stream> <length>\n" then length bytes of the stream's reply
+      uint32_t length = std::strtoul (next, 0, 10);
+      if (m_rxBuffer[0] != 'D' || stream == 0 || *next != ' ')
+        {
+          NS_LOG_WARN ("CLIENT malformed frame, dropping " << m_rxBuffer.size () << " bytes");
+          m_rxBuffer.clear ();
+          return;
+        }
+      if (m_rxBuffer.size () < newline + 1 + length)
+        {
+          break;
+        }
+      uint32_t request = stream - 1;
+      std::map<uint32_t, std::string>::iterator push = m_mux->pushes.find (stream);
+      if (push == m_mux->pushes.end ()
+          && (request < m_replies || request >= m_current_command || m_mux->done.count (request)))
+        {
+          // a stream answered already
+          m_rxBuffer.erase (0, newline + 1 + length);
+          continue;
+        }
+      MuxState::Stream &rx = m_mux->streams[stream];
+      rx.buffer.append (m_rxBuffer, newline + 1, length);
+      m_rxBuffer.erase (0, newline + 1 + length);
+
+      std::string reply;
+      if (MftpExtractReply (rx.buffer, reply))
+        {
+          NS_LOG_INFO ("CLIENT Received reply on stream " << stream << ". Payload = '" << reply << "'");
+          m_mux->streams.erase (stream);
+          if (push != m_mux->pushes.end ())
+            {
+              if (0 == reply.compare (0, 7, "200 OK "))
+                {
+                  m_mux->pushed[push->second].swap (reply);
+                }
+              m_mux->pushes.erase (push);
+              continue;
+            }
+          RecordReply (request, reply);
+          m_mux->done[request].swap (reply);
+        }
+      else if ((rx.unacked += length) >= m_streamWindow / 2)
+        {
+          // half the window consumed: let the server send as much again
+          std::ostringstream credit;
+          credit << "CREDIT " << stream << " " << rx.unacked << "\n\n";
+          SendPacket (credit.str ());
+          rx.unacked = 0;
+        }
+    }
+
+  DeliverReplies ();
+  SendNextCommand ();
+}
+
+void
+MyApp::DeliverReplies (void)
+{
+  // act on replies in command order, as without multiplexing
+  std::map<uint32_t, std::string>::iterator first;
+  while ((first = m_mux->done.begin ()) != m_mux->done.end ()
+         && first->first == m_replies)
+    {
+      std::string reply;
+      reply.swap (first->second);
+      m_mux->done.erase (first);
+      AcceptReply (reply);
+    }
+}
+
+void
+MyApp::RecordReply (uint32_t request, const std::string &reply)
+{
+  MftpTraceWriter::Record (MFTP_EV_REQUEST_END, GetNode ()->GetId (),
+                           request, std::atoi (reply.c_str ()), reply.size ());
+  if (request < m_current_command)
+    {
+      Time latency = Simulator::Now () - m_sendTimes[request];
+      m_latencySum += latency;
+      m_latencyMax = Max (m_latencyMax, latency);
+      // Karn: a resent command's reply may answer either copy
+      if (request >= m_resentUpTo)
+        {
+          UpdateRto (latency);
+        }
+    }
+  m_attempts = 0;
+}
+
+void
+MyApp::AcceptReply (const std::string &reply)
+{
+  if (m_deltaFetch)
+    {
+      HandleDeltaReply (GetCommand (m_replies), reply);
+    }
+  if (m_swarm)
+    {
+      // copied: the reply may grow the command list
+      std::string command = GetCommand (m_replies);
+      HandleSwarmReply (command, reply);
+    }
+  m_replies++;
+  CheckFinished ();
+}
+
+void
+MyApp::CheckFinished (void)
+{
+  if (!m_finishTime.IsZero () || m_replies < GetCommandCount ()
+      || (m_swarm && m_swarm->pending > 0))
+    {
+      return;
+    }
+  m_finishTime = Simulator::Now ();
+  // the send times are only needed while replies are outstanding
+  std::vector<Time> ().swap (m_sendTimes);
+  ReleaseSocket ();
+}
+
+void
+MyApp::HandleDeltaReply (const std::string &command, const std::string &reply)
+{
+  if (0 != command.compare (0, 4, "GET ") || 0 != reply.compare (0, 7, "200 OK "))
+    {
+      return;
+    }
+  std::string name = command.substr (4, command.size () - 6);
+  std::string::size_type pos = reply.find ("\n\n") + 2;
+  const char *p = reply.c_str () + pos;
+  char *next;
+  uint64_t size = std::strtoull (p, &next, 10);
+  uint32_t chunks = std::strtoul (next, &next, 10);
+  pos = next - reply.c_str () + 1;
+
+  std::string content;
+  content.reserve (size);
+  uint64_t reused = 0;
+  for (uint32_t c = 0; c < chunks && pos < reply.size (); c++)
+    {
+      char kind = reply[pos];
+      uint64_t id = std::strtoull (reply.c_str () + pos + 2, &next, 16);
+      if (kind == '=')
+        {
+          const std::string *chunk = m_held ? m_held->GetChunk (id) : 0;
+          if (!chunk)
+            {
+              // replaced since the DELTA went out
+              NS_LOG_WARN ("CLIENT lost chunk " << id << " of " << name);
+              return;
+            }
+          content += *chunk;
+          reused += chunk->size ();
+          pos = next - reply.c_str () + 1;
+        }
+      else
+        {
+          uint32_t length = std::strtoul (next, &next, 10);
+          pos = next - reply.c_str () + 1;
+          content.append (reply, pos, length);
+          pos += length;
+        }
+    }
+  if (content.size () != size)
+    {
+      NS_LOG_WARN ("CLIENT malformed delta for " << name);
+      return;
+    }
+  m_deltaReused += reused;
+  AddFile (name, content);
+}
+
+void
+MyApp::StartSwarm (void)
+{
+  if (!m_swarm)
+    {
+      m_swarm = new SwarmState;
+      m_swarm->pick = CreateObject<UniformRandomVariable> ();
+    }
+  m_swarm->pending = 0;
+  m_swarm->peerRx = 0;
+  m_swarm->servedTx = 0;
+  m_swarm->commands.clear ();
+  for (uint32_t i = 0; i < m_config->commands.size (); i++)
+    {
+      const std::string &command = m_config->commands[i];
+      if (0 == command.compare (0, 4, "GET "))
+        {
+          m_swarm->commands.push_back ("MANIFEST " + command.substr (4));
+        }
+      else
+        {
+          m_swarm->commands.push_back (command);
+        }
+    }
+
+  Address local;
+  if (InetSocketAddress::IsMatchingType (m_config->peer))
+    {
+      local = InetSocketAddress (Ipv4Address::GetAny (), m_swarmPort);
+    }
+  else
+    {
+      local = Inet6SocketAddress (Ipv6Address::GetAny (), m_swarmPort);
+    }
+  m_swarm->listener = MftpCreateSocket (GetNode (), m_tid, m_tcpVariant,
+                                        m_sndBufSize, m_rcvBufSize);
+  m_swarm->listener->Bind (local);
+  m_swarm->listener->Listen ();
+  m_swarm->listener->SetAcceptCallback (
+    MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+    MakeCallback (&MyApp::HandleSwarmAccept, this));
+}
+
+void
+MyApp::StopSwarm (void)
+{
+  if (m_swarm->listener)
+    {
+      m_swarm->listener->Close ();
+      m_swarm->listener = 0;
+    }
+  for (std::map<Ptr<Socket>, std::string>::iterator i = m_swarm->serving.begin ();
+       i != m_swarm->serving.end (); ++i)
+    {
+      Ptr<Socket> socket = i->first;
+      socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      socket->SetCloseCallbacks (MakeNullCallback<void, Ptr<Socket> > (),
+                                 MakeNullCallback<void, Ptr<Socket> > ());
+      socket->Close ();
+    }
+  m_swarm->serving.clear ();
+  for (std::map<Address, SwarmState::PeerLink>::iterator i = m_swarm->peers.begin ();
+       i != m_swarm->peers.end (); ++i)
+    {
+      Ptr<Socket> socket = i->second.socket;
+      socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      socket->SetCloseCallbacks (MakeNullCallback<void, Ptr<Socket> > (),
+                                 MakeNullCallback<void, Ptr<Socket> > ());
+      socket->Close ();
+    }
+  m_swarm->peers.clear ();
+}
+
+void
+MyApp::HandleSwarmReply (const std::string &command, const std::string &reply)
+{
+  if (0 != reply.compare (0, 7, "200 OK "))
+    {
+      return;
+    }
+  std::string body = reply.substr (reply.find ("\n\n") + 2);
+  std::istringstream in (command);
+  std::string verb;
+  std::string file;
+  in >> verb >> file;
+
+  if (verb == "CHUNK")
+    {
+      uint32_t chunk;
+      in >> chunk;
+      StoreChunk (file, chunk, body, false);
+    }
+  else if (verb == "MANIFEST")
+    {
+      std::istringstream manifest (body);
+      uint32_t size;
+      uint32_t chunkSize;
+      uint32_t chunks;
+      manifest >> size >> chunkSize >> chunks;
+      std::vector<std::vector<Address> > holders (chunks);
+      std::string line;
+      while (std::getline (manifest, line))
+        {
+          std::istringstream fields (line);
+          uint32_t chunk;
+          Address peer;
+          if (!(fields >> chunk) || chunk >= chunks)
+            {
+              continue;
+            }
+          while (MftpParsePeer (fields, peer))
+            {
+              holders[chunk].push_back (peer);
+            }
+        }
+      for (uint32_t c = 0; c < chunks; c++)
+        {
+          if (m_swarm->chunks[file].count (c) == 0)
+            {
+              FetchChunk (file, c, holders[c]);
+            }
+        }
+    }
+}
+
+void
+MyApp::FetchChunk (const std::string &file, uint32_t chunk, const std::vector<Address> &holders)
+{
+  std::ostringstream command;
+  command << "CHUNK " << file << " " << chunk << "\n\n";
+  if (holders.empty ())
+    {
+      m_swarm->commands.push_back (command.str ());
+      return;
+    }
+
+  const Address &peer = holders[m_swarm->pick->GetInteger (0, holders.size () - 1)];
+  SwarmState::PeerLink &link = m_swarm->peers[peer];
+  if (!link.socket)
+    {
+      link.socket = MftpCreateSocket (GetNode (), m_tid, m_tcpVariant,
+                                      m_sndBufSize, m_rcvBufSize);
+      if (InetSocketAddress::IsMatchingType (peer))
+        {
+          link.socket->Bind ();
+        }
+      else
+        {
+          link.socket->Bind6 ();
+        }
+      link.socket->SetRecvCallback (MakeCallback (&MyApp::HandlePeerReply, this));
+      link.socket->SetConnectCallback (
+        MakeNullCallback<void, Ptr<Socket> > (),
+        MakeCallback (&MyApp::HandlePeerLinkClose, this));
+      link.socket->SetCloseCallbacks (
+        MakeCallback (&MyApp::HandlePeerLinkClose, this),
+        MakeCallback (&MyApp::HandlePeerLinkClose, this));
+      link.socket->Connect (peer);
+    }
+  std::string payload = command.str ();
+  link.socket->Send (Create<Packet> ((const uint8_t *) payload.c_str (), payload.size () + 1));
+  link.pending.push_back (std::make_pair (file, chunk));
+  m_swarm->pending++;
+}
+
+void
+MyApp::StoreChunk (const std::string &file, uint32_t chunk, const std::string &body, bool fromPeer)
+{
+  m_swarm->chunks[file][chunk] = body;
+  if (fromPeer)
+    {
+      m_swarm->peerRx += body.size ();
+    }
+  std::ostringstream have;
+  have << "HAVE " << file << " " << chunk << " " << m_swarmPort << "\n\n";
+  m_swarm->commands.push_back (have.str ());
+}
+
+void
+MyApp::HandlePeerReply (Ptr<Socket> socket)
+{
+  std::map<Address, SwarmState::PeerLink>::iterator it = m_swarm->peers.begin ();
+  while (it != m_swarm->peers.end () && it->second.socket != socket)
+    {
+      ++it;
+    }
+  if (it == m_swarm->peers.end ())
+    {
+      return;
+    }
+  SwarmState::PeerLink &link = it->second;
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      std::string::size_type offset = link.rxBuffer.size ();
+      link.rxBuffer.resize (offset + packet->GetSize ());
+      packet->CopyData ((uint8_t *) &link.rxBuffer[offset], packet->GetSize ());
+    }
+
+  std::string reply;
+  while (!link.pending.empty () && MftpExtractReply (link.rxBuffer, reply))
+    {
+      std::pair<std::string, uint32_t> asked = link.pending.front ();
+      link.pending.pop_front ();
+      m_swarm->pending--;
+      if (0 == reply.compare (0, 7, "200 OK "))
+        {
+          StoreChunk (asked.first, asked.second, reply.substr (reply.find ("\n\n") + 2), true);
+        }
+      else
+        {
+          // the peer no longer has it
+          FetchChunk (asked.first, asked.second, std::vector<Address> ());
+        }
+    }
+  SendNextCommand ();
+  CheckFinished ();
+}
+
+void
+MyApp::HandlePeerLinkClose (Ptr<Socket> socket)
+{
+  std::map<Address, SwarmState::PeerLink>::iterator it = m_swarm->peers.begin ();
+  while (it != m_swarm->peers.end () && it->second.socket != socket)
+    {
+      ++it;
+    }
+  if (it == m_swarm->peers.end ())
+    {
+      return;
+    }
+  NS_LOG_INFO ("CLIENT peer link lost, " << it->second.pending.size ()
+               << " chunks go back to the server");
+  std::deque<std::pair<std::string, uint32_t> > pending;
+  pending.swap (it->second.pending);
+  m_swarm->peers.erase (it);
+  for (uint32_t i = 0; i < pending.size (); i++)
+    {
+      m_swarm->pending--;
+      FetchChunk (pending[i].first, pending[i].second, std::vector<Address> ());
+    }
+  SendNextCommand ();
+  CheckFinished ();
+}
+
+void
+MyApp::HandleSwarmAccept (Ptr<Socket> socket, const Address &from)
+{
+  socket->SetRecvCallback (MakeCallback (&MyApp::HandleSwarmRequest, this));
+  socket->SetCloseCallbacks (MakeCallback (&MyApp::HandleSwarmClose, this),
+                             MakeCallback (&MyApp::HandleSwarmClose, this));
+  m_swarm->serving[socket];
+}
+
+void
+MyApp::HandleSwarmRequest (Ptr<Socket> socket)
+{
+  std::string &pending = m_swarm->serving[socket];
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      std::string::size_type offset = pending.size ();
+      pending.resize (offset + packet->GetSize ());
+      packet->CopyData ((uint8_t *) &pending[offset], packet->GetSize ());
+    }
+
+  std::string::size_type end;
+  while ((end = pending.find ("\n\n")) != std::string::npos)
+    {
+      std::string::size_type begin = pending.find_first_not_of ('\0');
+      MftpCommand command;
+      MftpParseCommand (pending.data () + begin, end - begin, command);
+      MftpToken rest = command.args;
+      MftpToken file;
+      MftpToken word;
+      uint64_t chunk = 0;
+      bool valid = command.verb == MFTP_VERB_CHUNK && MftpNextWord (rest, file)
+        && MftpNextWord (rest, word) && MftpWordToNumber (word, 10, chunk);
+
+      std::string reply = "550 File Unavailable\n\n";
+      std::map<std::string, std::map<uint32_t, std::string> >::const_iterator f;
+      std::map<uint32_t, std::string>::const_iterator c;
+      if (valid
+          && (f = m_swarm->chunks.find (std::string (file.data, file.size))) != m_swarm->chunks.end ()
+          && (c = f->second.find (chunk)) != f->second.end ())
+        {
+          std::ostringstream ok;
+          ok << "200 OK " << c->second.size () << "\n\n" << c->second;
+          reply = ok.str ();
+          m_swarm->servedTx += c->second.size ();
+        }
+      pending.erase (0, end + 2);
+      socket->Send (Create<Packet> ((const uint8_t *) reply.c_str (), reply.size () + 1));
+    }
+}
+
+void
+MyApp::HandleSwarmClose (Ptr<Socket> socket)
+{
+  m_swarm->serving.erase (socket);
 }
 
 void
@@ -155,38 +1249,56 @@ MyApp::StopApplication (void)
       Simulator::Cancel (m_sendEvent);
     }
 
+  ReleaseSocket ();
+  if (m_swarm)
+    {
+      StopSwarm ();
+    }
+}
+
+void
+MyApp::ReleaseSocket (void)
+{
   if (m_socket)
     {
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
       m_socket->Close ();
+      m_socket = 0;
     }
+  // commands still to repeat under --nPackets have nowhere to go
+  Simulator::Cancel (m_sendEvent);
 }
 
 void
-MyApp::SendPacket (const char * payload, uint32_t packetSize)
+MyApp::SendPacket (std::string payload)
 {
   NS_LOG_INFO("CLIENT SendPacket");
+  if (!m_socket)
+    {
+      return;
+    }
 
-  Ptr<Packet> packet = Create<Packet> ((const uint8_t*)payload , packetSize);
+  Ptr<Packet> packet = Create<Packet> ((const uint8_t*)payload.c_str (), payload.size () + 1);
   NS_LOG_INFO ("CLIENT Sending MSG '" << payload << "' to SERVER");
   m_socket->Send (packet);
   NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
                           << "s CLIENT sent "
                           <<  packet->GetSize () << " bytes");
 
-  if (++m_packetsSent < m_nPackets)
+  if (++m_packetsSent < m_config->nPackets)
     {
-      ScheduleTx (payload, packetSize);
+      ScheduleTx (payload);
     }
 }
 
 void
-MyApp::ScheduleTx (const char * payload, uint32_t packetSize)
+MyApp::ScheduleTx (std::string payload)
 {
   NS_LOG_INFO("CLIENT ScheduleTx");
   if (m_running)
     {
-      Time tNext (Seconds (m_packetSize * 8 / static_cast<double> (m_dataRate.GetBitRate ())));
-      m_sendEvent = Simulator::Schedule (tNext, &MyApp::SendPacket, this, payload, packetSize);
+      Time tNext (Seconds (m_config->packetSize * 8 / static_cast<double> (m_config->dataRate.GetBitRate ())));
+      m_sendEvent = Simulator::Schedule (tNext, &MyApp::SendPacket, this, payload);
     }
 }
 
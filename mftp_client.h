@@ -22,9 +22,30 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/stats-module.h"
+#include "mftp_timer_wheel.h"
+#include "mftp_chunk_store.h"
+#include <string>
+#include <vector>
 
 namespace ns3 {
 
+/**
+ * \brief Settings shared read-only by every MyApp of a run.
+ *
+ * MyAppHelper creates one and hands it to each application it installs,
+ * so per-client memory does not grow with the command list.
+ */
+struct MyAppConfig : public SimpleRefCount<MyAppConfig>
+{
+  MyAppConfig ();
+
+  Address                  peer;       //!< Server address
+  uint32_t                 packetSize; //!< Bytes assumed per send when pacing repeats
+  uint32_t                 nPackets;   //!< Copies of each command to send
+  DataRate                 dataRate;   //!< Pace of repeated sends
+  std::vector<std::string> commands;   //!< Commands in order, with "\n\n" terminators
+  Ptr<MftpTimerWheel>      timers;     //!< Request timeouts of every client
+};
 
 class MyApp : public Application
 {
@@ -38,29 +59,312 @@ public:
    */
   static TypeId GetTypeId (void);
   void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate);
+  /**
+   * \brief Hand over the socket, keeping the configuration set by the helper
+   *
+   * Optional: without it the application creates a socket of its
+   * Protocol type when it starts.
+   *
+   * \param socket the socket to connect to the server
+   */
+  void Setup (Ptr<Socket> socket);
+  /**
+   * \param config the shared configuration
+   */
+  void SetConfig (Ptr<const MyAppConfig> config);
+
+  /**
+   * \return the total reply bytes received by this client
+   */
+  uint64_t GetTotalRx (void) const;
+
+  /**
+   * \return the number of complete replies received
+   */
+  uint32_t GetRepliesReceived (void) const;
+
+  /**
+   * \return the number of commands sent and not yet answered
+   */
+  uint32_t GetOutstanding (void) const;
+
+  /**
+   * \return the sum of the response times of all replies received
+   */
+  Time GetTotalLatency (void) const;
+
+  /**
+   * \return the longest response time seen
+   */
+  Time GetMaxLatency (void) const;
+
+  /**
+   * \return the time from application start to the last reply, or zero
+   * if not every command was answered
+   */
+  Time GetCompletionTime (void) const;
+
+  /**
+   * \brief Get the time the client was fetching
+   * \param start set to when the application started
+   * \param end set to its last reply, its stop time or now, whichever
+   * came first
+   * \return false if the application has not started
+   */
+  bool GetActiveSpan (Time &start, Time &end) const;
+
+  /**
+   * \return the number of request timeouts, each followed by a retry or
+   * by giving up
+   */
+  uint32_t GetTimeouts (void) const;
+
+  /**
+   * \return true if the client gave up after MaxRetries timeouts
+   */
+  bool HasFailed (void) const;
+
+  /**
+   * \return the chunk bytes downloaded from other clients in swarm mode
+   */
+  uint64_t GetPeerRx (void) const;
+
+  /**
+   * \return the chunk bytes served to other clients in swarm mode
+   */
+  uint64_t GetServedTx (void) const;
+
+  /**
+   * \brief Give the client a copy of a file, such as an older version,
+   * that DeltaFetch can reuse chunks of
+   * \param name the file name
+   * \param content the file body
+   */
+  void AddFile (std::string name, std::string content);
+
+  /**
+   * \return file bytes DeltaFetch took from copies already held
+   * instead of downloading them
+   */
+  uint64_t GetDeltaReused (void) const;
+
+  /**
+   * \brief Write progress, statistics and held files, for MftpCheckpoint
+   * \param os the stream to write to
+   */
+  void SaveState (std::ostream &os) const;
+
+  /**
+   * \brief Restore what SaveState wrote.
+   *
+   * A client that had started resumes at the checkpoint with its old
+   * stop time, on a new connection, from its first unanswered command;
+   * one that had finished, failed or stopped stays idle.  Any other
+   * starts no earlier than the checkpoint.  Swarm state is not saved.
+   *
+   * \param is the stream to read from
+   * \param at the time the checkpoint was taken
+   * \return false on a malformed stream
+   */
+  bool LoadState (std::istream &is, Time at);
 
 private:
-  int m_current_command;
   virtual void StartApplication (void);
   virtual void StopApplication (void);
   void HandleRead(Ptr<Socket> socket);
-  void ScheduleTx (const char * payload, uint32_t packetSize);
-  void SendPacket (const char * payload, uint32_t packetSize);
+  /**
+   * \brief Send again after the packet time, while --nPackets asks for more
+   * \param payload the command; held by the event, so it is a copy
+   */
+  void ScheduleTx (std::string payload);
+  /**
+   * \param payload the command, sent with its terminating NUL
+   */
+  void SendPacket (std::string payload);
   void SendNextCommand(void);
+  /**
+   * \brief Create, bind and connect the socket if there is none
+   */
+  void OpenSocket (void);
+  /**
+   * \brief Arm the timeout of a command just sent
+   * \param request index of the command
+   */
+  void ArmTimer (uint32_t request);
+  /**
+   * \brief Timer wheel expiry
+   * \param cookie connection epoch in the high word, request index in the low
+   */
+  void HandleTimeout (uint64_t cookie);
+  /**
+   * \brief Feed a response time into the timeout estimate
+   * \param sample the response time of a command sent only once
+   */
+  void UpdateRto (Time sample);
+  /**
+   * \brief Close and drop the socket once it is no longer needed
+   */
+  void ReleaseSocket (void);
+  /**
+   * \param i index of a command
+   * \return the command, from the configuration or the swarm list
+   */
+  const std::string &GetCommand (uint32_t i) const;
+  /**
+   * \return the number of commands to send so far
+   */
+  uint32_t GetCommandCount (void) const;
+  /**
+   * \brief Record the finish and drop the server connection once every
+   * command and chunk download is answered
+   */
+  void CheckFinished (void);
+  /**
+   * \param i index of a command
+   * \return the command as sent, a GET turned into DELTA with DeltaFetch
+   * and prefixed with its stream with Multiplex
+   */
+  std::string WireCommand (uint32_t i) const;
+  /**
+   * \param command a GET command
+   * \return the DELTA command listing the chunks held of its file
+   */
+  std::string DeltaCommand (const std::string &command) const;
+  /**
+   * \param bytes mean chunk size of the held files
+   */
+  void SetDedupChunkSize (uint32_t bytes);
+  /**
+   * \return mean chunk size of the held files
+   */
+  uint32_t GetDedupChunkSize (void) const;
+  /**
+   * \brief Rebuild a file from a DELTA reply and keep it
+   * \param command the GET the reply answers
+   * \param reply the reply
+   */
+  void HandleDeltaReply (const std::string &command, const std::string &reply);
+  /**
+   * \brief Account the response time of a reply
+   * \param request index of the command it answers
+   * \param reply the reply
+   */
+  void RecordReply (uint32_t request, const std::string &reply);
+  /**
+   * \brief Act on the reply to the first unanswered command
+   * \param reply the reply
+   */
+  void AcceptReply (const std::string &reply);
 
-  Address         m_local;        //!< Local address to bind to
-  TypeId          m_tid;          //!< Protocol TypeId
-  Ptr<Socket>     m_socket;
-  Address         m_peer;
-  uint32_t        m_packetSize;
-  uint32_t        m_nPackets;
-  DataRate        m_dataRate;
-  EventId         m_sendEvent;
-  bool            m_running;
-  uint32_t        m_packetsSent;
+  /// Multiplexing state, allocated only when Multiplex is set.
+  struct MuxState;
+  /**
+   * \brief Split the receive buffer into stream frames and take the
+   * replies they complete, which may arrive out of command order
+   */
+  void HandleFrames (void);
+  /**
+   * \brief Act on the replies gathered for the first unanswered commands
+   */
+  void DeliverReplies (void);
+  /**
+   * \brief Answer a GET from a file the server pushed, if it pushed it
+   * \param request index of the command about to be sent
+   * \return true if the command is answered and was not sent as GET
+   */
+  bool TakePushed (uint32_t request);
+
+  /// Swarm mode state, allocated only when Swarm is set.
+  struct SwarmState;
+  /**
+   * \brief Open the chunk listener and turn GETs into MANIFESTs
+   */
+  void StartSwarm (void);
+  /**
+   * \brief Close the chunk listener and every peer connection
+   */
+  void StopSwarm (void);
+  /**
+   * \brief Act on a server reply in swarm mode
+   * \param command the command it answers
+   * \param reply the reply
+   */
+  void HandleSwarmReply (const std::string &command, const std::string &reply);
+  /**
+   * \brief Download a chunk from one of its holders, or from the server
+   * \param file the file name
+   * \param chunk the chunk index
+   * \param holders clients that announced the chunk
+   */
+  void FetchChunk (const std::string &file, uint32_t chunk, const std::vector<Address> &holders);
+  /**
+   * \brief Keep a downloaded chunk and announce it to the tracker
+   * \param file the file name
+   * \param chunk the chunk index
+   * \param body the chunk
+   * \param fromPeer true if a client rather than the server sent it
+   */
+  void StoreChunk (const std::string &file, uint32_t chunk, const std::string &body, bool fromPeer);
+  void HandlePeerReply (Ptr<Socket> socket);
+  /**
+   * \brief A peer connection failed or closed: get its chunks from the server
+   * \param socket the peer connection
+   */
+  void HandlePeerLinkClose (Ptr<Socket> socket);
+  void HandleSwarmAccept (Ptr<Socket> socket, const Address &from);
+  /**
+   * \brief Answer CHUNK requests from another client
+   * \param socket the accepted connection
+   */
+  void HandleSwarmRequest (Ptr<Socket> socket);
+  void HandleSwarmClose (Ptr<Socket> socket);
 
   /// Traced Callback: received packets, source address.
-  TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
+  typedef TracedCallback<Ptr<const Packet>, const Address &> RxTrace;
+
+  // members are ordered largest first to keep the object small
+  std::string     m_rxBuffer;     //!< Reply bytes not yet parsed
+  std::string     m_tcpVariant;   //!< TCP congestion control, empty for default
+  EventId         m_sendEvent;
+  std::vector<Time> m_sendTimes;  //!< Send time of each command, while running
+  Ptr<const MyAppConfig> m_config; //!< Shared settings
+  Ptr<Socket>     m_socket;
+  RxTrace        *m_rxTrace;      //!< Created on first connection, else null
+  SwarmState     *m_swarm;        //!< Swarm mode state, else null
+  MftpChunkStore *m_held;         //!< Files held for DeltaFetch, else null
+  MuxState       *m_mux;          //!< Multiplexing state, else null
+  uint64_t        m_totalRx;      //!< Total reply bytes received
+  uint64_t        m_deltaReused;  //!< File bytes rebuilt from held chunks
+  Time            m_startTime;    //!< When the application started
+  Time            m_finishTime;   //!< When the last reply arrived
+  Time            m_latencySum;   //!< Sum of response times
+  Time            m_latencyMax;   //!< Longest response time
+  Time            m_srtt;         //!< Smoothed response time
+  Time            m_rttvar;       //!< Response time variation
+  Time            m_rto;          //!< Current timeout, before backoff
+  Time            m_minRto;       //!< Lower bound of the timeout
+  Time            m_maxRto;       //!< Upper bound of the timeout
+  uint32_t        m_current_command;
+  uint32_t        m_packetsSent;
+  uint32_t        m_pipelineDepth; //!< Commands allowed in flight
+  uint32_t        m_replies;      //!< Complete replies received
+  uint32_t        m_sndBufSize;   //!< TCP send buffer, 0 for default
+  uint32_t        m_rcvBufSize;   //!< TCP receive buffer, 0 for default
+  uint32_t        m_epoch;        //!< Bumped on reconnect to void old timers
+  uint32_t        m_resentUpTo;   //!< Commands below this were sent twice
+  uint32_t        m_attempts;     //!< Timeouts since the last reply
+  uint32_t        m_maxRetries;   //!< Timeouts tolerated before giving up
+  uint32_t        m_timeouts;     //!< Timeouts over the whole run
+  uint32_t        m_streamWindow; //!< Bytes a stream may receive ahead of credit
+  uint32_t        m_dedupChunkSize; //!< Mean chunk size of held files
+  TypeId          m_tid;          //!< Protocol TypeId
+  uint16_t        m_swarmPort;    //!< Port the chunk listener binds to
+  bool            m_failed;       //!< Gave up on the server
+  bool            m_swarmEnabled; //!< Share chunks with other clients
+  bool            m_deltaFetch;   //!< Fetch files as deltas to held copies
+  bool            m_multiplex;    //!< Tag commands with streams, take framed replies
+  bool            m_restored;     //!< Resumed from a checkpoint
+  bool            m_running;
 
 };
 
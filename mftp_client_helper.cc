@@ -32,7 +32,14 @@ MyAppHelper::MyAppHelper (std::string protocol, Address address)
   m_factory.SetTypeId ("ns3::MyApp");
   std::cout << "Debug MyappHelper 2\n";
   m_factory.Set ("Protocol", StringValue (protocol));
-  m_factory.Set ("Local", AddressValue (address));
+  m_config = Create<MyAppConfig> ();
+  m_config->peer = address;
+}
+
+Ptr<MyAppConfig>
+MyAppHelper::GetConfig (void) const
+{
+  return m_config;
 }
 
 void 
@@ -69,7 +76,8 @@ MyAppHelper::Install (NodeContainer c) const
 Ptr<Application>
 MyAppHelper::InstallPriv (Ptr<Node> node) const
 {
-  Ptr<Application> app = m_factory.Create<Application> ();
+  Ptr<MyApp> app = m_factory.Create<MyApp> ();
+  app->SetConfig (m_config);
   node->AddApplication (app);
 
   return app;
@@ -48,6 +48,12 @@ public:
    */
   MyAppHelper (std::string protocol, Address address);
 
+  /**
+   * \return the configuration shared by every application this helper
+   * installs; change it before calling Install
+   */
+  Ptr<MyAppConfig> GetConfig (void) const;
+
   /**
    * Helper function used to set the underlying application attributes.
    *
@@ -94,6 +100,7 @@ private:
    */
   Ptr<Application> InstallPriv (Ptr<Node> node) const;
   ObjectFactory m_factory; //!< Object factory.
+  Ptr<MyAppConfig> m_config; //!< Shared by the installed applications
 };
 
 }; // namespace ns3
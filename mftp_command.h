@@ -0,0 +1,316 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_COMMAND_H
+#define MFTP_COMMAND_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/*
+ * Allocation-free parsing of MiniFTP commands.  Like mftp_trace_format.h
+ * this header has no ns-3 dependency, so tools/mftp_command_bench.cc can
+ * fuzz and time the same code the server runs.
+ *
+ * A command is "<VERB> <arguments>", optionally followed by its "\n\n"
+ * terminator.  Every verb takes at least one argument.  The verb is
+ * found with one hash and one comparison: the FNV-1a hash of each verb,
+ * modulo MFTP_VERB_SLOTS, picks a distinct slot, and the slot table is
+ * computed by the compiler from g_mftpVerbs.  A static_assert rejects a
+ * verb list the hash does not keep apart; grow MFTP_VERB_SLOTS then.
+ *
+ * MftpExtractReply, at the end, splits replies off the bytes a client
+ * of the server receives.
+ */
+
+/// Commands the server understands.
+enum MftpVerb
+{
+  MFTP_VERB_UNKNOWN = 0,
+  MFTP_VERB_GET,      //!< GET <file>
+  MFTP_VERB_DELTA,    //!< DELTA <file> <chunk id>...
+  MFTP_VERB_MANIFEST, //!< MANIFEST <file>
+  MFTP_VERB_CHUNK,    //!< CHUNK <file> <chunk>
+  MFTP_VERB_HAVE,     //!< HAVE <file> <chunk> <port>
+  MFTP_VERB_CREDIT,   //!< CREDIT <stream> <bytes>
+  MFTP_VERB_PUSHED    //!< PUSHED <file>
+};
+
+/// Bytes inside a buffer owned by someone else.
+struct MftpToken
+{
+  const char *data; //!< First byte
+  uint32_t    size; //!< Number of bytes
+};
+
+/// A parsed command; its tokens point into the parsed buffer.
+struct MftpCommand
+{
+  MftpVerb  verb; //!< The verb, MFTP_VERB_UNKNOWN if not understood
+  MftpToken args; //!< Everything after the verb and its blank
+};
+
+/// A verb and its spelling.
+struct MftpVerbName
+{
+  const char *name;   //!< Spelling on the wire
+  uint32_t    length; //!< Characters in name
+  MftpVerb    verb;   //!< The verb
+};
+
+constexpr MftpVerbName g_mftpVerbs[] = {
+  { "GET", 3, MFTP_VERB_GET },
+  { "DELTA", 5, MFTP_VERB_DELTA },
+  { "MANIFEST", 8, MFTP_VERB_MANIFEST },
+  { "CHUNK", 5, MFTP_VERB_CHUNK },
+  { "HAVE", 4, MFTP_VERB_HAVE },
+  { "CREDIT", 6, MFTP_VERB_CREDIT },
+  { "PUSHED", 6, MFTP_VERB_PUSHED }
+};
+constexpr uint32_t MFTP_VERB_COUNT = sizeof (g_mftpVerbs) / sizeof (g_mftpVerbs[0]);
+constexpr uint32_t MFTP_VERB_SLOTS = 10;
+
+/**
+ * \param s the bytes to hash
+ * \param n the number of bytes
+ * \param h the hash so far
+ * \return the 32-bit FNV-1a hash of the bytes
+ */
+constexpr uint32_t
+MftpHashVerb (const char *s, uint32_t n, uint32_t h = 2166136261u)
+{
+  return n == 0 ? h : MftpHashVerb (s + 1, n - 1, (h ^ (uint8_t) *s) * 16777619u);
+}
+
+/**
+ * \return the slot of verb i of g_mftpVerbs
+ */
+constexpr uint32_t
+MftpVerbSlot (uint32_t i)
+{
+  return MftpHashVerb (g_mftpVerbs[i].name, g_mftpVerbs[i].length) % MFTP_VERB_SLOTS;
+}
+
+/**
+ * \return the index in g_mftpVerbs of the verb in a slot, or
+ * MFTP_VERB_COUNT for an empty slot
+ */
+constexpr uint32_t
+MftpVerbInSlot (uint32_t slot, uint32_t i = 0)
+{
+  return i == MFTP_VERB_COUNT ? MFTP_VERB_COUNT
+    : MftpVerbSlot (i) == slot ? i : MftpVerbInSlot (slot, i + 1);
+}
+
+/**
+ * \return true if no two verbs from i on share a slot
+ */
+constexpr bool
+MftpVerbSlotsDistinct (uint32_t i = 0, uint32_t j = 1)
+{
+  return i == MFTP_VERB_COUNT ? true
+    : j == MFTP_VERB_COUNT ? MftpVerbSlotsDistinct (i + 1, i + 2)
+    : MftpVerbSlot (i) != MftpVerbSlot (j) && MftpVerbSlotsDistinct (i, j + 1);
+}
+
+static_assert (MftpVerbSlotsDistinct (), "MFTP_VERB_SLOTS is too small for a perfect hash");
+static_assert (MFTP_VERB_SLOTS == 10, "the slot table below lists 10 slots");
+
+constexpr uint32_t g_mftpVerbSlots[MFTP_VERB_SLOTS] = {
+  MftpVerbInSlot (0), MftpVerbInSlot (1), MftpVerbInSlot (2), MftpVerbInSlot (3),
+  MftpVerbInSlot (4), MftpVerbInSlot (5), MftpVerbInSlot (6), MftpVerbInSlot (7),
+  MftpVerbInSlot (8), MftpVerbInSlot (9)
+};
+
+/**
+ * \brief Parse a command in place.
+ * \param data the command, with or without its terminator
+ * \param size bytes in data
+ * \param command set to the verb and arguments
+ * \return the verb, MFTP_VERB_UNKNOWN if not understood
+ */
+inline MftpVerb
+MftpParseCommand (const char *data, uint32_t size, MftpCommand &command)
+{
+  command.verb = MFTP_VERB_UNKNOWN;
+  command.args.data = data;
+  command.args.size = 0;
+
+  const char *newline = (const char *) memchr (data, '\n', size);
+  uint32_t end = newline ? newline - data : size;
+  const char *blank = (const char *) memchr (data, ' ', end);
+  if (!blank || blank + 1 == data + end)
+    {
+      return MFTP_VERB_UNKNOWN;
+    }
+  uint32_t length = blank - data;
+  uint32_t index = g_mftpVerbSlots[MftpHashVerb (data, length) % MFTP_VERB_SLOTS];
+  if (index == MFTP_VERB_COUNT || g_mftpVerbs[index].length != length
+      || memcmp (g_mftpVerbs[index].name, data, length) != 0)
+    {
+      return MFTP_VERB_UNKNOWN;
+    }
+  command.verb = g_mftpVerbs[index].verb;
+  command.args.data = blank + 1;
+  command.args.size = end - length - 1;
+  return command.verb;
+}
+
+/**
+ * \brief Strip the stream prefix of a multiplexed command.
+ *
+ * A client that multiplexes writes "S<stream> " before each command and
+ * gets the reply back in "D<stream> <length>\n" frames; see PacketSink.
+ *
+ * \param data the command; advanced past the prefix
+ * \param size bytes in data; reduced by the prefix
+ * \return the stream, 0 if the command has no prefix
+ */
+inline uint32_t
+MftpParseStream (const char *&data, uint32_t &size)
+{
+  if (size < 3 || data[0] != 'S' || data[1] < '1' || data[1] > '9')
+    {
+      return 0;
+    }
+  uint32_t stream = 0;
+  uint32_t i = 1;
+  while (i < size && data[i] >= '0' && data[i] <= '9' && stream < 100000000)
+    {
+      stream = stream * 10 + (data[i++] - '0');
+    }
+  if (i == size || data[i] != ' ')
+    {
+      return 0;
+    }
+  data += i + 1;
+  size -= i + 1;
+  return stream;
+}
+
+/**
+ * \brief Split the next blank-separated word off a token.
+ * \param rest the bytes still to split; advanced past the word
+ * \param word set to the word
+ * \return false if rest holds no more words
+ */
+inline bool
+MftpNextWord (MftpToken &rest, MftpToken &word)
+{
+  while (rest.size > 0 && *rest.data == ' ')
+    {
+      rest.data++;
+      rest.size--;
+    }
+  if (rest.size == 0)
+    {
+      return false;
+    }
+  word.data = rest.data;
+  word.size = 0;
+  while (rest.size > 0 && *rest.data != ' ')
+    {
+      rest.data++;
+      rest.size--;
+      word.size++;
+    }
+  return true;
+}
+
+/**
+ * \brief Read a word as a number.
+ * \param word the word
+ * \param base 10 or 16
+ * \param value set to the number
+ * \return false if the word is not a number that fits 64 bits
+ */
+inline bool
+MftpWordToNumber (MftpToken word, uint32_t base, uint64_t &value)
+{
+  if (word.size == 0)
+    {
+      return false;
+    }
+  value = 0;
+  for (uint32_t i = 0; i < word.size; i++)
+    {
+      char c = word.data[i];
+      uint32_t digit;
+      if (c >= '0' && c <= '9')
+        {
+          digit = c - '0';
+        }
+      else if (base == 16 && c >= 'a' && c <= 'f')
+        {
+          digit = c - 'a' + 10;
+        }
+      else if (base == 16 && c >= 'A' && c <= 'F')
+        {
+          digit = c - 'A' + 10;
+        }
+      else
+        {
+          return false;
+        }
+      if (value > (UINT64_MAX - digit) / base)
+        {
+          return false;
+        }
+      value = value * base + digit;
+    }
+  return true;
+}
+
+/**
+ * \brief Take one complete reply off a receive buffer.
+ *
+ * A file reply is "200 OK <length>\n\n<body>", anything else is a bare
+ * status line; either way a NUL follows.
+ *
+ * \param buffer reply bytes as received; the reply is removed
+ * \param reply set to the reply, without its trailing NUL
+ * \return false if no complete reply has arrived yet
+ */
+inline bool
+MftpExtractReply (std::string &buffer, std::string &reply)
+{
+  std::string::size_type begin = buffer.find_first_not_of ('\0');
+  if (begin == std::string::npos)
+    {
+      buffer.clear ();
+      return false;
+    }
+  std::string::size_type header = buffer.find ("\n\n", begin);
+  if (header == std::string::npos)
+    {
+      return false;
+    }
+  std::string::size_type end = header + 2;
+  if (0 == buffer.compare (begin, 7, "200 OK "))
+    {
+      end += strtoul (buffer.c_str () + begin + 7, 0, 10);
+    }
+  if (buffer.size () < end + 1)
+    {
+      return false;
+    }
+  reply = buffer.substr (begin, end - begin);
+  buffer.erase (0, end + 1);
+  return true;
+}
+
+#endif /* MFTP_COMMAND_H */
@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_counting_simulator.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (MftpCountingSimulatorImpl);
+
+uint64_t MftpCountingSimulatorImpl::m_events = 0;
+
+TypeId
+MftpCountingSimulatorImpl::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MftpCountingSimulatorImpl")
+    .SetParent<DefaultSimulatorImpl> ()
+    .SetGroupName ("Core")
+    .AddConstructor<MftpCountingSimulatorImpl> ()
+  ;
+  return tid;
+}
+
+MftpCountingSimulatorImpl::MftpCountingSimulatorImpl ()
+{
+}
+
+uint64_t
+MftpCountingSimulatorImpl::GetEventCount (void)
+{
+  return m_events;
+}
+
+EventId
+MftpCountingSimulatorImpl::Schedule (Time const &delay, EventImpl *event)
+{
+  m_events++;
+  return DefaultSimulatorImpl::Schedule (delay, event);
+}
+
+void
+MftpCountingSimulatorImpl::ScheduleWithContext (uint32_t context, Time const &delay, EventImpl *event)
+{
+  m_events++;
+  DefaultSimulatorImpl::ScheduleWithContext (context, delay, event);
+}
+
+EventId
+MftpCountingSimulatorImpl::ScheduleNow (EventImpl *event)
+{
+  m_events++;
+  return DefaultSimulatorImpl::ScheduleNow (event);
+}
+
+EventId
+MftpCountingSimulatorImpl::ScheduleDestroy (EventImpl *event)
+{
+  m_events++;
+  return DefaultSimulatorImpl::ScheduleDestroy (event);
+}
+
+} // namespace ns3
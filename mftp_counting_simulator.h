@@ -0,0 +1,61 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_COUNTING_SIMULATOR_H
+#define MFTP_COUNTING_SIMULATOR_H
+
+#include "ns3/default-simulator-impl.h"
+
+namespace ns3 {
+
+/**
+ * \brief The default simulator, counting every event it schedules.
+ *
+ * Select it before the first event is scheduled with
+ * \code
+ *   GlobalValue::Bind ("SimulatorImplementationType",
+ *                      StringValue ("ns3::MftpCountingSimulatorImpl"));
+ * \endcode
+ */
+class MftpCountingSimulatorImpl : public DefaultSimulatorImpl
+{
+public:
+  /**
+   * Register this type.
+   * \return The TypeId.
+   */
+  static TypeId GetTypeId (void);
+
+  MftpCountingSimulatorImpl ();
+
+  /**
+   * \return the number of events scheduled so far, including destroy
+   * events and events that were later cancelled
+   */
+  static uint64_t GetEventCount (void);
+
+  // inherited from SimulatorImpl
+  virtual EventId Schedule (Time const &delay, EventImpl *event);
+  virtual void ScheduleWithContext (uint32_t context, Time const &delay, EventImpl *event);
+  virtual EventId ScheduleNow (EventImpl *event);
+  virtual EventId ScheduleDestroy (EventImpl *event);
+
+private:
+  static uint64_t m_events; //!< Events scheduled so far
+};
+
+} // namespace ns3
+
+#endif /* MFTP_COUNTING_SIMULATOR_H */
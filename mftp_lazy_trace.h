@@ -0,0 +1,99 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_LAZY_TRACE_H
+#define MFTP_LAZY_TRACE_H
+
+#include "ns3/trace-source-accessor.h"
+
+namespace ns3 {
+
+/**
+ * \brief Trace source accessor for a traced callback held by pointer.
+ *
+ * The object keeps only a null pointer until someone connects to the
+ * trace source; the TracedCallback is allocated on the first connection.
+ * The owner fires the trace only when the pointer is set and deletes it
+ * on destruction.
+ *
+ * \param member the pointer-to-member holding the traced callback
+ * \return the accessor to pass to TypeId::AddTraceSource
+ */
+template <typename T, typename TC>
+Ptr<const TraceSourceAccessor>
+MakeLazyTraceSourceAccessor (TC *T::*member)
+{
+  struct Accessor : public TraceSourceAccessor
+  {
+    virtual bool ConnectWithoutContext (ObjectBase *obj, const CallbackBase &cb) const
+    {
+      TC *source = Get (obj, true);
+      if (source == 0)
+        {
+          return false;
+        }
+      source->ConnectWithoutContext (cb);
+      return true;
+    }
+    virtual bool Connect (ObjectBase *obj, std::string context, const CallbackBase &cb) const
+    {
+      TC *source = Get (obj, true);
+      if (source == 0)
+        {
+          return false;
+        }
+      source->Connect (cb, context);
+      return true;
+    }
+    virtual bool DisconnectWithoutContext (ObjectBase *obj, const CallbackBase &cb) const
+    {
+      TC *source = Get (obj, false);
+      if (source != 0)
+        {
+          source->DisconnectWithoutContext (cb);
+        }
+      return dynamic_cast<T *> (obj) != 0;
+    }
+    virtual bool Disconnect (ObjectBase *obj, std::string context, const CallbackBase &cb) const
+    {
+      TC *source = Get (obj, false);
+      if (source != 0)
+        {
+          source->Disconnect (cb, context);
+        }
+      return dynamic_cast<T *> (obj) != 0;
+    }
+    TC *Get (ObjectBase *obj, bool create) const
+    {
+      T *owner = dynamic_cast<T *> (obj);
+      if (owner == 0)
+        {
+          return 0;
+        }
+      if (owner->*m_member == 0 && create)
+        {
+          owner->*m_member = new TC ();
+        }
+      return owner->*m_member;
+    }
+    TC *T::*m_member;
+  } *accessor = new Accessor ();
+  accessor->m_member = member;
+  return Ptr<const TraceSourceAccessor> (accessor, false);
+}
+
+} // namespace ns3
+
+#endif /* MFTP_LAZY_TRACE_H */
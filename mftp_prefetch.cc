@@ -0,0 +1,190 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_prefetch.h"
+
+namespace ns3 {
+
+MftpPrefetcher::Stats::Stats ()
+  : hits (0),
+    misses (0),
+    prefetches (0),
+    prefetchHits (0),
+    prefetchBytes (0),
+    prefetchHitBytes (0),
+    pushes (0),
+    pushHits (0),
+    pushBytes (0),
+    pushHitBytes (0)
+{
+}
+
+MftpPrefetcher::MftpPrefetcher ()
+  : m_cacheSize (0),
+    m_cacheUsed (0)
+{
+}
+
+void
+MftpPrefetcher::SetCacheSize (uint32_t bytes)
+{
+  m_cacheSize = bytes;
+  Shrink (bytes);
+}
+
+uint32_t
+MftpPrefetcher::GetCacheSize (void) const
+{
+  return m_cacheSize;
+}
+
+void
+MftpPrefetcher::Observe (const std::string &client, const std::string &from, const std::string &to)
+{
+  Successors &successors = m_tables[client][from];
+  successors.counts[to]++;
+  successors.total++;
+}
+
+double
+MftpPrefetcher::Predict (const std::string &client, const std::string &from, std::string &next) const
+{
+  std::map<std::string, std::map<std::string, Successors> >::const_iterator table = m_tables.find (client);
+  if (table == m_tables.end ())
+    {
+      return 0;
+    }
+  std::map<std::string, Successors>::const_iterator successors = table->second.find (from);
+  if (successors == table->second.end ())
+    {
+      return 0;
+    }
+  // ties go to the first name, so runs stay deterministic
+  uint32_t best = 0;
+  for (std::map<std::string, uint32_t>::const_iterator i = successors->second.counts.begin ();
+       i != successors->second.counts.end (); ++i)
+    {
+      if (i->second > best)
+        {
+          best = i->second;
+          next = i->first;
+        }
+    }
+  return (double) best / successors->second.total;
+}
+
+const std::string *
+MftpPrefetcher::Lookup (const std::string &name)
+{
+  std::map<std::string, Entry>::iterator entry = m_cache.find (name);
+  if (entry == m_cache.end ())
+    {
+      m_stats.misses++;
+      return 0;
+    }
+  m_stats.hits++;
+  if (entry->second.predicted)
+    {
+      m_stats.prefetchHits++;
+      m_stats.prefetchHitBytes += entry->second.reply.size ();
+      entry->second.predicted = false;
+    }
+  m_lru.splice (m_lru.begin (), m_lru, entry->second.use);
+  return &entry->second.reply;
+}
+
+const std::string *
+MftpPrefetcher::Peek (const std::string &name) const
+{
+  std::map<std::string, Entry>::const_iterator entry = m_cache.find (name);
+  return entry == m_cache.end () ? 0 : &entry->second.reply;
+}
+
+void
+MftpPrefetcher::Insert (const std::string &name, const std::string &reply, bool predicted)
+{
+  if (reply.size () > m_cacheSize || m_cache.count (name))
+    {
+      return;
+    }
+  Shrink (m_cacheSize - reply.size ());
+  m_lru.push_front (name);
+  Entry &entry = m_cache[name];
+  entry.reply = reply;
+  entry.use = m_lru.begin ();
+  entry.predicted = predicted;
+  m_cacheUsed += reply.size ();
+  if (predicted)
+    {
+      m_stats.prefetches++;
+      m_stats.prefetchBytes += reply.size ();
+    }
+}
+
+void
+MftpPrefetcher::Erase (const std::string &name)
+{
+  std::map<std::string, Entry>::iterator entry = m_cache.find (name);
+  if (entry == m_cache.end ())
+    {
+      return;
+    }
+  m_cacheUsed -= entry->second.reply.size ();
+  m_lru.erase (entry->second.use);
+  m_cache.erase (entry);
+}
+
+void
+MftpPrefetcher::Clear (void)
+{
+  m_cache.clear ();
+  m_lru.clear ();
+  m_cacheUsed = 0;
+}
+
+void
+MftpPrefetcher::Shrink (uint32_t bytes)
+{
+  while (m_cacheUsed > bytes)
+    {
+      std::map<std::string, Entry>::iterator entry = m_cache.find (m_lru.back ());
+      m_cacheUsed -= entry->second.reply.size ();
+      m_cache.erase (entry);
+      m_lru.pop_back ();
+    }
+}
+
+void
+MftpPrefetcher::CountPush (uint32_t bytes)
+{
+  m_stats.pushes++;
+  m_stats.pushBytes += bytes;
+}
+
+void
+MftpPrefetcher::CountPushHit (uint32_t bytes)
+{
+  m_stats.pushHits++;
+  m_stats.pushHitBytes += bytes;
+}
+
+const MftpPrefetcher::Stats &
+MftpPrefetcher::GetStats (void) const
+{
+  return m_stats;
+}
+
+} // namespace ns3
@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_PREFETCH_H
+#define MFTP_PREFETCH_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+/*
+ * A server that pushes a predicted file to a multiplexing client
+ * announces it before its frames:
+ *
+ *   P<stream> <file>\n     the "D<stream>" frames that follow carry the
+ *                          reply a GET of the file would get
+ *
+ * A client that answers a GET from a pushed copy still tells the server,
+ * on the command's own stream:
+ *
+ *   PUSHED <file>          250 Noted
+ */
+
+namespace ns3 {
+
+/**
+ * \brief Successor statistics over file names and the reply cache they
+ * warm.
+ *
+ * Each GET is counted as the successor of the previous file the same
+ * connection asked for, in one table per client or in a single table
+ * shared by all.  The most frequent successor is the prediction, with
+ * its share of all successors seen as confidence.
+ *
+ * Replies are cached whole, least recently used first out, so a GET
+ * skips reassembling the file from the chunk store.  Entries put in on
+ * a prediction are counted until used or evicted, as are files pushed
+ * to clients, to tell how often a prediction paid off and how many bytes
+ * it cost when it did not.
+ */
+class MftpPrefetcher
+{
+public:
+  MftpPrefetcher ();
+
+  /**
+   * \brief Bound the cache, evicting entries that no longer fit
+   * \param bytes the cache capacity, 0 to cache nothing
+   */
+  void SetCacheSize (uint32_t bytes);
+  /**
+   * \return the cache capacity in bytes
+   */
+  uint32_t GetCacheSize (void) const;
+
+  /**
+   * \brief Count one transition
+   * \param client the table to count in, empty for the shared one
+   * \param from the file asked for before
+   * \param to the file asked for next
+   */
+  void Observe (const std::string &client, const std::string &from, const std::string &to);
+  /**
+   * \param client the table to look in, empty for the shared one
+   * \param from the file just asked for
+   * \param next set to the most frequent successor of from
+   * \return the share of transitions out of from that went to next, 0
+   * if none were seen
+   */
+  double Predict (const std::string &client, const std::string &from, std::string &next) const;
+
+  /**
+   * \brief Find a cached reply and mark it recently used
+   * \param name the file name
+   * \return the reply, or null on a miss
+   */
+  const std::string *Lookup (const std::string &name);
+  /**
+   * \param name the file name
+   * \return the cached reply, or null, without counting a use
+   */
+  const std::string *Peek (const std::string &name) const;
+  /**
+   * \brief Cache a reply, evicting the least recently used as needed
+   * \param name the file name
+   * \param reply the reply
+   * \param predicted true if put in on a prediction rather than a GET
+   */
+  void Insert (const std::string &name, const std::string &reply, bool predicted);
+  /**
+   * \brief Drop a cached reply, e.g. because the file changed
+   * \param name the file name
+   */
+  void Erase (const std::string &name);
+  /**
+   * \brief Drop every cached reply; the successor tables stay
+   */
+  void Clear (void);
+
+  /**
+   * \brief Count a file pushed to a client
+   * \param bytes the pushed reply size
+   */
+  void CountPush (uint32_t bytes);
+  /**
+   * \brief Count a pushed file the client used
+   * \param bytes the pushed reply size
+   */
+  void CountPushHit (uint32_t bytes);
+
+  /// Counters for the report.
+  struct Stats
+  {
+    uint64_t hits;             //!< GETs answered from the cache
+    uint64_t misses;           //!< GETs that reassembled the file
+    uint64_t prefetches;       //!< Replies cached on a prediction
+    uint64_t prefetchHits;     //!< Of those, used by a GET
+    uint64_t prefetchBytes;    //!< Bytes cached on a prediction
+    uint64_t prefetchHitBytes; //!< Of those, used by a GET
+    uint64_t pushes;           //!< Files pushed to clients
+    uint64_t pushHits;         //!< Of those, used by the client
+    uint64_t pushBytes;        //!< Bytes pushed
+    uint64_t pushHitBytes;     //!< Of those, used by the client
+    Stats ();
+  };
+  /**
+   * \return the counters so far; bytes cached or pushed and not used
+   * are the wasted ones
+   */
+  const Stats &GetStats (void) const;
+
+private:
+  /// Transitions out of one file.
+  struct Successors
+  {
+    std::map<std::string, uint32_t> counts; //!< Transitions per next file
+    uint32_t total;                         //!< Sum of counts
+    Successors () : total (0) {}
+  };
+  /// A cached reply.
+  struct Entry
+  {
+    std::string reply;                        //!< The reply
+    std::list<std::string>::iterator use;     //!< Place in m_lru
+    bool predicted;                           //!< Cached on a prediction, not used yet
+  };
+
+  /**
+   * \brief Evict least recently used entries until used bytes fit
+   * \param bytes the bytes to fit in
+   */
+  void Shrink (uint32_t bytes);
+
+  /// Per client, then per file, the files asked for next
+  std::map<std::string, std::map<std::string, Successors> > m_tables;
+  std::map<std::string, Entry> m_cache; //!< Cached replies by file
+  std::list<std::string> m_lru;         //!< Cached files, most recently used first
+  Stats    m_stats;      //!< Counters
+  uint32_t m_cacheSize;  //!< Capacity in bytes
+  uint32_t m_cacheUsed;  //!< Bytes of cached replies
+};
+
+} // namespace ns3
+
+#endif /* MFTP_PREFETCH_H */
@@ -0,0 +1,529 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_proxy.h"
+#include "mftp_command.h"
+#include "mftp_socket.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/uinteger.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/tcp-socket-factory.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MftpProxy");
+
+NS_OBJECT_ENSURE_REGISTERED (MftpProxy);
+
+TypeId
+MftpProxy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MftpProxy")
+    .SetParent<Application> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<MftpProxy> ()
+    .AddAttribute ("Local",
+                   "The Address on which clients connect.",
+                   AddressValue (),
+                   MakeAddressAccessor (&MftpProxy::m_local),
+                   MakeAddressChecker ())
+    .AddAttribute ("Origin",
+                   "The address of the server the proxy fetches from.",
+                   AddressValue (),
+                   MakeAddressAccessor (&MftpProxy::m_origin),
+                   MakeAddressChecker ())
+    .AddAttribute ("Protocol",
+                   "The type id of the protocol to use on both sides.",
+                   TypeIdValue (TcpSocketFactory::GetTypeId ()),
+                   MakeTypeIdAccessor (&MftpProxy::m_tid),
+                   MakeTypeIdChecker ())
+    .AddAttribute ("CacheSize",
+                   "Bytes of GET replies kept, least recently used first out. "
+                   "Zero caches nothing, leaving only the coalescing of "
+                   "concurrent fetches.",
+                   UintegerValue (1 << 20),
+                   MakeUintegerAccessor (&MftpProxy::SetCacheSize,
+                                         &MftpProxy::GetCacheSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("StreamWindow",
+                   "Bytes of one upstream reply the origin may send ahead "
+                   "of the proxy's credit.",
+                   UintegerValue (65535),
+                   MakeUintegerAccessor (&MftpProxy::m_window),
+                   MakeUintegerChecker<uint32_t> (2))
+  ;
+  return tid;
+}
+
+MftpProxy::MftpProxy ()
+  : m_requests (0),
+    m_hits (0),
+    m_coalesced (0),
+    m_fetches (0),
+    m_forwarded (0),
+    m_upstreamRx (0),
+    m_clientTx (0),
+    m_nextStream (1)
+{
+}
+
+MftpProxy::~MftpProxy ()
+{
+}
+
+uint64_t
+MftpProxy::GetRequestCount (void) const
+{
+  return m_requests;
+}
+
+uint64_t
+MftpProxy::GetHits (void) const
+{
+  return m_hits;
+}
+
+uint64_t
+MftpProxy::GetCoalesced (void) const
+{
+  return m_coalesced;
+}
+
+uint64_t
+MftpProxy::GetFetches (void) const
+{
+  return m_fetches;
+}
+
+uint64_t
+MftpProxy::GetForwarded (void) const
+{
+  return m_forwarded;
+}
+
+uint64_t
+MftpProxy::GetUpstreamRx (void) const
+{
+  return m_upstreamRx;
+}
+
+uint64_t
+MftpProxy::GetClientTx (void) const
+{
+  return m_clientTx;
+}
+
+void
+MftpProxy::SetCacheSize (uint32_t bytes)
+{
+  m_cache.SetCacheSize (bytes);
+}
+
+uint32_t
+MftpProxy::GetCacheSize (void) const
+{
+  return m_cache.GetCacheSize ();
+}
+
+void
+MftpProxy::DoDispose (void)
+{
+  m_socket = 0;
+  m_upstream = 0;
+  m_clients.clear ();
+  m_pending.clear ();
+  Application::DoDispose ();
+}
+
+void
+MftpProxy::StartApplication (void)
+{
+  if (!m_socket)
+    {
+      m_socket = MftpCreateSocket (GetNode (), m_tid, "", 0, 0);
+      m_socket->Bind (m_local);
+      m_socket->Listen ();
+    }
+  m_socket->SetAcceptCallback (
+    MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+    MakeCallback (&MftpProxy::HandleAccept, this));
+}
+
+void
+MftpProxy::StopApplication (void)
+{
+  // closing may call back into HandleClose, so work on a copy
+  std::vector<Ptr<Socket> > clients;
+  for (std::map<Ptr<Socket>, Client>::iterator i = m_clients.begin (); i != m_clients.end (); ++i)
+    {
+      clients.push_back (i->first);
+    }
+  m_clients.clear ();
+  for (uint32_t i = 0; i < clients.size (); i++)
+    {
+      clients[i]->Close ();
+    }
+  if (m_upstream)
+    {
+      m_upstream->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_upstream->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+      m_upstream->Close ();
+      m_upstream = 0;
+    }
+  m_upstreamTx.clear ();
+  if (m_socket)
+    {
+      m_socket->Close ();
+    }
+}
+
+void
+MftpProxy::HandleAccept (Ptr<Socket> socket, const Address &from)
+{
+  NS_LOG_INFO ("PROXY accepted a client");
+  Client &client = m_clients[socket];
+  client.first = 0;
+  socket->SetRecvCallback (MakeCallback (&MftpProxy::HandleRead, this));
+  socket->SetSendCallback (MakeCallback (&MftpProxy::HandleSend, this));
+  socket->SetCloseCallbacks (MakeCallback (&MftpProxy::HandleClose, this),
+                             MakeCallback (&MftpProxy::HandleClose, this));
+}
+
+void
+MftpProxy::HandleClose (Ptr<Socket> socket)
+{
+  // waiters on a closed client are skipped when their reply comes
+  m_clients.erase (socket);
+}
+
+void
+MftpProxy::HandleRead (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      if (packet->GetSize () == 0)
+        {
+          break;
+        }
+      std::map<Ptr<Socket>, Client>::iterator it = m_clients.find (socket);
+      if (it == m_clients.end ())
+        {
+          return;
+        }
+      std::string data (packet->GetSize (), '\0');
+      packet->CopyData ((uint8_t *) &data[0], data.size ());
+      std::string &pending = it->second.rxBuffer;
+      pending += data;
+
+      // split on the "\n\n" terminator, as PacketSink does
+      std::string::size_type end;
+      while ((end = pending.find ("\n\n")) != std::string::npos)
+        {
+          std::string::size_type begin = pending.find_first_not_of ('\0');
+          std::string command = pending.substr (begin, end + 2 - begin);
+          pending.erase (0, end + 2);
+          HandleRequest (socket, command);
+        }
+    }
+}
+
+void
+MftpProxy::HandleRequest (Ptr<Socket> socket, const std::string &command)
+{
+  m_requests++;
+  Client &client = m_clients[socket];
+  uint64_t slot = client.first + client.slots.size ();
+  Slot owed;
+  owed.ready = false;
+  client.slots.push_back (owed);
+
+  MftpCommand parsed;
+  if (MftpParseCommand (command.data (), command.size (), parsed) != MFTP_VERB_GET)
+    {
+      m_forwarded++;
+      uint32_t stream = SendUpstream (command);
+      m_pending[stream].waiters.push_back (std::make_pair (socket, slot));
+      return;
+    }
+
+  std::string name (parsed.args.data, parsed.args.size);
+  const std::string *cached = m_cache.Lookup (name);
+  if (cached)
+    {
+      m_hits++;
+      Fill (socket, slot, *cached);
+      return;
+    }
+  std::map<std::string, uint32_t>::iterator fetching = m_fetching.find (name);
+  if (fetching != m_fetching.end ())
+    {
+      m_coalesced++;
+      m_pending[fetching->second].waiters.push_back (std::make_pair (socket, slot));
+      return;
+    }
+  m_fetches++;
+  uint32_t stream = SendUpstream ("GET " + name + "\n\n");
+  m_fetching[name] = stream;
+  Upstream &upstream = m_pending[stream];
+  upstream.file = name;
+  upstream.waiters.push_back (std::make_pair (socket, slot));
+}
+
+void
+MftpProxy::Fill (Ptr<Socket> socket, uint64_t slot, const std::string &reply)
+{
+  std::map<Ptr<Socket>, Client>::iterator it = m_clients.find (socket);
+  if (it == m_clients.end () || slot < it->second.first
+      || slot - it->second.first >= it->second.slots.size ())
+    {
+      return;
+    }
+  Slot &owed = it->second.slots[slot - it->second.first];
+  owed.reply = reply;
+  owed.ready = true;
+  Flush (socket, it->second);
+}
+
+void
+MftpProxy::Flush (Ptr<Socket> socket, Client &client)
+{
+  while (!client.slots.empty () && client.slots.front ().ready)
+    {
+      client.txBuffer += client.slots.front ().reply;
+      client.txBuffer.push_back ('\0');
+      m_clientTx += client.slots.front ().reply.size () + 1;
+      client.slots.pop_front ();
+      client.first++;
+    }
+  while (!client.txBuffer.empty ())
+    {
+      uint32_t chunk = std::min<uint32_t> (socket->GetTxAvailable (), client.txBuffer.size ());
+      if (chunk == 0)
+        {
+          // HandleSend goes on once the buffer drains
+          return;
+        }
+      int sent = socket->Send ((const uint8_t *) client.txBuffer.data (), chunk, 0);
+      if (sent <= 0)
+        {
+          return;
+        }
+      client.txBuffer.erase (0, sent);
+    }
+}
+
+void
+MftpProxy::HandleSend (Ptr<Socket> socket, uint32_t available)
+{
+  std::map<Ptr<Socket>, Client>::iterator it = m_clients.find (socket);
+  if (it != m_clients.end ())
+    {
+      Flush (socket, it->second);
+    }
+}
+
+uint32_t
+MftpProxy::SendUpstream (const std::string &command)
+{
+  if (!m_upstream)
+    {
+      m_upstream = MftpCreateSocket (GetNode (), m_tid, "", 0, 0);
+      if (InetSocketAddress::IsMatchingType (m_origin))
+        {
+          m_upstream->Bind ();
+        }
+      else
+        {
+          m_upstream->Bind6 ();
+        }
+      m_upstream->SetRecvCallback (MakeCallback (&MftpProxy::HandleUpstreamRead, this));
+      m_upstream->SetCloseCallbacks (MakeCallback (&MftpProxy::HandleUpstreamClose, this),
+                                     MakeCallback (&MftpProxy::HandleUpstreamClose, this));
+      m_upstream->SetSendCallback (MakeCallback (&MftpProxy::HandleUpstreamSend, this));
+      // a refused connect reports no close, only the failure
+      m_upstream->SetConnectCallback (MakeNullCallback<void, Ptr<Socket> > (),
+                                      MakeCallback (&MftpProxy::HandleUpstreamClose, this));
+      m_upstream->Connect (m_origin);
+      std::ostringstream credit;
+      credit << "CREDIT 0 " << m_window << "\n\n";
+      WriteUpstream (credit.str ());
+    }
+
+  // replies come back framed per stream, in whatever order the origin
+  // finishes them
+  uint32_t stream = m_nextStream++;
+  std::ostringstream wire;
+  wire << "S" << stream << " " << command;
+  WriteUpstream (wire.str ());
+  m_pending[stream].unacked = 0;
+  return stream;
+}
+
+void
+MftpProxy::WriteUpstream (const std::string &wire)
+{
+  m_upstreamTx += wire;
+  m_upstreamTx.push_back ('\0');
+  FlushUpstream ();
+}
+
+void
+MftpProxy::FlushUpstream (void)
+{
+  while (m_upstream && !m_upstreamTx.empty ())
+    {
+      uint32_t chunk = std::min<uint32_t> (m_upstream->GetTxAvailable (), m_upstreamTx.size ());
+      if (chunk == 0)
+        {
+          // HandleUpstreamSend goes on once the buffer drains
+          return;
+        }
+      int sent = m_upstream->Send ((const uint8_t *) m_upstreamTx.data (), chunk, 0);
+      if (sent <= 0)
+        {
+          return;
+        }
+      m_upstreamTx.erase (0, sent);
+    }
+}
+
+void
+MftpProxy::HandleUpstreamSend (Ptr<Socket> socket, uint32_t available)
+{
+  if (socket == m_upstream)
+    {
+      FlushUpstream ();
+    }
+}
+
+void
+MftpProxy::HandleUpstreamRead (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      std::string data (packet->GetSize (), '\0');
+      packet->CopyData ((uint8_t *) &data[0], data.size ());
+      m_upstreamBuffer += data;
+      m_upstreamRx += data.size ();
+    }
+
+  std::string::size_type newline;
+  while ((newline = m_upstreamBuffer.find ('\n')) != std::string::npos)
+    {
+      if (m_upstreamBuffer[0] == 'P')
+        {
+          // a push from a prefetching origin; nobody here asked for it
+          m_upstreamBuffer.erase (0, newline + 1);
+          continue;
+        }
+      // "D<stream> <length>\n" then length bytes of the stream's reply
+      char *next;
+      uint32_t stream = std::strtoul (m_upstreamBuffer.c_str () + 1, &next, 10);
+      uint32_t length = std::strtoul (next, 0, 10);
+      if (m_upstreamBuffer[0] != 'D' || *next != ' ')
+        {
+          NS_LOG_WARN ("PROXY malformed frame from the origin");
+          HandleUpstreamClose (socket);
+          return;
+        }
+      if (m_upstreamBuffer.size () < newline + 1 + length)
+        {
+          break;
+        }
+      std::map<uint32_t, Upstream>::iterator upstream = m_pending.find (stream);
+      if (upstream == m_pending.end ())
+        {
+          m_upstreamBuffer.erase (0, newline + 1 + length);
+          continue;
+        }
+      upstream->second.buffer.append (m_upstreamBuffer, newline + 1, length);
+      m_upstreamBuffer.erase (0, newline + 1 + length);
+
+      std::string reply;
+      if (MftpExtractReply (upstream->second.buffer, reply))
+        {
+          CompleteUpstream (stream, reply);
+        }
+      else if ((upstream->second.unacked += length) >= m_window / 2)
+        {
+          std::ostringstream credit;
+          credit << "CREDIT " << stream << " " << upstream->second.unacked << "\n\n";
+          WriteUpstream (credit.str ());
+          upstream->second.unacked = 0;
+        }
+    }
+}
+
+void
+MftpProxy::CompleteUpstream (uint32_t stream, const std::string &reply)
+{
+  std::map<uint32_t, Upstream>::iterator it = m_pending.find (stream);
+  Upstream upstream;
+  upstream.waiters.swap (it->second.waiters);
+  upstream.file.swap (it->second.file);
+  m_pending.erase (it);
+
+  if (!upstream.file.empty ())
+    {
+      m_fetching.erase (upstream.file);
+      if (0 == reply.compare (0, 7, "200 OK "))
+        {
+          m_cache.Insert (upstream.file, reply, false);
+        }
+    }
+  for (uint32_t i = 0; i < upstream.waiters.size (); i++)
+    {
+      Fill (upstream.waiters[i].first, upstream.waiters[i].second, reply);
+    }
+}
+
+void
+MftpProxy::HandleUpstreamClose (Ptr<Socket> socket)
+{
+  NS_LOG_INFO ("PROXY lost the origin, failing " << m_pending.size () << " requests");
+  if (m_upstream)
+    {
+      m_upstream->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_upstream->SetCloseCallbacks (MakeNullCallback<void, Ptr<Socket> > (),
+                                     MakeNullCallback<void, Ptr<Socket> > ());
+      m_upstream->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+      m_upstream->SetConnectCallback (MakeNullCallback<void, Ptr<Socket> > (),
+                                      MakeNullCallback<void, Ptr<Socket> > ());
+      m_upstream->Close ();
+      m_upstream = 0;
+    }
+  m_upstreamBuffer.clear ();
+  m_upstreamTx.clear ();
+  m_fetching.clear ();
+  std::map<uint32_t, Upstream> failed;
+  failed.swap (m_pending);
+  for (std::map<uint32_t, Upstream>::iterator i = failed.begin (); i != failed.end (); ++i)
+    {
+      for (uint32_t w = 0; w < i->second.waiters.size (); w++)
+        {
+          Fill (i->second.waiters[w].first, i->second.waiters[w].second, "421 Busy\n\n");
+        }
+    }
+}
+
+} // namespace ns3
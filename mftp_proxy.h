@@ -0,0 +1,219 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_PROXY_H
+#define MFTP_PROXY_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "ns3/application.h"
+#include "ns3/address.h"
+#include "ns3/ptr.h"
+#include "ns3/socket.h"
+#include "mftp_prefetch.h"
+
+namespace ns3 {
+
+/**
+ * \brief MiniFTP caching proxy.
+ *
+ * Clients connect to the proxy as they would to PacketSink and get their
+ * replies in command order.  A GET of a cached file is answered on the
+ * spot; GETs of a file already being fetched wait for that one fetch;
+ * everything else is forwarded.  All upstream requests share one
+ * multiplexed connection to the origin server, so a slow reply there
+ * holds up only the clients waiting for it.
+ *
+ * Clients must not multiplex or swarm through the proxy: it answers
+ * unframed, and the origin sees every client at the proxy's address.
+ */
+class MftpProxy : public Application
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  MftpProxy ();
+  virtual ~MftpProxy ();
+
+  /**
+   * \return the number of commands clients sent
+   */
+  uint64_t GetRequestCount (void) const;
+  /**
+   * \return the number of GETs answered from the cache
+   */
+  uint64_t GetHits (void) const;
+  /**
+   * \return the number of GETs that joined a fetch already under way
+   */
+  uint64_t GetCoalesced (void) const;
+  /**
+   * \return the number of files fetched from the origin
+   */
+  uint64_t GetFetches (void) const;
+  /**
+   * \return the number of other commands forwarded to the origin
+   */
+  uint64_t GetForwarded (void) const;
+  /**
+   * \return bytes received from the origin
+   */
+  uint64_t GetUpstreamRx (void) const;
+  /**
+   * \return reply bytes sent to clients
+   */
+  uint64_t GetClientTx (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// A reply owed to a client, in command order.
+  struct Slot
+  {
+    std::string reply; //!< The reply, once known
+    bool        ready; //!< The reply is known
+  };
+
+  /// Per client connection state.
+  struct Client
+  {
+    std::deque<Slot> slots;  //!< Replies owed, oldest first
+    std::string rxBuffer;    //!< Partial command
+    std::string txBuffer;    //!< Reply bytes the socket did not take yet
+    uint64_t    first;       //!< Sequence number of the oldest slot
+  };
+
+  /// A request to the origin, on a stream of its own.
+  struct Upstream
+  {
+    std::vector<std::pair<Ptr<Socket>, uint64_t> > waiters; //!< Client slots owed the reply
+    std::string file;    //!< File fetched for the cache, empty if forwarded
+    std::string buffer;  //!< Reply bytes so far
+    uint32_t    unacked; //!< Bytes received since credit was last granted
+  };
+
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void HandleAccept (Ptr<Socket> socket, const Address &from);
+  /**
+   * \brief Split commands off a client connection
+   * \param socket the client connection
+   */
+  void HandleRead (Ptr<Socket> socket);
+  /**
+   * \brief Continue writing replies once the send buffer drains
+   * \param socket the client connection
+   * \param available bytes free in the send buffer
+   */
+  void HandleSend (Ptr<Socket> socket, uint32_t available);
+  void HandleClose (Ptr<Socket> socket);
+  /**
+   * \brief Answer from the cache, join a fetch, or forward
+   * \param socket the client connection
+   * \param command the command, including its "\n\n" terminator
+   */
+  void HandleRequest (Ptr<Socket> socket, const std::string &command);
+  /**
+   * \brief Hand a reply to the slot waiting for it
+   * \param socket the client connection
+   * \param slot the slot sequence number
+   * \param reply the reply
+   */
+  void Fill (Ptr<Socket> socket, uint64_t slot, const std::string &reply);
+  /**
+   * \brief Write ready replies, oldest first, while the socket takes them
+   * \param socket the client connection
+   * \param client its state
+   */
+  void Flush (Ptr<Socket> socket, Client &client);
+
+  /**
+   * \brief Send a command to the origin, connecting first if need be
+   * \param command the command, including its "\n\n" terminator
+   * \return the stream the reply will come back on
+   */
+  uint32_t SendUpstream (const std::string &command);
+  /**
+   * \brief Queue bytes for the origin and write what the socket takes
+   * \param wire a command or CREDIT frame, sent with its terminating NUL
+   */
+  void WriteUpstream (const std::string &wire);
+  /**
+   * \brief Write queued origin bytes while the socket takes them
+   */
+  void FlushUpstream (void);
+  /**
+   * \brief Continue writing to the origin once the send buffer drains
+   * \param socket the origin connection
+   * \param available bytes free in the send buffer
+   */
+  void HandleUpstreamSend (Ptr<Socket> socket, uint32_t available);
+  /**
+   * \brief Split reply frames off the origin connection
+   * \param socket the origin connection
+   */
+  void HandleUpstreamRead (Ptr<Socket> socket);
+  /**
+   * \brief Deliver a complete upstream reply to everyone waiting for it
+   * \param stream the stream it came on
+   * \param reply the reply
+   */
+  void CompleteUpstream (uint32_t stream, const std::string &reply);
+  /**
+   * \brief The origin connection closed: answer every waiter 421 Busy
+   * \param socket the origin connection
+   */
+  void HandleUpstreamClose (Ptr<Socket> socket);
+  /**
+   * \param bytes capacity of the file cache
+   */
+  void SetCacheSize (uint32_t bytes);
+  /**
+   * \return capacity of the file cache
+   */
+  uint32_t GetCacheSize (void) const;
+
+  std::map<Ptr<Socket>, Client> m_clients;   //!< Client connections
+  std::map<uint32_t, Upstream> m_pending;    //!< Upstream requests by stream
+  std::map<std::string, uint32_t> m_fetching; //!< Streams of files being fetched
+  MftpPrefetcher  m_cache;        //!< Files fetched, least recently used first out
+  Ptr<Socket>     m_socket;       //!< Listening socket
+  Ptr<Socket>     m_upstream;     //!< Connection to the origin, while open
+  std::string     m_upstreamBuffer; //!< Frame bytes not yet parsed
+  std::string     m_upstreamTx;   //!< Bytes for the origin the socket did not take yet
+  Address         m_local;        //!< Local address to bind to
+  Address         m_origin;       //!< Origin server
+  TypeId          m_tid;          //!< Protocol TypeId
+  uint64_t        m_requests;     //!< Commands from clients
+  uint64_t        m_hits;         //!< GETs answered from the cache
+  uint64_t        m_coalesced;    //!< GETs that joined a fetch
+  uint64_t        m_fetches;      //!< Files fetched from the origin
+  uint64_t        m_forwarded;    //!< Commands forwarded to the origin
+  uint64_t        m_upstreamRx;   //!< Bytes received from the origin
+  uint64_t        m_clientTx;     //!< Reply bytes sent to clients
+  uint32_t        m_nextStream;   //!< Stream of the next upstream request
+  uint32_t        m_window;       //!< Credit granted per upstream stream
+};
+
+} // namespace ns3
+
+#endif /* MFTP_PROXY_H */
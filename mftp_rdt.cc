@@ -0,0 +1,1050 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_rdt.h"
+#include "ns3/boolean.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MftpRdt");
+
+NS_OBJECT_ENSURE_REGISTERED (MftpRdtHeader);
+NS_OBJECT_ENSURE_REGISTERED (MftpRdtSocket);
+NS_OBJECT_ENSURE_REGISTERED (MftpRdtSocketFactory);
+
+MftpRdtHeader::MftpRdtHeader ()
+  : m_flags (0),
+    m_window (0),
+    m_seq (0),
+    m_ack (0)
+{
+}
+
+TypeId
+MftpRdtHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MftpRdtHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("Tutorial")
+    .AddConstructor<MftpRdtHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+MftpRdtHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+MftpRdtHeader::GetSerializedSize (void) const
+{
+  return 12 + 8 * m_sacks.size ();
+}
+
+void
+MftpRdtHeader::Serialize (Buffer::Iterator start) const
+{
+  start.WriteU8 (m_flags);
+  start.WriteU8 (m_sacks.size ());
+  start.WriteHtonU16 (m_window);
+  start.WriteHtonU32 (m_seq);
+  start.WriteHtonU32 (m_ack);
+  for (uint32_t i = 0; i < m_sacks.size (); i++)
+    {
+      start.WriteHtonU32 (m_sacks[i].first);
+      start.WriteHtonU32 (m_sacks[i].second);
+    }
+}
+
+uint32_t
+MftpRdtHeader::Deserialize (Buffer::Iterator start)
+{
+  m_flags = start.ReadU8 ();
+  uint8_t sacks = start.ReadU8 ();
+  m_window = start.ReadNtohU16 ();
+  m_seq = start.ReadNtohU32 ();
+  m_ack = start.ReadNtohU32 ();
+  m_sacks.clear ();
+  for (uint8_t i = 0; i < sacks; i++)
+    {
+      uint32_t begin = start.ReadNtohU32 ();
+      uint32_t end = start.ReadNtohU32 ();
+      m_sacks.push_back (std::make_pair (begin, end));
+    }
+  return GetSerializedSize ();
+}
+
+void
+MftpRdtHeader::Print (std::ostream &os) const
+{
+  os << "flags=" << (uint32_t) m_flags << " seq=" << m_seq << " ack=" << m_ack
+     << " win=" << m_window;
+  for (uint32_t i = 0; i < m_sacks.size (); i++)
+    {
+      os << " sack=" << m_sacks[i].first << "-" << m_sacks[i].second;
+    }
+}
+
+void
+MftpRdtHeader::SetFlags (uint8_t flags)
+{
+  m_flags = flags;
+}
+
+uint8_t
+MftpRdtHeader::GetFlags (void) const
+{
+  return m_flags;
+}
+
+void
+MftpRdtHeader::SetSeq (uint32_t seq)
+{
+  m_seq = seq;
+}
+
+uint32_t
+MftpRdtHeader::GetSeq (void) const
+{
+  return m_seq;
+}
+
+void
+MftpRdtHeader::SetAck (uint32_t ack)
+{
+  m_ack = ack;
+}
+
+uint32_t
+MftpRdtHeader::GetAck (void) const
+{
+  return m_ack;
+}
+
+void
+MftpRdtHeader::SetWindow (uint16_t window)
+{
+  m_window = window;
+}
+
+uint16_t
+MftpRdtHeader::GetWindow (void) const
+{
+  return m_window;
+}
+
+void
+MftpRdtHeader::AddSack (uint32_t start, uint32_t end)
+{
+  if (m_sacks.size () < MAX_SACK_BLOCKS)
+    {
+      m_sacks.push_back (std::make_pair (start, end));
+    }
+}
+
+uint32_t
+MftpRdtHeader::GetSackCount (void) const
+{
+  return m_sacks.size ();
+}
+
+void
+MftpRdtHeader::GetSack (uint32_t i, uint32_t &start, uint32_t &end) const
+{
+  start = m_sacks[i].first;
+  end = m_sacks[i].second;
+}
+
+
+TypeId
+MftpRdtSocket::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MftpRdtSocket")
+    .SetParent<Socket> ()
+    .SetGroupName ("Tutorial")
+    .AddConstructor<MftpRdtSocket> ()
+    .AddAttribute ("SegmentSize",
+                   "Payload bytes per datagram.",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&MftpRdtSocket::m_segmentSize),
+                   MakeUintegerChecker<uint32_t> (1, 65000))
+    .AddAttribute ("Window",
+                   "Segments the sender keeps in flight.",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&MftpRdtSocket::m_window),
+                   MakeUintegerChecker<uint32_t> (1, 65535))
+    .AddAttribute ("PacingRate",
+                   "Rate at which segments are released. Zero sends a whole "
+                   "window back to back.",
+                   DataRateValue (DataRate (0)),
+                   MakeDataRateAccessor (&MftpRdtSocket::m_pacingRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("SndBufSize",
+                   "Bytes queued or unacknowledged the application may have.",
+                   UintegerValue (131072),
+                   MakeUintegerAccessor (&MftpRdtSocket::m_sndBufSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("InitialRto",
+                   "Retransmission timeout before any round trip was measured.",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&MftpRdtSocket::m_rto),
+                   MakeTimeChecker ())
+    .AddAttribute ("MinRto",
+                   "Lower bound of the retransmission timeout.",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&MftpRdtSocket::m_minRto),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRetries",
+                   "Timeouts without progress before the connection fails.",
+                   UintegerValue (6),
+                   MakeUintegerAccessor (&MftpRdtSocket::m_maxRetries),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("DupThresh",
+                   "SACKed segments beyond a missing one that mark it lost.",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&MftpRdtSocket::m_dupThresh),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("Retransmit",
+                     "A segment was sent again",
+                     MakeTraceSourceAccessor (&MftpRdtSocket::m_retransmitTrace),
+                     "ns3::MftpRdtSocket::RetransmitCallback")
+  ;
+  return tid;
+}
+
+MftpRdtSocket::MftpRdtSocket ()
+  : m_state (CLOSED),
+    m_listening (false),
+    m_accepting (false),
+    m_errno (ERROR_NOTERROR),
+    m_inflightBytes (0),
+    m_nextSeq (0),
+    m_peerWindow (0xffff),
+    m_retries (0),
+    m_retransmissions (0),
+    m_rcvNext (0),
+    m_closing (false),
+    m_finSent (false),
+    m_finAcked (false),
+    m_peerFin (false),
+    m_closeNotified (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MftpRdtSocket::~MftpRdtSocket ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+MftpRdtSocket::SetNode (Ptr<Node> node, Ptr<MftpRdtSocketFactory> factory)
+{
+  m_node = node;
+  m_factory = factory;
+}
+
+uint32_t
+MftpRdtSocket::GetRetransmissions (void) const
+{
+  return m_retransmissions;
+}
+
+void
+MftpRdtSocket::DoDispose (void)
+{
+  Simulator::Cancel (m_rtoEvent);
+  Simulator::Cancel (m_paceEvent);
+  if (m_udp && !m_listener)
+    {
+      m_udp->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+    }
+  m_udp = 0;
+  m_listener = 0;
+  m_children.clear ();
+  m_factory = 0;
+  m_node = 0;
+  Socket::DoDispose ();
+}
+
+enum Socket::SocketErrno
+MftpRdtSocket::GetErrno (void) const
+{
+  return m_errno;
+}
+
+enum Socket::SocketType
+MftpRdtSocket::GetSocketType (void) const
+{
+  return NS3_SOCK_STREAM;
+}
+
+Ptr<Node>
+MftpRdtSocket::GetNode (void) const
+{
+  return m_node;
+}
+
+int
+MftpRdtSocket::BindUdp (const Address &address, bool ipv6)
+{
+  if (m_udp)
+    {
+      m_errno = ERROR_INVAL;
+      return -1;
+    }
+  m_udp = Socket::CreateSocket (m_node, UdpSocketFactory::GetTypeId ());
+  m_udp->SetRecvCallback (MakeCallback (&MftpRdtSocket::HandleUdpRead, this));
+  if (!address.IsInvalid ())
+    {
+      return m_udp->Bind (address);
+    }
+  return ipv6 ? m_udp->Bind6 () : m_udp->Bind ();
+}
+
+int
+MftpRdtSocket::Bind (void)
+{
+  return BindUdp (Address (), false);
+}
+
+int
+MftpRdtSocket::Bind6 (void)
+{
+  return BindUdp (Address (), true);
+}
+
+int
+MftpRdtSocket::Bind (const Address &address)
+{
+  return BindUdp (address, false);
+}
+
+int
+MftpRdtSocket::Connect (const Address &address)
+{
+  NS_LOG_FUNCTION (this << address);
+  if (m_state != CLOSED || m_listening)
+    {
+      m_errno = ERROR_ISCONN;
+      return -1;
+    }
+  if (!m_udp && BindUdp (Address (), Inet6SocketAddress::IsMatchingType (address)) != 0)
+    {
+      return -1;
+    }
+  m_peer = address;
+  m_state = SYN_SENT;
+  SendControl (MftpRdtHeader::SYN);
+  ArmRto ();
+  return 0;
+}
+
+int
+MftpRdtSocket::Listen (void)
+{
+  if (!m_udp || m_state != CLOSED)
+    {
+      m_errno = ERROR_INVAL;
+      return -1;
+    }
+  m_listening = true;
+  m_accepting = true;
+  return 0;
+}
+
+int
+MftpRdtSocket::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<MftpRdtSocket> self = this;
+  if (m_listening)
+    {
+      // accepted connections keep using the UDP socket until they close
+      m_accepting = false;
+      if (m_children.empty ())
+        {
+          Deallocate ();
+        }
+      return 0;
+    }
+  if (m_state != ESTABLISHED)
+    {
+      Deallocate ();
+      return 0;
+    }
+  m_closing = true;
+  m_closeNotified = true;
+  SendPending ();
+  MaybeFinish ();
+  return 0;
+}
+
+int
+MftpRdtSocket::ShutdownSend (void)
+{
+  m_errno = ERROR_OPNOTSUPP;
+  return -1;
+}
+
+int
+MftpRdtSocket::ShutdownRecv (void)
+{
+  m_errno = ERROR_OPNOTSUPP;
+  return -1;
+}
+
+uint32_t
+MftpRdtSocket::GetTxAvailable (void) const
+{
+  uint32_t used = m_txBuffer.size () + m_inflightBytes;
+  return used < m_sndBufSize ? m_sndBufSize - used : 0;
+}
+
+int
+MftpRdtSocket::Send (Ptr<Packet> p, uint32_t flags)
+{
+  if (m_closing || (m_state != ESTABLISHED && m_state != SYN_SENT))
+    {
+      m_errno = m_closing ? ERROR_SHUTDOWN : ERROR_NOTCONN;
+      return -1;
+    }
+  if (p->GetSize () > GetTxAvailable ())
+    {
+      m_errno = ERROR_MSGSIZE;
+      return -1;
+    }
+  uint32_t size = p->GetSize ();
+  std::string::size_type offset = m_txBuffer.size ();
+  m_txBuffer.resize (offset + size);
+  p->CopyData ((uint8_t *) &m_txBuffer[offset], size);
+  SendPending ();
+  return size;
+}
+
+int
+MftpRdtSocket::SendTo (Ptr<Packet> p, uint32_t flags, const Address &toAddress)
+{
+  // a stream socket sends to its peer only
+  return Send (p, flags);
+}
+
+uint32_t
+MftpRdtSocket::GetRxAvailable (void) const
+{
+  return m_rxBuffer.size ();
+}
+
+Ptr<Packet>
+MftpRdtSocket::Recv (uint32_t maxSize, uint32_t flags)
+{
+  if (m_rxBuffer.empty ())
+    {
+      return 0;
+    }
+  uint32_t size = std::min<uint32_t> (maxSize, m_rxBuffer.size ());
+  Ptr<Packet> packet = Create<Packet> ((const uint8_t *) m_rxBuffer.data (), size);
+  m_rxBuffer.erase (0, size);
+  return packet;
+}
+
+Ptr<Packet>
+MftpRdtSocket::RecvFrom (uint32_t maxSize, uint32_t flags, Address &fromAddress)
+{
+  Ptr<Packet> packet = Recv (maxSize, flags);
+  if (packet)
+    {
+      fromAddress = m_peer;
+    }
+  return packet;
+}
+
+int
+MftpRdtSocket::GetSockName (Address &address) const
+{
+  if (!m_udp)
+    {
+      m_errno = ERROR_NOTCONN;
+      return -1;
+    }
+  return m_udp->GetSockName (address);
+}
+
+int
+MftpRdtSocket::GetPeerName (Address &address) const
+{
+  if (m_state == CLOSED)
+    {
+      m_errno = ERROR_NOTCONN;
+      return -1;
+    }
+  address = m_peer;
+  return 0;
+}
+
+bool
+MftpRdtSocket::SetAllowBroadcast (bool allowBroadcast)
+{
+  return !allowBroadcast;
+}
+
+bool
+MftpRdtSocket::GetAllowBroadcast (void) const
+{
+  return false;
+}
+
+void
+MftpRdtSocket::HandleUdpRead (Ptr<Socket> udp)
+{
+  Ptr<MftpRdtSocket> self = this;
+  Ptr<Packet> packet;
+  Address from;
+  while (m_udp && (packet = udp->RecvFrom (from)))
+    {
+      MftpRdtHeader header;
+      packet->RemoveHeader (header);
+      if (!m_listening)
+        {
+          ReceiveSegment (header, packet);
+          continue;
+        }
+
+      std::map<Address, Ptr<MftpRdtSocket> >::iterator it = m_children.find (from);
+      if (it != m_children.end ())
+        {
+          Ptr<MftpRdtSocket> child = it->second;
+          child->ReceiveSegment (header, packet);
+          continue;
+        }
+      if (header.GetFlags () & MftpRdtHeader::RST)
+        {
+          continue;
+        }
+      if (!(header.GetFlags () & MftpRdtHeader::SYN) || !m_accepting
+          || !NotifyConnectionRequest (from))
+        {
+          MftpRdtHeader rst;
+          rst.SetFlags (MftpRdtHeader::RST);
+          Ptr<Packet> reply = Create<Packet> ();
+          reply->AddHeader (rst);
+          m_udp->SendTo (reply, 0, from);
+          continue;
+        }
+
+      Ptr<MftpRdtSocket> child = DynamicCast<MftpRdtSocket> (m_factory->CreateSocket ());
+      child->m_udp = m_udp;
+      child->m_listener = this;
+      child->m_peer = from;
+      child->m_state = ESTABLISHED;
+      child->m_segmentSize = m_segmentSize;
+      child->m_window = m_window;
+      child->m_pacingRate = m_pacingRate;
+      child->m_sndBufSize = m_sndBufSize;
+      child->m_rto = m_rto;
+      child->m_minRto = m_minRto;
+      child->m_maxRetries = m_maxRetries;
+      child->m_dupThresh = m_dupThresh;
+      m_children[from] = child;
+      child->SendControl (MftpRdtHeader::SYN | MftpRdtHeader::ACK);
+      NotifyNewConnectionCreated (child, from);
+    }
+}
+
+void
+MftpRdtSocket::ReceiveSegment (const MftpRdtHeader &header, Ptr<Packet> payload)
+{
+  // the application may close and drop us from any notification
+  Ptr<MftpRdtSocket> self = this;
+  uint8_t flags = header.GetFlags ();
+  NS_LOG_LOGIC (this << " received " << header);
+
+  if (flags & MftpRdtHeader::RST)
+    {
+      if (m_state == SYN_SENT)
+        {
+          NotifyConnectionFailed ();
+        }
+      else if (!m_closeNotified)
+        {
+          m_closeNotified = true;
+          NotifyErrorClose ();
+        }
+      Deallocate ();
+      return;
+    }
+  if (flags & MftpRdtHeader::SYN)
+    {
+      if (m_state == SYN_SENT && (flags & MftpRdtHeader::ACK))
+        {
+          m_state = ESTABLISHED;
+          m_retries = 0;
+          Simulator::Cancel (m_rtoEvent);
+          SendControl (MftpRdtHeader::ACK);
+          NotifyConnectionSucceeded ();
+          SendPending ();
+        }
+      else if (m_listener)
+        {
+          // our SYN+ACK was lost and the peer asks again
+          SendControl (MftpRdtHeader::SYN | MftpRdtHeader::ACK);
+        }
+      return;
+    }
+  if (m_state != ESTABLISHED)
+    {
+      return;
+    }
+
+  m_peerWindow = header.GetWindow ();
+  if (flags & MftpRdtHeader::ACK)
+    {
+      ProcessAck (header);
+    }
+  if (m_state == ESTABLISHED && (flags & (MftpRdtHeader::DATA | MftpRdtHeader::FIN)))
+    {
+      ProcessData (header, payload);
+    }
+}
+
+void
+MftpRdtSocket::ProcessAck (const MftpRdtHeader &header)
+{
+  uint32_t ack = header.GetAck ();
+  uint32_t acked = 0;
+  bool progress = false;
+  Time sample;
+  while (!m_inflight.empty () && m_inflight.begin ()->first < ack)
+    {
+      Segment &segment = m_inflight.begin ()->second;
+      if (!segment.resent)
+        {
+          // Karn: only segments sent once give a usable sample
+          sample = Simulator::Now () - segment.sent;
+        }
+      m_finAcked = m_finAcked || segment.fin;
+      acked += segment.data.size ();
+      progress = true;
+      m_lost.erase (m_inflight.begin ()->first);
+      m_inflight.erase (m_inflight.begin ());
+    }
+
+  for (uint32_t i = 0; i < header.GetSackCount (); i++)
+    {
+      uint32_t start, end;
+      header.GetSack (i, start, end);
+      for (std::map<uint32_t, Segment>::iterator it = m_inflight.lower_bound (start);
+           it != m_inflight.end () && it->first < end; ++it)
+        {
+          it->second.sacked = true;
+          m_lost.erase (it->first);
+        }
+    }
+
+  // a hole with DupThresh SACKed segments above it is lost; one already
+  // sent again is left to the RTO, or every later ACK would resend it
+  uint32_t above = 0;
+  for (std::map<uint32_t, Segment>::reverse_iterator it = m_inflight.rbegin ();
+       it != m_inflight.rend (); ++it)
+    {
+      if (it->second.sacked)
+        {
+          above++;
+        }
+      else if (above >= m_dupThresh && !it->second.lost && !it->second.resent)
+        {
+          it->second.lost = true;
+          m_lost.insert (it->first);
+        }
+    }
+
+  if (progress)
+    {
+      if (!sample.IsZero ())
+        {
+          UpdateRto (sample);
+        }
+      m_retries = 0;
+      Simulator::Cancel (m_rtoEvent);
+      if (!m_inflight.empty ())
+        {
+          ArmRto ();
+        }
+    }
+  if (acked > 0)
+    {
+      m_inflightBytes -= acked;
+      NotifySend (GetTxAvailable ());
+    }
+  SendPending ();
+  MaybeFinish ();
+}
+
+void
+MftpRdtSocket::ProcessData (const MftpRdtHeader &header, Ptr<Packet> payload)
+{
+  uint32_t seq = header.GetSeq ();
+  if (seq >= m_rcvNext && m_ooo.find (seq) == m_ooo.end ())
+    {
+      RxSegment &segment = m_ooo[seq];
+      segment.data.resize (payload->GetSize ());
+      if (!segment.data.empty ())
+        {
+          payload->CopyData ((uint8_t *) &segment.data[0], segment.data.size ());
+        }
+      segment.fin = header.GetFlags () & MftpRdtHeader::FIN;
+    }
+
+  bool delivered = false;
+  bool fin = false;
+  std::map<uint32_t, RxSegment>::iterator it;
+  while ((it = m_ooo.find (m_rcvNext)) != m_ooo.end ())
+    {
+      fin = fin || it->second.fin;
+      delivered = delivered || !it->second.data.empty ();
+      m_rxBuffer.append (it->second.data);
+      m_ooo.erase (it);
+      m_rcvNext++;
+    }
+  // duplicates are acknowledged too, in case our ack was lost
+  SendControl (MftpRdtHeader::ACK);
+
+  if (delivered)
+    {
+      NotifyDataRecv ();
+    }
+  if (fin && !m_peerFin)
+    {
+      m_peerFin = true;
+      m_closing = true;
+      if (!m_closeNotified)
+        {
+          m_closeNotified = true;
+          NotifyNormalClose ();
+        }
+      SendPending ();
+      MaybeFinish ();
+    }
+}
+
+void
+MftpRdtSocket::SendPending (void)
+{
+  while (m_state == ESTABLISHED)
+    {
+      if (m_pacingRate.GetBitRate () > 0 && Simulator::Now () < m_nextSend)
+        {
+          if (!m_paceEvent.IsRunning ())
+            {
+              m_paceEvent = Simulator::Schedule (m_nextSend - Simulator::Now (),
+                                                 &MftpRdtSocket::SendPending, this);
+            }
+          return;
+        }
+
+      // repairs go first
+      if (!m_lost.empty ())
+        {
+          uint32_t seq = *m_lost.begin ();
+          m_lost.erase (m_lost.begin ());
+          Segment &segment = m_inflight[seq];
+          segment.lost = false;
+          segment.resent = true;
+          segment.sent = Simulator::Now ();
+          m_retransmissions++;
+          m_retransmitTrace (seq);
+          Transmit (seq, segment);
+          continue;
+        }
+
+      uint32_t window = std::min (m_window, m_peerWindow);
+      if (m_inflight.size () >= window)
+        {
+          return;
+        }
+      Segment segment;
+      segment.fin = false;
+      segment.sacked = false;
+      segment.lost = false;
+      segment.resent = false;
+      segment.sent = Simulator::Now ();
+      if (!m_txBuffer.empty ())
+        {
+          uint32_t size = std::min<uint32_t> (m_segmentSize, m_txBuffer.size ());
+          segment.data = m_txBuffer.substr (0, size);
+          m_txBuffer.erase (0, size);
+          m_inflightBytes += size;
+        }
+      else if (m_closing && !m_finSent)
+        {
+          segment.fin = true;
+          m_finSent = true;
+        }
+      else
+        {
+          return;
+        }
+      uint32_t seq = m_nextSeq++;
+      m_inflight[seq] = segment;
+      Transmit (seq, segment);
+      if (!segment.data.empty ())
+        {
+          // like TCP, on handing data to the network, not on its ack
+          NotifyDataSent (segment.data.size ());
+        }
+      ArmRto ();
+    }
+}
+
+void
+MftpRdtSocket::Transmit (uint32_t seq, const Segment &segment)
+{
+  Ptr<Packet> packet = Create<Packet> ((const uint8_t *) segment.data.data (), segment.data.size ());
+  MftpRdtHeader header;
+  header.SetFlags (MftpRdtHeader::ACK
+                   | (segment.fin ? MftpRdtHeader::FIN : MftpRdtHeader::DATA));
+  header.SetSeq (seq);
+  FillAck (header);
+  packet->AddHeader (header);
+  if (m_pacingRate.GetBitRate () > 0)
+    {
+      m_nextSend = Simulator::Now () + m_pacingRate.CalculateBytesTxTime (packet->GetSize ());
+    }
+  SendDatagram (packet);
+}
+
+void
+MftpRdtSocket::SendControl (uint8_t flags)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  MftpRdtHeader header;
+  header.SetFlags (flags);
+  header.SetSeq (m_nextSeq);
+  FillAck (header);
+  packet->AddHeader (header);
+  SendDatagram (packet);
+}
+
+void
+MftpRdtSocket::FillAck (MftpRdtHeader &header) const
+{
+  header.SetAck (m_rcvNext);
+  header.SetWindow (std::min<uint32_t> (m_window, 0xffff));
+  // report the lowest out-of-order ranges, which are the ones holding
+  // delivery up
+  std::map<uint32_t, RxSegment>::const_iterator it = m_ooo.begin ();
+  while (it != m_ooo.end () && header.GetSackCount () < MftpRdtHeader::MAX_SACK_BLOCKS)
+    {
+      uint32_t start = it->first;
+      uint32_t end = start;
+      while (it != m_ooo.end () && it->first == end)
+        {
+          ++end;
+          ++it;
+        }
+      header.AddSack (start, end);
+    }
+}
+
+void
+MftpRdtSocket::SendDatagram (Ptr<Packet> packet)
+{
+  if (m_udp)
+    {
+      m_udp->SendTo (packet, 0, m_peer);
+    }
+}
+
+void
+MftpRdtSocket::ArmRto (void)
+{
+  if (!m_rtoEvent.IsRunning ())
+    {
+      m_rtoEvent = Simulator::Schedule (m_rto, &MftpRdtSocket::RtoExpired, this);
+    }
+}
+
+void
+MftpRdtSocket::RtoExpired (void)
+{
+  Ptr<MftpRdtSocket> self = this;
+  if (++m_retries > m_maxRetries)
+    {
+      NS_LOG_INFO (this << " giving up after " << m_maxRetries << " timeouts");
+      if (m_state == SYN_SENT)
+        {
+          NotifyConnectionFailed ();
+        }
+      else if (!m_closeNotified)
+        {
+          m_closeNotified = true;
+          NotifyErrorClose ();
+        }
+      Deallocate ();
+      return;
+    }
+  m_rto = Min (m_rto + m_rto, Seconds (60));
+
+  if (m_state == SYN_SENT)
+    {
+      SendControl (MftpRdtHeader::SYN);
+      ArmRto ();
+      return;
+    }
+  for (std::map<uint32_t, Segment>::iterator it = m_inflight.begin (); it != m_inflight.end (); ++it)
+    {
+      if (!it->second.sacked)
+        {
+          it->second.lost = true;
+          m_lost.insert (it->first);
+        }
+    }
+  ArmRto ();
+  SendPending ();
+}
+
+void
+MftpRdtSocket::UpdateRto (Time sample)
+{
+  // RFC 6298
+  if (m_srtt.IsZero ())
+    {
+      m_srtt = sample;
+      m_rttvar = sample / 2;
+    }
+  else
+    {
+      Time delta = m_srtt > sample ? m_srtt - sample : sample - m_srtt;
+      m_rttvar = (m_rttvar * 3 + delta) / 4;
+      m_srtt = (m_srtt * 7 + sample) / 8;
+    }
+  m_rto = Max (m_minRto, Min (Seconds (60), m_srtt + m_rttvar * 4));
+}
+
+void
+MftpRdtSocket::MaybeFinish (void)
+{
+  if (m_finAcked && m_peerFin)
+    {
+      Deallocate ();
+    }
+}
+
+void
+MftpRdtSocket::RemoveChild (const Address &peer)
+{
+  m_children.erase (peer);
+  if (m_children.empty () && !m_accepting)
+    {
+      Deallocate ();
+    }
+}
+
+void
+MftpRdtSocket::Deallocate (void)
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<MftpRdtSocket> self = this;
+  m_state = CLOSED;
+  m_listening = false;
+  Simulator::Cancel (m_rtoEvent);
+  Simulator::Cancel (m_paceEvent);
+  if (m_listener)
+    {
+      Ptr<MftpRdtSocket> listener = m_listener;
+      m_listener = 0;
+      m_udp = 0;
+      listener->RemoveChild (m_peer);
+    }
+  else if (m_udp)
+    {
+      m_udp->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_udp->Close ();
+      m_udp = 0;
+    }
+  if (m_factory)
+    {
+      Ptr<MftpRdtSocketFactory> factory = m_factory;
+      m_factory = 0;
+      factory->Remove (this);
+    }
+}
+
+
+TypeId
+MftpRdtSocketFactory::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MftpRdtSocketFactory")
+    .SetParent<SocketFactory> ()
+    .SetGroupName ("Tutorial")
+    .AddConstructor<MftpRdtSocketFactory> ()
+  ;
+  return tid;
+}
+
+void
+MftpRdtSocketFactory::Install (NodeContainer nodes)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      if (!(*i)->GetObject<MftpRdtSocketFactory> ())
+        {
+          (*i)->AggregateObject (CreateObject<MftpRdtSocketFactory> ());
+        }
+    }
+}
+
+Ptr<Socket>
+MftpRdtSocketFactory::CreateSocket (void)
+{
+  Ptr<MftpRdtSocket> socket = CreateObject<MftpRdtSocket> ();
+  socket->SetNode (GetObject<Node> (), this);
+  m_sockets.push_back (socket);
+  return socket;
+}
+
+void
+MftpRdtSocketFactory::Remove (Ptr<MftpRdtSocket> socket)
+{
+  m_sockets.erase (std::remove (m_sockets.begin (), m_sockets.end (), socket),
+                   m_sockets.end ());
+}
+
+void
+MftpRdtSocketFactory::DoDispose (void)
+{
+  // sockets hold each other through the listener, so break the links
+  std::vector<Ptr<MftpRdtSocket> > sockets;
+  sockets.swap (m_sockets);
+  for (std::vector<Ptr<MftpRdtSocket> >::iterator i = sockets.begin (); i != sockets.end (); ++i)
+    {
+      (*i)->Dispose ();
+    }
+  SocketFactory::DoDispose ();
+}
+
+} // namespace ns3
@@ -0,0 +1,374 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_RDT_H
+#define MFTP_RDT_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ns3/address.h"
+#include "ns3/data-rate.h"
+#include "ns3/event-id.h"
+#include "ns3/header.h"
+#include "ns3/node.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/socket.h"
+#include "ns3/socket-factory.h"
+#include "ns3/traced-callback.h"
+
+namespace ns3 {
+
+class MftpRdtSocketFactory;
+
+/**
+ * \brief Header of every MiniFTP reliable datagram.
+ *
+ * Data segments are numbered one per segment rather than per byte.  Every
+ * datagram carries the cumulative acknowledgement, the receive window in
+ * segments, and up to MAX_SACK_BLOCKS ranges of segments received above
+ * the cumulative acknowledgement.
+ */
+class MftpRdtHeader : public Header
+{
+public:
+  /// Datagram flags.
+  enum Flags
+  {
+    SYN = 1,   //!< Open a connection
+    ACK = 2,   //!< The ack field is valid
+    FIN = 4,   //!< Last segment of the sender
+    RST = 8,   //!< No such connection
+    DATA = 16  //!< Carries a data segment
+  };
+
+  /// Most SACK ranges carried in one datagram.
+  static const uint32_t MAX_SACK_BLOCKS = 4;
+
+  MftpRdtHeader ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+
+  void SetFlags (uint8_t flags);
+  uint8_t GetFlags (void) const;
+  void SetSeq (uint32_t seq);
+  uint32_t GetSeq (void) const;
+  void SetAck (uint32_t ack);
+  uint32_t GetAck (void) const;
+  void SetWindow (uint16_t window);
+  uint16_t GetWindow (void) const;
+
+  /**
+   * \brief Report segments [start, end) as received.
+   * \param start first segment of the range
+   * \param end one past the last segment of the range
+   */
+  void AddSack (uint32_t start, uint32_t end);
+  /**
+   * \return the number of SACK ranges
+   */
+  uint32_t GetSackCount (void) const;
+  /**
+   * \param i index of the range
+   * \param start set to the first segment of the range
+   * \param end set to one past the last segment of the range
+   */
+  void GetSack (uint32_t i, uint32_t &start, uint32_t &end) const;
+
+private:
+  uint8_t  m_flags;  //!< Flags
+  uint16_t m_window; //!< Receive window, in segments
+  uint32_t m_seq;    //!< Segment number
+  uint32_t m_ack;    //!< Next segment expected from the peer
+  std::vector<std::pair<uint32_t, uint32_t> > m_sacks; //!< Received ranges
+};
+
+/**
+ * \brief Reliable, connection-oriented byte stream over UDP.
+ *
+ * A lighter alternative to TCP for MiniFTP: there is no congestion
+ * control, so the sender keeps up to Window segments in flight and,
+ * if PacingRate is set, spaces them out at that rate instead of backing
+ * off when the shared segment is busy.  Losses are found from the
+ * receiver's SACK ranges, DupThresh segments past a hole, or by a
+ * retransmission timeout with RFC 6298 estimation.
+ *
+ * The socket offers what the MiniFTP applications use from TCP: connect,
+ * listen and accept, in-order delivery, DataSent as new data first goes
+ * out and Send callbacks as acknowledgements free buffer space.  Accepted connections share
+ * the listener's UDP port.  There is no half-close: a FIN from the peer
+ * closes both directions once queued data has been acknowledged.
+ */
+class MftpRdtSocket : public Socket
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * TracedCallback signature for retransmissions.
+   * \param seq the segment sent again
+   */
+  typedef void (* RetransmitCallback)(uint32_t seq);
+
+  MftpRdtSocket ();
+  virtual ~MftpRdtSocket ();
+
+  /**
+   * \param node the node the socket lives on
+   * \param factory the factory that keeps the socket alive until it closes
+   */
+  void SetNode (Ptr<Node> node, Ptr<MftpRdtSocketFactory> factory);
+
+  /**
+   * \return the number of segments sent more than once
+   */
+  uint32_t GetRetransmissions (void) const;
+
+  virtual enum SocketErrno GetErrno (void) const;
+  virtual enum SocketType GetSocketType (void) const;
+  virtual Ptr<Node> GetNode (void) const;
+  virtual int Bind (void);
+  virtual int Bind6 (void);
+  virtual int Bind (const Address &address);
+  virtual int Close (void);
+  virtual int ShutdownSend (void);
+  virtual int ShutdownRecv (void);
+  virtual int Connect (const Address &address);
+  virtual int Listen (void);
+  virtual uint32_t GetTxAvailable (void) const;
+  virtual int Send (Ptr<Packet> p, uint32_t flags);
+  virtual int SendTo (Ptr<Packet> p, uint32_t flags, const Address &toAddress);
+  virtual uint32_t GetRxAvailable (void) const;
+  virtual Ptr<Packet> Recv (uint32_t maxSize, uint32_t flags);
+  virtual Ptr<Packet> RecvFrom (uint32_t maxSize, uint32_t flags, Address &fromAddress);
+  virtual int GetSockName (Address &address) const;
+  virtual int GetPeerName (Address &address) const;
+  virtual bool SetAllowBroadcast (bool allowBroadcast);
+  virtual bool GetAllowBroadcast (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// Connection state.
+  enum State
+  {
+    CLOSED,
+    SYN_SENT,
+    ESTABLISHED
+  };
+
+  /// A segment sent and not yet acknowledged.
+  struct Segment
+  {
+    std::string data;    //!< Payload
+    Time        sent;    //!< Last transmission
+    bool        fin;     //!< Carries the FIN
+    bool        sacked;  //!< Reported received by the peer
+    bool        lost;    //!< Queued for retransmission
+    bool        resent;  //!< Sent more than once
+  };
+
+  /// A segment received out of order.
+  struct RxSegment
+  {
+    std::string data;    //!< Payload
+    bool        fin;     //!< Carries the FIN
+  };
+
+  /**
+   * \brief Create the UDP socket underneath
+   * \param address the local address, or an empty Address for any
+   * \param ipv6 bind to the IPv6 wildcard if address is empty
+   * \return the UDP Bind result
+   */
+  int BindUdp (const Address &address, bool ipv6);
+  /**
+   * \brief Receive datagrams from the UDP socket
+   * \param udp the UDP socket
+   */
+  void HandleUdpRead (Ptr<Socket> udp);
+  /**
+   * \brief Process a datagram of this connection
+   * \param header the datagram header
+   * \param payload the datagram payload
+   */
+  void ReceiveSegment (const MftpRdtHeader &header, Ptr<Packet> payload);
+  /**
+   * \brief Release acknowledged segments and mark lost ones
+   * \param header the datagram header
+   */
+  void ProcessAck (const MftpRdtHeader &header);
+  /**
+   * \brief Store a data or FIN segment and deliver what is in order
+   * \param header the datagram header
+   * \param payload the segment payload
+   */
+  void ProcessData (const MftpRdtHeader &header, Ptr<Packet> payload);
+  /**
+   * \brief Send retransmissions and new segments within window and pacing
+   */
+  void SendPending (void);
+  /**
+   * \brief Put a data or FIN segment on the wire
+   * \param seq the segment number
+   * \param segment the segment
+   */
+  void Transmit (uint32_t seq, const Segment &segment);
+  /**
+   * \brief Send a datagram without a data segment
+   * \param flags the header flags
+   */
+  void SendControl (uint8_t flags);
+  /**
+   * \brief Fill in acknowledgement, window and SACK ranges
+   * \param header the header to fill in
+   */
+  void FillAck (MftpRdtHeader &header) const;
+  /**
+   * \brief Hand a datagram to the UDP socket
+   * \param packet the datagram, header included
+   */
+  void SendDatagram (Ptr<Packet> packet);
+  /**
+   * \brief Start the retransmission timer unless it is running
+   */
+  void ArmRto (void);
+  /**
+   * \brief Retransmission timeout: resend the SYN or every unSACKed segment
+   */
+  void RtoExpired (void);
+  /**
+   * \brief Feed a round-trip time into the timeout estimate
+   * \param sample round-trip time of a segment sent once
+   */
+  void UpdateRto (Time sample);
+  /**
+   * \brief Release the socket once both FINs are through
+   */
+  void MaybeFinish (void);
+  /**
+   * \brief Forget an accepted connection
+   * \param peer the peer address of the connection
+   */
+  void RemoveChild (const Address &peer);
+  /**
+   * \brief Stop timers, detach from the UDP socket and the factory
+   */
+  void Deallocate (void);
+
+  Ptr<Node>       m_node;          //!< Node of the socket
+  Ptr<MftpRdtSocketFactory> m_factory; //!< Keeps the socket alive while open
+  Ptr<Socket>     m_udp;           //!< Datagram socket, shared with the listener
+  Ptr<MftpRdtSocket> m_listener;   //!< Listener that accepted this connection
+  std::map<Address, Ptr<MftpRdtSocket> > m_children; //!< Accepted connections by peer
+  Address         m_peer;          //!< Remote address
+  State           m_state;         //!< Connection state
+  bool            m_listening;     //!< Listener, or closed listener with connections left
+  bool            m_accepting;     //!< Listener open for new connections
+  mutable enum SocketErrno m_errno; //!< Last error
+
+  std::string     m_txBuffer;      //!< Bytes not yet segmented
+  std::map<uint32_t, Segment> m_inflight; //!< Unacknowledged segments
+  std::set<uint32_t> m_lost;       //!< Segments to send again
+  uint32_t        m_inflightBytes; //!< Payload bytes in m_inflight
+  uint32_t        m_nextSeq;       //!< Next new segment number
+  uint32_t        m_peerWindow;    //!< Window advertised by the peer
+  Time            m_nextSend;      //!< Earliest time the pacer allows a send
+  EventId         m_paceEvent;     //!< Pending paced send
+  EventId         m_rtoEvent;      //!< Retransmission timeout
+  Time            m_srtt;          //!< Smoothed round-trip time
+  Time            m_rttvar;        //!< Round-trip time variation
+  Time            m_rto;           //!< Current timeout
+  uint32_t        m_retries;       //!< Timeouts without progress
+  uint32_t        m_retransmissions; //!< Segments sent more than once
+
+  std::string     m_rxBuffer;      //!< In-order bytes not yet read
+  std::map<uint32_t, RxSegment> m_ooo; //!< Segments received out of order
+  uint32_t        m_rcvNext;       //!< Next segment expected
+
+  bool            m_closing;       //!< Send a FIN after queued data
+  bool            m_finSent;       //!< Our FIN is on the wire
+  bool            m_finAcked;      //!< Our FIN was acknowledged
+  bool            m_peerFin;       //!< The peer's FIN arrived
+  bool            m_closeNotified; //!< The application heard about the close
+
+  uint32_t        m_segmentSize;   //!< Payload bytes per segment
+  uint32_t        m_window;        //!< Segments in flight
+  DataRate        m_pacingRate;    //!< Send rate, 0 for unpaced
+  uint32_t        m_sndBufSize;    //!< Send buffer, in bytes
+  Time            m_minRto;        //!< Lower bound of the timeout
+  uint32_t        m_maxRetries;    //!< Timeouts before giving up
+  uint32_t        m_dupThresh;     //!< SACKed segments past a hole that mark it lost
+
+  /// A segment was sent again.
+  TracedCallback<uint32_t> m_retransmitTrace;
+};
+
+/**
+ * \brief Creates MftpRdtSockets; aggregate one to each node that uses them.
+ *
+ * Like TcpL4Protocol, the factory holds every open socket so that a
+ * connection can finish closing after the application dropped it.
+ */
+class MftpRdtSocketFactory : public SocketFactory
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Aggregate a factory to each node.
+   * \param nodes the nodes
+   */
+  static void Install (NodeContainer nodes);
+
+  virtual Ptr<Socket> CreateSocket (void);
+
+  /**
+   * \brief Drop a closed socket.
+   * \param socket the socket
+   */
+  void Remove (Ptr<MftpRdtSocket> socket);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  std::vector<Ptr<MftpRdtSocket> > m_sockets; //!< Open sockets
+};
+
+} // namespace ns3
+
+#endif /* MFTP_RDT_H */
@@ -0,0 +1,438 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_report.h"
+#include "mftp_server.h"
+#include "mftp_client.h"
+#include "mftp_proxy.h"
+#include "mftp_counting_simulator.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/ipv6-flow-classifier.h"
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MftpReport");
+
+MftpReport::MftpReport ()
+  : m_monitor (0),
+    m_ipv6 (false),
+    m_rate (0),
+    m_wireBytes (0),
+    m_wireFrames (0),
+    m_wallStart (0),
+    m_lagSamples (0)
+{
+}
+
+void
+MftpReport::EnableFlowMonitor (NodeContainer nodes, bool ipv6)
+{
+  m_ipv6 = ipv6;
+  m_monitor = m_flowHelper.Install (nodes);
+}
+
+void
+MftpReport::WatchChannel (NetDeviceContainer devices, DataRate rate)
+{
+  m_rate = rate;
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+    {
+      (*i)->TraceConnectWithoutContext ("PhyTxEnd",
+                                        MakeCallback (&MftpReport::PhyTxEnd, this));
+    }
+}
+
+void
+MftpReport::AddServers (ApplicationContainer apps)
+{
+  m_servers.Add (apps);
+}
+
+void
+MftpReport::AddClients (ApplicationContainer apps)
+{
+  m_clients.Add (apps);
+}
+
+void
+MftpReport::AddProxies (ApplicationContainer apps)
+{
+  m_proxies.Add (apps);
+}
+
+void
+MftpReport::PhyTxEnd (Ptr<const Packet> packet)
+{
+  m_wireBytes += packet->GetSize ();
+  m_wireFrames++;
+}
+
+void
+MftpReport::Print (std::ostream &os)
+{
+  double elapsed = Simulator::Now ().GetSeconds ();
+
+  if (m_monitor)
+    {
+      m_monitor->CheckForLostPackets ();
+      Ptr<Ipv4FlowClassifier> classifier4;
+      Ptr<Ipv6FlowClassifier> classifier6;
+      if (m_ipv6)
+        {
+          classifier6 = DynamicCast<Ipv6FlowClassifier> (m_flowHelper.GetClassifier6 ());
+        }
+      else
+        {
+          classifier4 = DynamicCast<Ipv4FlowClassifier> (m_flowHelper.GetClassifier ());
+        }
+
+      os << "Per-flow statistics:" << std::endl;
+      std::map<FlowId, FlowMonitor::FlowStats> stats = m_monitor->GetFlowStats ();
+      for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin ();
+           i != stats.end (); ++i)
+        {
+          const FlowMonitor::FlowStats &fs = i->second;
+          os << "  Flow " << i->first << " ";
+          if (classifier4)
+            {
+              Ipv4FlowClassifier::FiveTuple t = classifier4->FindFlow (i->first);
+              os << t.sourceAddress << ":" << t.sourcePort << " -> "
+                 << t.destinationAddress << ":" << t.destinationPort;
+            }
+          else if (classifier6)
+            {
+              Ipv6FlowClassifier::FiveTuple t = classifier6->FindFlow (i->first);
+              os << t.sourceAddress << ":" << t.sourcePort << " -> "
+                 << t.destinationAddress << ":" << t.destinationPort;
+            }
+
+          double duration = (fs.timeLastRxPacket - fs.timeFirstTxPacket).GetSeconds ();
+          double throughput = duration > 0 ? fs.rxBytes * 8.0 / duration : 0;
+          double delay = fs.rxPackets > 0 ? fs.delaySum.GetSeconds () / fs.rxPackets : 0;
+          uint32_t sent = fs.txPackets;
+          double loss = sent > 0 ? 100.0 * fs.lostPackets / sent : 0;
+          os << "  tx " << fs.txBytes << " B"
+             << "  rx " << fs.rxBytes << " B"
+             << "  throughput " << throughput / 1000 << " kbps"
+             << "  mean delay " << delay * 1000 << " ms"
+             << "  lost " << fs.lostPackets << " (" << loss << "%)"
+             << std::endl;
+        }
+    }
+
+  uint64_t appBytes = 0;
+  for (ApplicationContainer::Iterator i = m_servers.Begin (); i != m_servers.End (); ++i)
+    {
+      Ptr<PacketSink> sink = DynamicCast<PacketSink> (*i);
+      os << "Server on node " << sink->GetNode ()->GetId ()
+         << ": rx " << sink->GetTotalRx () << " B, tx " << sink->GetTotalTx ()
+         << " B in " << sink->GetWriteCount () << " writes, store " << sink->GetStoredBytes () << " B for "
+         << sink->GetFileBytes () << " B of files" << std::endl;
+      const MftpPrefetcher::Stats &prefetch = sink->GetPrefetchStats ();
+      os << "  reply cache: " << prefetch.hits << " hits, " << prefetch.misses << " misses";
+      if (prefetch.prefetches > 0)
+        {
+          os << "; prefetched " << prefetch.prefetches << ", "
+             << 100.0 * prefetch.prefetchHits / prefetch.prefetches << "% used, "
+             << prefetch.prefetchBytes - prefetch.prefetchHitBytes << " B unused";
+        }
+      if (prefetch.pushes > 0)
+        {
+          os << "; pushed " << prefetch.pushes << ", "
+             << 100.0 * prefetch.pushHits / prefetch.pushes << "% used, "
+             << prefetch.pushBytes - prefetch.pushHitBytes << " B wasted";
+        }
+      os << std::endl;
+      MftpWorkPool::Stats work = sink->GetWorkStats ();
+      if (work.submitted > 0)
+        {
+          os << "  workers: " << work.submitted << " replies built, "
+             << work.stolen << " stolen, " << work.inlined
+             << " run by the simulator thread" << std::endl;
+        }
+      appBytes += sink->GetTotalRx ();
+    }
+  for (ApplicationContainer::Iterator i = m_proxies.Begin (); i != m_proxies.End (); ++i)
+    {
+      // upstream bytes cross the backbone, client bytes only the LAN
+      Ptr<MftpProxy> proxy = DynamicCast<MftpProxy> (*i);
+      os << "Proxy on node " << proxy->GetNode ()->GetId ()
+         << ": " << proxy->GetRequestCount () << " requests, "
+         << proxy->GetHits () << " hits, " << proxy->GetCoalesced () << " coalesced, "
+         << proxy->GetFetches () << " fetched, " << proxy->GetForwarded () << " forwarded; "
+         << "upstream rx " << proxy->GetUpstreamRx () << " B for client tx "
+         << proxy->GetClientTx () << " B" << std::endl;
+    }
+  for (ApplicationContainer::Iterator i = m_clients.Begin (); i != m_clients.End (); ++i)
+    {
+      appBytes += DynamicCast<MyApp> (*i)->GetTotalRx ();
+    }
+
+  double busy = m_rate.GetBitRate () > 0
+    ? m_wireBytes * 8.0 / m_rate.GetBitRate () : 0;
+  os << "Channel: " << m_wireFrames << " frames, " << m_wireBytes << " B on the wire";
+  if (elapsed > 0)
+    {
+      os << ", utilization " << 100.0 * busy / elapsed << "%";
+    }
+  os << std::endl;
+  os << "Application goodput: " << appBytes << " B";
+  if (m_wireBytes > 0)
+    {
+      os << ", " << 100.0 * appBytes / m_wireBytes << "% of wire bytes";
+    }
+  if (elapsed > 0)
+    {
+      os << ", " << appBytes * 8.0 / elapsed / 1000 << " kbps";
+    }
+  os << std::endl;
+}
+
+void
+MftpReport::PrintBenchmark (std::ostream &os, double wallSeconds)
+{
+  uint64_t events = MftpCountingSimulatorImpl::GetEventCount ();
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  uint64_t replies = 0;
+  uint32_t finished = 0;
+  uint32_t timeouts = 0;
+  uint64_t peerRx = 0;
+  uint64_t clientRx = 0;
+  Time spanStart = Simulator::Now ();
+  Time spanEnd;
+  uint64_t serverTx = 0;
+  uint64_t serverWrites = 0;
+  uint64_t deltaReused = 0;
+  uint64_t storeBytes = 0;
+  uint64_t fileBytes = 0;
+  MftpPrefetcher::Stats prefetch;
+  MftpWorkPool::Stats work = MftpWorkPool::Stats ();
+  uint64_t proxyHits = 0;
+  uint64_t proxyCoalesced = 0;
+  uint64_t proxyUpstreamRx = 0;
+  uint64_t proxyClientTx = 0;
+  Time latencySum;
+  Time latencyMax;
+  std::vector<double> completions;
+  for (ApplicationContainer::Iterator i = m_clients.Begin (); i != m_clients.End (); ++i)
+    {
+      Ptr<MyApp> app = DynamicCast<MyApp> (*i);
+      replies += app->GetRepliesReceived ();
+      latencySum += app->GetTotalLatency ();
+      latencyMax = Max (latencyMax, app->GetMaxLatency ());
+      timeouts += app->GetTimeouts ();
+      peerRx += app->GetPeerRx ();
+      clientRx += app->GetTotalRx ();
+      deltaReused += app->GetDeltaReused ();
+      Time start, end;
+      if (app->GetActiveSpan (start, end))
+        {
+          spanStart = Min (spanStart, start);
+          spanEnd = Max (spanEnd, end);
+        }
+      if (!app->GetCompletionTime ().IsZero ())
+        {
+          finished++;
+          completions.push_back (app->GetCompletionTime ().GetSeconds ());
+        }
+    }
+  for (ApplicationContainer::Iterator i = m_servers.Begin (); i != m_servers.End (); ++i)
+    {
+      Ptr<PacketSink> sink = DynamicCast<PacketSink> (*i);
+      serverTx += sink->GetTotalTx ();
+      serverWrites += sink->GetWriteCount ();
+      storeBytes += sink->GetStoredBytes ();
+      fileBytes += sink->GetFileBytes ();
+      const MftpPrefetcher::Stats &stats = sink->GetPrefetchStats ();
+      prefetch.hits += stats.hits;
+      prefetch.prefetches += stats.prefetches;
+      prefetch.prefetchHits += stats.prefetchHits;
+      prefetch.prefetchBytes += stats.prefetchBytes;
+      prefetch.prefetchHitBytes += stats.prefetchHitBytes;
+      prefetch.pushes += stats.pushes;
+      prefetch.pushHits += stats.pushHits;
+      prefetch.pushBytes += stats.pushBytes;
+      prefetch.pushHitBytes += stats.pushHitBytes;
+      MftpWorkPool::Stats sinkWork = sink->GetWorkStats ();
+      work.submitted += sinkWork.submitted;
+      work.stolen += sinkWork.stolen;
+      work.inlined += sinkWork.inlined;
+    }
+  for (ApplicationContainer::Iterator i = m_proxies.Begin (); i != m_proxies.End (); ++i)
+    {
+      Ptr<MftpProxy> proxy = DynamicCast<MftpProxy> (*i);
+      proxyHits += proxy->GetHits ();
+      proxyCoalesced += proxy->GetCoalesced ();
+      proxyUpstreamRx += proxy->GetUpstreamRx ();
+      proxyClientTx += proxy->GetClientTx ();
+    }
+  // goodput over the time clients were fetching, not the idle lead-in
+  // and tail of the run
+  double elapsed = spanEnd > spanStart ? (spanEnd - spanStart).GetSeconds () : 0;
+  std::sort (completions.begin (), completions.end ());
+  double meanCompletion = 0;
+  for (size_t i = 0; i < completions.size (); i++)
+    {
+      meanCompletion += completions[i] / completions.size ();
+    }
+  double p99Completion = completions.empty ()
+    ? 0 : completions[std::min (completions.size () - 1, (size_t) (0.99 * completions.size ()))];
+
+  os << "BENCH"
+     << " wall_s=" << wallSeconds
+     << " events=" << events
+     << " events_per_s=" << (wallSeconds > 0 ? events / wallSeconds : 0)
+     << " peak_rss_kb=" << usage.ru_maxrss
+     << " clients=" << m_clients.GetN ()
+     << " clients_finished=" << finished
+     << " replies=" << replies
+     << " mean_latency_ms=" << (replies > 0 ? latencySum.GetSeconds () * 1000 / replies : 0)
+     << " max_latency_ms=" << latencyMax.GetSeconds () * 1000
+     << " mean_completion_s=" << meanCompletion
+     << " p99_completion_s=" << p99Completion
+     << " timeouts=" << timeouts
+     << " client_rx=" << clientRx
+     << " goodput_kbps=" << (elapsed > 0 ? clientRx * 8.0 / elapsed / 1000 : 0)
+     << " server_tx=" << serverTx
+     << " server_writes=" << serverWrites
+     << " peer_rx=" << peerRx
+     << " delta_reused=" << deltaReused
+     << " store_bytes=" << storeBytes
+     << " file_bytes=" << fileBytes
+     << " cache_hits=" << prefetch.hits
+     << " prefetches=" << prefetch.prefetches
+     << " prefetch_hits=" << prefetch.prefetchHits
+     << " prefetch_unused_bytes=" << prefetch.prefetchBytes - prefetch.prefetchHitBytes
+     << " pushes=" << prefetch.pushes
+     << " push_hits=" << prefetch.pushHits
+     << " push_wasted_bytes=" << prefetch.pushBytes - prefetch.pushHitBytes
+     << " work_jobs=" << work.submitted
+     << " work_stolen=" << work.stolen
+     << " work_inlined=" << work.inlined
+     << " proxy_hits=" << proxyHits
+     << " proxy_coalesced=" << proxyCoalesced
+     << " proxy_upstream_rx=" << proxyUpstreamRx
+     << " proxy_client_tx=" << proxyClientTx
+     << std::endl;
+}
+
+uint64_t
+MftpReport::GetCurrentRss (void)
+{
+  // second field of statm is the resident page count
+  std::ifstream statm ("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+void
+MftpReport::PrintMemoryAudit (std::ostream &os, uint64_t rssStart, uint64_t rssSetup)
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  uint64_t rssPeak = usage.ru_maxrss * 1024;
+
+  uint32_t clients = m_clients.GetN ();
+  uint32_t connections = 0;
+  for (ApplicationContainer::Iterator i = m_servers.Begin (); i != m_servers.End (); ++i)
+    {
+      connections += DynamicCast<PacketSink> (*i)->GetPeakConnections ();
+    }
+
+  os << "Memory audit:" << std::endl;
+  os << "  sizeof (MyApp) " << sizeof (MyApp) << " B, shared MyAppConfig "
+     << sizeof (MyAppConfig) << " B once" << std::endl;
+  os << "  PacketSink state per connection " << PacketSink::GetConnectionFootprint ()
+     << " B plus buffered data" << std::endl;
+  if (clients > 0)
+    {
+      // node, devices, IP stack and application
+      os << "  setup: " << (rssSetup - rssStart) / clients
+         << " B resident per client node" << std::endl;
+    }
+  if (connections > 0 && rssPeak > rssSetup)
+    {
+      // an upper bound: it includes TCP state, buffers and queued events
+      os << "  run: " << (rssPeak - rssSetup) / connections
+         << " B resident per peak connection (" << connections << " peak)" << std::endl;
+    }
+  os << "  peak resident " << rssPeak / 1024 << " KiB" << std::endl;
+}
+
+void
+MftpReport::WatchRealtimeLag (Time interval)
+{
+  m_lagInterval = interval;
+  Simulator::ScheduleNow (&MftpReport::SampleLag, this);
+}
+
+void
+MftpReport::SampleLag (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  int64_t wall = now.tv_sec * 1000000000LL + now.tv_nsec;
+  if (m_lagSamples == 0 && m_wallStart == 0)
+    {
+      m_wallStart = wall;
+      m_simStart = Simulator::Now ();
+    }
+  else
+    {
+      Time lag = NanoSeconds (wall - m_wallStart) - (Simulator::Now () - m_simStart);
+      m_lagMax = Max (m_lagMax, lag);
+      m_lagSum += lag;
+      m_lagSamples++;
+    }
+  Simulator::Schedule (m_lagInterval, &MftpReport::SampleLag, this);
+}
+
+void
+MftpReport::PrintRealtime (std::ostream &os)
+{
+  if (m_lagSamples > 0)
+    {
+      os << "Wall-clock lag: mean " << (m_lagSum / m_lagSamples).GetSeconds () * 1000
+         << " ms, max " << m_lagMax.GetSeconds () * 1000 << " ms over "
+         << m_lagSamples << " samples" << std::endl;
+    }
+  for (ApplicationContainer::Iterator i = m_servers.Begin (); i != m_servers.End (); ++i)
+    {
+      Ptr<PacketSink> sink = DynamicCast<PacketSink> (*i);
+      uint64_t requests = sink->GetRequestCount ();
+      os << "Server on node " << sink->GetNode ()->GetId () << ": "
+         << requests << " commands";
+      if (requests > 0)
+        {
+          os << ", " << sink->GetRequestCpuTime ().GetMicroSeconds () / (double) requests
+             << " us CPU per command";
+        }
+      os << std::endl;
+    }
+}
+
+} // namespace ns3
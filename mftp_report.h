@@ -0,0 +1,135 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_REPORT_H
+#define MFTP_REPORT_H
+
+#include <ostream>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/flow-monitor-helper.h"
+
+namespace ns3 {
+
+/**
+ * \brief End-of-run goodput and link utilization report for MiniFTP.
+ *
+ * Combines ns-3 FlowMonitor per-flow statistics, the bytes actually put
+ * on the CSMA channel and the byte counters kept by PacketSink and MyApp.
+ */
+class MftpReport
+{
+public:
+  MftpReport ();
+
+  /**
+   * \brief Install FlowMonitor probes on a set of nodes.
+   * \param nodes the nodes to monitor
+   * \param ipv6 whether the flows of interest are IPv6 rather than IPv4
+   */
+  void EnableFlowMonitor (NodeContainer nodes, bool ipv6);
+  /**
+   * \brief Count the bytes transmitted by a set of devices sharing a channel.
+   * \param devices the CSMA devices attached to the channel
+   * \param rate the channel data rate
+   */
+  void WatchChannel (NetDeviceContainer devices, DataRate rate);
+  /**
+   * \param apps PacketSink applications whose counters are reported
+   */
+  void AddServers (ApplicationContainer apps);
+  /**
+   * \param apps MyApp applications whose counters are reported
+   */
+  void AddClients (ApplicationContainer apps);
+  /**
+   * \param apps MftpProxy applications whose counters are reported
+   */
+  void AddProxies (ApplicationContainer apps);
+
+  /**
+   * \brief Print the report; call after Simulator::Run.
+   * \param os the output stream
+   */
+  void Print (std::ostream &os);
+
+  /**
+   * \brief Print one machine-readable "BENCH key=value ..." line with
+   * run cost and application completion times; call after Simulator::Run.
+   * \param os the output stream
+   * \param wallSeconds wall-clock time spent in Simulator::Run
+   */
+  void PrintBenchmark (std::ostream &os, double wallSeconds);
+
+  /**
+   * \brief Print resident memory per client node and per connection.
+   * \param os the output stream
+   * \param rssStart resident bytes before any node was created
+   * \param rssSetup resident bytes once the topology and apps were built
+   */
+  void PrintMemoryAudit (std::ostream &os, uint64_t rssStart, uint64_t rssSetup);
+
+  /**
+   * \brief Sample how far the simulation clock trails the wall clock.
+   *
+   * Meant for runs on the realtime scheduler: the report then shows
+   * whether the applications kept up with wall-clock rates.
+   *
+   * \param interval simulated time between samples
+   */
+  void WatchRealtimeLag (Time interval);
+
+  /**
+   * \brief Print the wall-clock lag and the CPU cost per served command.
+   * \param os the output stream
+   */
+  void PrintRealtime (std::ostream &os);
+
+  /**
+   * \return the resident set size of this process, in bytes
+   */
+  static uint64_t GetCurrentRss (void);
+
+private:
+  /**
+   * \brief Count a frame that finished transmission on the channel.
+   * \param packet the frame, including its Ethernet header and trailer
+   */
+  void PhyTxEnd (Ptr<const Packet> packet);
+  /**
+   * \brief Take one lag sample and schedule the next.
+   */
+  void SampleLag (void);
+
+  FlowMonitorHelper    m_flowHelper; //!< Owns the FlowMonitor and classifiers
+  Ptr<FlowMonitor>     m_monitor;    //!< Null unless EnableFlowMonitor was called
+  bool                 m_ipv6;       //!< Classify flows as IPv6
+  ApplicationContainer m_servers;    //!< PacketSink applications
+  ApplicationContainer m_clients;    //!< MyApp applications
+  ApplicationContainer m_proxies;    //!< MftpProxy applications
+  DataRate             m_rate;       //!< Channel data rate
+  uint64_t             m_wireBytes;  //!< Bytes transmitted on the channel
+  uint64_t             m_wireFrames; //!< Frames transmitted on the channel
+  Time                 m_lagInterval; //!< Time between lag samples
+  int64_t              m_wallStart;  //!< Wall clock at the first sample, in ns
+  Time                 m_simStart;   //!< Simulation time at the first sample
+  Time                 m_lagMax;     //!< Worst lag seen
+  Time                 m_lagSum;     //!< Sum of lag samples
+  uint32_t             m_lagSamples; //!< Number of lag samples
+};
+
+} // namespace ns3
+
+#endif /* MFTP_REPORT_H */
@@ -0,0 +1,59 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_SAMPLE_FORMAT_H
+#define MFTP_SAMPLE_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * On-disk layout of the MiniFTP metrics time series.  Like
+ * mftp_trace_format.h, this header has no ns-3 dependency so that
+ * tools/mftp_sample_reader.cc can share it.
+ *
+ * A series is one MftpSampleFileHeader followed by one fixed-size
+ * MftpSampleRecord per sample, in host byte order.  Counters are running
+ * totals, so rates are differences between consecutive records.
+ */
+
+#define MFTP_SAMPLE_MAGIC "MFTPSMP1"
+#define MFTP_SAMPLE_VERSION 1
+
+/// File header, written once at offset 0.
+struct MftpSampleFileHeader
+{
+  char     magic[8];    //!< MFTP_SAMPLE_MAGIC, not NUL terminated
+  uint32_t version;     //!< MFTP_SAMPLE_VERSION
+  uint32_t recordSize;  //!< sizeof (MftpSampleRecord)
+  int64_t  interval;    //!< Simulated time between samples, in nanoseconds
+};
+
+/// One snapshot of every server and client.
+struct MftpSampleRecord
+{
+  int64_t  time;            //!< Simulation time, in nanoseconds
+  int64_t  wall;            //!< Wall-clock time since the first sample, in nanoseconds
+  uint64_t events;          //!< Events scheduled so far, 0 if not counted
+  uint64_t serverRx;        //!< Command bytes the servers received
+  uint64_t serverTx;        //!< Reply bytes the servers sent
+  uint64_t clientRx;        //!< Reply bytes the clients received
+  uint64_t replies;         //!< Replies the clients completed
+  uint32_t connections;     //!< Connections open at the servers
+  uint32_t activeTransfers; //!< Replies being sent
+  uint32_t queueDepth;      //!< Requests waiting for a transfer slot
+  uint32_t outstanding;     //!< Client commands sent and not answered
+};
+
+#endif /* MFTP_SAMPLE_FORMAT_H */
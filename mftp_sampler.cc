@@ -0,0 +1,210 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_sampler.h"
+#include "mftp_server.h"
+#include "mftp_client.h"
+#include "mftp_counting_simulator.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/boolean.h"
+#include <cstring>
+#include <iostream>
+#include <time.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MftpSampler");
+
+NS_OBJECT_ENSURE_REGISTERED (MftpSampler);
+
+TypeId
+MftpSampler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MftpSampler")
+    .SetParent<Application> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<MftpSampler> ()
+    .AddAttribute ("Interval",
+                   "Simulated time between samples.",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&MftpSampler::m_interval),
+                   MakeTimeChecker (NanoSeconds (1)))
+    .AddAttribute ("File",
+                   "File the samples are written to, replacing any "
+                   "previous contents; empty to write none.",
+                   StringValue (""),
+                   MakeStringAccessor (&MftpSampler::m_filename),
+                   MakeStringChecker ())
+    .AddAttribute ("Progress",
+                   "Print a progress line with every sample.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&MftpSampler::m_progress),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+MftpSampler::MftpSampler ()
+  : m_file (0),
+    m_wallStart (0),
+    m_samples (0),
+    m_progress (true)
+{
+  std::memset (&m_last, 0, sizeof (m_last));
+}
+
+MftpSampler::~MftpSampler ()
+{
+}
+
+void
+MftpSampler::AddServers (ApplicationContainer apps)
+{
+  m_servers.Add (apps);
+}
+
+void
+MftpSampler::AddClients (ApplicationContainer apps)
+{
+  m_clients.Add (apps);
+}
+
+uint32_t
+MftpSampler::GetSampleCount (void) const
+{
+  return m_samples;
+}
+
+void
+MftpSampler::DoDispose (void)
+{
+  Close ();
+  // the applications sampled live on other nodes, which hold them
+  m_servers = ApplicationContainer ();
+  m_clients = ApplicationContainer ();
+  Application::DoDispose ();
+}
+
+void
+MftpSampler::StartApplication (void)
+{
+  if (!m_filename.empty () && !m_file)
+    {
+      m_file = std::fopen (m_filename.c_str (), "wb");
+      if (!m_file)
+        {
+          NS_FATAL_ERROR ("Cannot write samples to " << m_filename);
+        }
+      MftpSampleFileHeader header;
+      std::memset (&header, 0, sizeof (header));
+      std::memcpy (header.magic, MFTP_SAMPLE_MAGIC, sizeof (header.magic));
+      header.version = MFTP_SAMPLE_VERSION;
+      header.recordSize = sizeof (MftpSampleRecord);
+      header.interval = m_interval.GetNanoSeconds ();
+      std::fwrite (&header, sizeof (header), 1, m_file);
+    }
+  Sample ();
+}
+
+void
+MftpSampler::StopApplication (void)
+{
+  Close ();
+}
+
+void
+MftpSampler::Close (void)
+{
+  Simulator::Cancel (m_event);
+  if (m_file)
+    {
+      std::fclose (m_file);
+      m_file = 0;
+    }
+}
+
+void
+MftpSampler::Sample (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  int64_t wall = now.tv_sec * 1000000000LL + now.tv_nsec;
+  if (m_samples == 0)
+    {
+      m_wallStart = wall;
+    }
+
+  MftpSampleRecord record;
+  std::memset (&record, 0, sizeof (record));
+  record.time = Simulator::Now ().GetNanoSeconds ();
+  record.wall = wall - m_wallStart;
+  record.events = MftpCountingSimulatorImpl::GetEventCount ();
+  for (ApplicationContainer::Iterator i = m_servers.Begin (); i != m_servers.End (); ++i)
+    {
+      Ptr<PacketSink> sink = DynamicCast<PacketSink> (*i);
+      record.serverRx += sink->GetTotalRx ();
+      record.serverTx += sink->GetTotalTx ();
+      record.connections += sink->GetAcceptedSockets ().size ();
+      record.activeTransfers += sink->GetActiveTransfers ();
+      record.queueDepth += sink->GetQueueDepth ();
+    }
+  for (ApplicationContainer::Iterator i = m_clients.Begin (); i != m_clients.End (); ++i)
+    {
+      Ptr<MyApp> app = DynamicCast<MyApp> (*i);
+      record.clientRx += app->GetTotalRx ();
+      record.replies += app->GetRepliesReceived ();
+      record.outstanding += app->GetOutstanding ();
+    }
+
+  if (m_file)
+    {
+      // flushed, so the series can be read while the run goes on
+      std::fwrite (&record, sizeof (record), 1, m_file);
+      std::fflush (m_file);
+    }
+  if (m_progress && m_samples > 0)
+    {
+      PrintProgress (record);
+    }
+  m_last = record;
+  m_samples++;
+  m_event = Simulator::Schedule (m_interval, &MftpSampler::Sample, this);
+}
+
+void
+MftpSampler::PrintProgress (const MftpSampleRecord &record) const
+{
+  double sim = (record.time - m_last.time) / 1e9;
+  double wall = (record.wall - m_last.wall) / 1e9;
+  std::cerr << "SAMPLE " << record.time / 1e9 << "s sim, " << record.wall / 1e9 << "s wall";
+  if (record.events > 0 && wall > 0)
+    {
+      std::cerr << ", " << (record.events - m_last.events) / wall << " events/s";
+    }
+  std::cerr << ": " << record.connections << " connections, "
+            << record.activeTransfers << " sending, " << record.queueDepth << " queued, "
+            << record.outstanding << " outstanding";
+  if (sim > 0)
+    {
+      std::cerr << ", server tx " << (record.serverTx - m_last.serverTx) * 8 / sim / 1000
+                << " kbps, " << (record.replies - m_last.replies) / sim << " replies/s";
+    }
+  std::cerr << std::endl;
+}
+
+} // namespace ns3
@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_SAMPLER_H
+#define MFTP_SAMPLER_H
+
+#include <cstdio>
+#include <string>
+#include "ns3/application.h"
+#include "ns3/application-container.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "mftp_sample_format.h"
+
+namespace ns3 {
+
+/**
+ * \brief Samples MiniFTP servers and clients while a run is going.
+ *
+ * Every Interval of simulated time, sums the servers' and clients'
+ * counters into an MftpSampleRecord and appends it to File, flushed so
+ * the series can be followed during the run.  With Progress set, also
+ * prints a line with the rates since the previous sample and the events
+ * simulated per wall-clock second, which shows saturation and simulator
+ * slowdowns as they happen.  Events are only counted under
+ * MftpCountingSimulatorImpl.
+ *
+ * Use tools/mftp_sample_reader.cc to print a series as a table.
+ */
+class MftpSampler : public Application
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  MftpSampler ();
+  virtual ~MftpSampler ();
+
+  /**
+   * \param apps PacketSink applications to sample
+   */
+  void AddServers (ApplicationContainer apps);
+  /**
+   * \param apps MyApp applications to sample
+   */
+  void AddClients (ApplicationContainer apps);
+
+  /**
+   * \return the number of samples taken
+   */
+  uint32_t GetSampleCount (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  /**
+   * \brief Take one sample and schedule the next
+   */
+  void Sample (void);
+  /**
+   * \brief Print the progress line for a sample
+   * \param record the sample just taken
+   */
+  void PrintProgress (const MftpSampleRecord &record) const;
+  /**
+   * \brief Stop sampling and close the file
+   */
+  void Close (void);
+
+  ApplicationContainer m_servers; //!< PacketSink applications
+  ApplicationContainer m_clients; //!< MyApp applications
+  std::string      m_filename;  //!< Series file, empty for none
+  MftpSampleRecord m_last;      //!< Previous sample, for rates
+  EventId          m_event;     //!< Next sample
+  Time             m_interval;  //!< Time between samples
+  std::FILE       *m_file;      //!< Open series, else null
+  int64_t          m_wallStart; //!< Wall clock at the first sample, in ns
+  uint32_t         m_samples;   //!< Samples taken
+  bool             m_progress;  //!< Print a line per sample
+};
+
+} // namespace ns3
+
+#endif /* MFTP_SAMPLER_H */
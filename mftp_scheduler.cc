@@ -0,0 +1,193 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_scheduler.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+MftpRequestScheduler::MftpRequestScheduler ()
+  : m_quantum (1040),
+    m_capacity (64),
+    m_size (0)
+{
+}
+
+void
+MftpRequestScheduler::SetQuantum (uint32_t quantum)
+{
+  m_quantum = quantum > 0 ? quantum : 1;
+}
+
+void
+MftpRequestScheduler::SetCapacity (uint32_t capacity)
+{
+  m_capacity = capacity;
+}
+
+bool
+MftpRequestScheduler::Enqueue (Ptr<Socket> socket, const std::string &reply, uint32_t stream)
+{
+  if (m_size >= m_capacity)
+    {
+      return false;
+    }
+
+  std::map<Ptr<Socket>, Flow>::iterator it = m_flows.find (socket);
+  if (it == m_flows.end ())
+    {
+      Flow flow;
+      flow.deficit = 0;
+      it = m_flows.insert (std::make_pair (socket, flow)).first;
+      m_activeList.push_back (socket);
+    }
+
+  Request request;
+  request.socket = socket;
+  request.reply = reply;
+  request.enqueued = Simulator::Now ();
+  request.stream = stream;
+  it->second.queue.push_back (request);
+  m_size++;
+  return true;
+}
+
+bool
+MftpRequestScheduler::Dequeue (Request &request)
+{
+  while (!m_activeList.empty ())
+    {
+      Ptr<Socket> socket = m_activeList.front ();
+      Flow &flow = m_flows[socket];
+      // the reply goes out with its trailing NUL
+      uint32_t cost = flow.queue.front ().reply.size () + 1;
+      if (flow.deficit < cost)
+        {
+          flow.deficit += m_quantum;
+          m_activeList.pop_front ();
+          m_activeList.push_back (socket);
+          continue;
+        }
+
+      flow.deficit -= cost;
+      request = flow.queue.front ();
+      flow.queue.pop_front ();
+      m_size--;
+      if (flow.queue.empty ())
+        {
+          // an idle flow does not keep its credit
+          m_flows.erase (socket);
+          m_activeList.pop_front ();
+        }
+      return true;
+    }
+  return false;
+}
+
+void
+MftpRequestScheduler::Remove (Ptr<Socket> socket)
+{
+  std::map<Ptr<Socket>, Flow>::iterator it = m_flows.find (socket);
+  if (it == m_flows.end ())
+    {
+      return;
+    }
+  m_size -= it->second.queue.size ();
+  m_flows.erase (it);
+  m_activeList.remove (socket);
+}
+
+uint32_t
+MftpRequestScheduler::GetSize (void) const
+{
+  return m_size;
+}
+
+bool
+MftpRequestScheduler::IsEmpty (void) const
+{
+  return m_size == 0;
+}
+
+MftpTransferScheduler::MftpTransferScheduler ()
+{
+  m_weight[CONTROL] = 16;
+  m_weight[INTERACTIVE] = 8;
+  m_weight[BULK] = 1;
+  for (uint32_t i = 0; i < N_CLASSES; i++)
+    {
+      m_credit[i] = m_weight[i];
+    }
+}
+
+void
+MftpTransferScheduler::SetWeight (Class cls, uint32_t weight)
+{
+  m_weight[cls] = weight > 0 ? weight : 1;
+  m_credit[cls] = m_weight[cls];
+}
+
+void
+MftpTransferScheduler::Push (Class cls, Ptr<Socket> socket)
+{
+  m_ready[cls].push_back (socket);
+}
+
+bool
+MftpTransferScheduler::Pop (Ptr<Socket> &socket)
+{
+  // at most two passes: one with the credit left over from this round,
+  // one after starting a new round
+  for (uint32_t pass = 0; pass < 2; pass++)
+    {
+      for (uint32_t i = 0; i < N_CLASSES; i++)
+        {
+          if (!m_ready[i].empty () && m_credit[i] > 0)
+            {
+              m_credit[i]--;
+              socket = m_ready[i].front ();
+              m_ready[i].pop_front ();
+              return true;
+            }
+        }
+      for (uint32_t i = 0; i < N_CLASSES; i++)
+        {
+          m_credit[i] = m_weight[i];
+        }
+    }
+  return false;
+}
+
+void
+MftpTransferScheduler::Remove (Ptr<Socket> socket)
+{
+  for (uint32_t i = 0; i < N_CLASSES; i++)
+    {
+      std::deque<Ptr<Socket> >::iterator it = m_ready[i].begin ();
+      while (it != m_ready[i].end ())
+        {
+          it = (*it == socket) ? m_ready[i].erase (it) : it + 1;
+        }
+    }
+}
+
+uint32_t
+MftpTransferScheduler::GetSize (Class cls) const
+{
+  return m_ready[cls].size ();
+}
+
+} // namespace ns3
@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_SCHEDULER_H
+#define MFTP_SCHEDULER_H
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/socket.h"
+
+namespace ns3 {
+
+/**
+ * \brief Bounded queue of pending MiniFTP replies, shared fairly between
+ * connections with deficit round robin.
+ *
+ * Each accepted socket gets its own flow.  A flow may send a reply once
+ * its deficit covers the reply size; otherwise it is credited one quantum
+ * and moved to the back of the round.
+ */
+class MftpRequestScheduler
+{
+public:
+  /// A reply waiting for a free transfer slot.
+  struct Request
+  {
+    Ptr<Socket> socket;   //!< Connection the reply belongs to
+    std::string reply;    //!< Reply payload, without the trailing NUL
+    Time        enqueued; //!< Time the request was queued
+    uint32_t    stream;   //!< Multiplexed stream, 0 for none
+  };
+
+  MftpRequestScheduler ();
+
+  /**
+   * \param quantum bytes credited to a flow per round
+   */
+  void SetQuantum (uint32_t quantum);
+  /**
+   * \param capacity maximum number of queued requests over all flows
+   */
+  void SetCapacity (uint32_t capacity);
+
+  /**
+   * \brief Queue a reply for later service.
+   * \param socket the connection the reply belongs to
+   * \param reply the reply payload
+   * \param stream the multiplexed stream the reply goes out on, 0 for none
+   * \return false if the queue is full and the request was not queued
+   */
+  bool Enqueue (Ptr<Socket> socket, const std::string &reply, uint32_t stream = 0);
+  /**
+   * \brief Pick the next reply to serve.
+   * \param request filled with the selected request
+   * \return false if nothing is queued
+   */
+  bool Dequeue (Request &request);
+  /**
+   * \brief Drop every request queued for a connection.
+   * \param socket the connection that went away
+   */
+  void Remove (Ptr<Socket> socket);
+
+  /**
+   * \return the number of queued requests over all flows
+   */
+  uint32_t GetSize (void) const;
+  /**
+   * \return true if no request is queued
+   */
+  bool IsEmpty (void) const;
+
+private:
+  /// Per-connection queue and DRR state.
+  struct Flow
+  {
+    std::deque<Request> queue;   //!< Requests in arrival order
+    uint32_t            deficit; //!< Bytes this flow may still send
+  };
+
+  std::map<Ptr<Socket>, Flow> m_flows;      //!< Flows with queued requests
+  std::list<Ptr<Socket> >     m_activeList; //!< DRR round order
+  uint32_t                    m_quantum;    //!< Bytes credited per round
+  uint32_t                    m_capacity;   //!< Maximum queued requests
+  uint32_t                    m_size;       //!< Queued requests
+};
+
+/**
+ * \brief Weighted round robin over request classes for the server's
+ * chunked send path.
+ *
+ * Connections with a reply ready to write are queued under the class of
+ * that reply.  Each round a class may be picked as many times as its
+ * weight, so control replies and small files get ahead of bulk chunks
+ * while bulk still makes progress.
+ */
+class MftpTransferScheduler
+{
+public:
+  /// Request classes, in decreasing default priority.
+  enum Class
+  {
+    CONTROL = 0,     //!< Error and status replies without a body
+    INTERACTIVE = 1, //!< Files up to the small-file threshold
+    BULK = 2,        //!< Everything larger, sent one chunk at a time
+    N_CLASSES = 3
+  };
+
+  MftpTransferScheduler ();
+
+  /**
+   * \param cls the request class
+   * \param weight picks per round, at least one
+   */
+  void SetWeight (Class cls, uint32_t weight);
+
+  /**
+   * \brief Queue a connection whose next reply belongs to a class.
+   * \param cls the class of the connection's next reply
+   * \param socket the connection
+   */
+  void Push (Class cls, Ptr<Socket> socket);
+  /**
+   * \brief Pick the connection to write next.
+   * \param socket filled with the selected connection
+   * \return false if no connection is ready
+   */
+  bool Pop (Ptr<Socket> &socket);
+  /**
+   * \brief Forget a connection that went away.
+   * \param socket the connection
+   */
+  void Remove (Ptr<Socket> socket);
+
+  /**
+   * \param cls the request class
+   * \return the number of connections ready in that class
+   */
+  uint32_t GetSize (Class cls) const;
+
+private:
+  std::deque<Ptr<Socket> > m_ready[N_CLASSES]; //!< Ready connections per class
+  uint32_t m_weight[N_CLASSES];                //!< Picks per round
+  uint32_t m_credit[N_CLASSES];                //!< Picks left this round
+};
+
+} // namespace ns3
+
+#endif /* MFTP_SCHEDULER_H */
@@ -33,6 +33,20 @@
 #include "ns3/packet.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "mftp_trace.h"
+#include "mftp_socket.h"
+#include "mftp_swarm.h"
+#include "mftp_command.h"
+#include <cstdio>
+#include "ns3/string.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <time.h>
 
 namespace ns3 {
 
@@ -61,6 +75,195 @@ PacketSink::GetTypeId (void)
                      "A packet has been received",
                      MakeTraceSourceAccessor (&PacketSink::m_rxTrace),
                      "ns3::Packet::AddressTracedCallback")
+    .AddAttribute ("MaxConnections",
+                   "Maximum number of accepted connections; further "
+                   "connections get 421 Busy. Zero means no limit.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PacketSink::m_maxConnections),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxActiveTransfers",
+                   "Maximum number of replies in transmission at once. "
+                   "Zero means no limit.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PacketSink::m_maxActiveTransfers),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxPendingRequests",
+                   "Maximum number of requests waiting for a transfer slot; "
+                   "further requests get 421 Busy.",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&PacketSink::m_maxPending),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Quantum",
+                   "Bytes credited to each connection per deficit round "
+                   "robin round.",
+                   UintegerValue (1040),
+                   MakeUintegerAccessor (&PacketSink::m_quantum),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("SmallFileThreshold",
+                   "Largest file body, in bytes, scheduled as interactive "
+                   "rather than bulk.",
+                   UintegerValue (1040),
+                   MakeUintegerAccessor (&PacketSink::m_smallFileThreshold),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ControlWeight",
+                   "Scheduling weight of control replies (errors and busy).",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&PacketSink::m_controlWeight),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("InteractiveWeight",
+                   "Scheduling weight of small file replies.",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&PacketSink::m_interactiveWeight),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("BulkWeight",
+                   "Scheduling weight of bulk file chunks.",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&PacketSink::m_bulkWeight),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("TxBudget",
+                   "Bytes the server may have written to its sockets but not "
+                   "yet sent, over all connections. Keeping this small lets "
+                   "small replies overtake bulk transfers. Zero means no limit.",
+                   UintegerValue (4160),
+                   MakeUintegerAccessor (&PacketSink::m_txBudget),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("StreamWindow",
+                   "Bytes a multiplexed stream may send before the client "
+                   "grants more credit, unless the client sets its own "
+                   "with CREDIT 0.",
+                   UintegerValue (65535),
+                   MakeUintegerAccessor (&PacketSink::m_streamWindow),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MeasureCpu",
+                   "Measure the thread CPU time spent handling each command. "
+                   "Costs two clock reads per command.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PacketSink::m_measureCpu),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TcpVariant",
+                   "Congestion control of TCP sockets, as a TcpCongestionOps "
+                   "type name such as ns3::TcpWestwood. Empty for the node default.",
+                   StringValue (""),
+                   MakeStringAccessor (&PacketSink::m_tcpVariant),
+                   MakeStringChecker ())
+    .AddAttribute ("SndBufSize",
+                   "TCP send buffer size in bytes. Zero for the TcpSocket default.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PacketSink::m_sndBufSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RcvBufSize",
+                   "TCP receive buffer size in bytes. Zero for the TcpSocket default.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PacketSink::m_rcvBufSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ChunkSize",
+                   "Chunk size, in bytes, of files shared in swarm mode.",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&PacketSink::m_chunkSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("DedupChunkSize",
+                   "Mean size, in bytes, of the content-defined chunks the "
+                   "file store keeps once each and DELTA sends.",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&PacketSink::SetDedupChunkSize,
+                                         &PacketSink::GetDedupChunkSize),
+                   MakeUintegerChecker<uint32_t> (64))
+    .AddAttribute ("ReplyCacheSize",
+                   "Bytes of whole GET replies kept, least recently used "
+                   "first out, so they need not be rebuilt from the store. "
+                   "Zero caches nothing.",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&PacketSink::SetReplyCacheSize,
+                                         &PacketSink::GetReplyCacheSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Prefetch",
+                   "Count which file each connection asks for after which, "
+                   "and cache the likely next reply before it is asked for.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PacketSink::m_prefetch),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PrefetchPerClient",
+                   "Keep the successor counts per client address rather "
+                   "than one table for all clients.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PacketSink::m_prefetchPerClient),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PrefetchThreshold",
+                   "Least share of the transitions out of a file that its "
+                   "likeliest successor must have to be prefetched.",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&PacketSink::m_prefetchThreshold),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("PrefetchPush",
+                   "With Prefetch, also send the likely next file unasked "
+                   "to clients that multiplex, on a stream of its own that "
+                   "yields to every reply they asked for.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PacketSink::m_push),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PushRate",
+                   "Cap on the rate of pushed bytes, over all connections.",
+                   DataRateValue (DataRate ("1Mbps")),
+                   MakeDataRateAccessor (&PacketSink::m_pushRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("WriteSize",
+                   "Bytes of a bulk or multiplexed reply written at a "
+                   "time, and the starting size with AdaptiveWriteSize.",
+                   UintegerValue (1040),
+                   MakeUintegerAccessor (&PacketSink::m_packetSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("AdaptiveWriteSize",
+                   "Size writes from each connection's measured delivery "
+                   "rate and round trip time instead of WriteSize.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PacketSink::m_adaptiveWrites),
+                   MakeBooleanChecker ())
+    .AddAttribute ("WriteLatency",
+                   "With AdaptiveWriteSize, how long one write may take to "
+                   "drain at the measured rate, and so how long a small "
+                   "reply may wait behind it.  Writes never cover less "
+                   "than a round trip, or the path would run dry.",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&PacketSink::m_writeLatency),
+                   MakeTimeChecker ())
+    .AddAttribute ("MinWriteSize",
+                   "Smallest write with AdaptiveWriteSize.",
+                   UintegerValue (536),
+                   MakeUintegerAccessor (&PacketSink::m_minWriteSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxWriteSize",
+                   "Largest write with AdaptiveWriteSize.",
+                   UintegerValue (65536),
+                   MakeUintegerAccessor (&PacketSink::m_maxWriteSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Workers",
+                   "Threads that build GET and DELTA replies off the "
+                   "simulator thread, 0 to build them inline.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PacketSink::m_workers),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("WorkDelay",
+                   "Simulated time a reply built by the workers takes. "
+                   "The reply is used this long after the command came "
+                   "in however long the thread took, so runs with any "
+                   "number of workers give the same results.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&PacketSink::m_workDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("ManifestPeers",
+                   "Clients listed per chunk in a swarm manifest, most "
+                   "recent first.",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&PacketSink::m_manifestPeers),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddTraceSource ("QueueDepth",
+                     "Number of requests waiting for a transfer slot",
+                     MakeTraceSourceAccessor (&PacketSink::m_queueDepth),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("QueueWait",
+                     "Queueing delay of the most recently started transfer",
+                     MakeTraceSourceAccessor (&PacketSink::m_queueWait),
+                     "ns3::TracedValueCallback::Time")
   ;
   return tid;
 }
@@ -75,6 +278,18 @@ PacketSink::PacketSink ()
   NS_LOG_FUNCTION (this);
   m_socket = 0;
   m_totalRx = 0;
+  m_totalTx = 0;
+  m_requests = 0;
+  m_writes = 0;
+  m_requestCpuNs = 0;
+  m_activeTransfers = 0;
+  m_txBudgetUsed = 0;
+  m_peakConnections = 0;
+  m_pool = 0;
+  AddFile ("little.txt", "A");
+  AddFile ("big.txt", "A big file.");
+  AddFile ("huge.txt", "An even bigger file.\nAnd more!");
+  AddFile ("giant.txt", "Jolly, Green");
 }
 
 PacketSink::~PacketSink()
@@ -96,19 +311,159 @@ PacketSink::GetListeningSocket (void) const
   return m_socket;
 }
 
-std::list<Ptr<Socket> >
+const std::vector<Ptr<Socket> > &
 PacketSink::GetAcceptedSockets (void) const
 {
   NS_LOG_FUNCTION (this);
   return m_socketList;
 }
 
+uint32_t
+PacketSink::GetPeakConnections (void) const
+{
+  return m_peakConnections;
+}
+
+uint32_t
+PacketSink::GetConnectionFootprint (void)
+{
+  // the map node holding the connection adds three pointers and a colour
+  return sizeof (Connection) + sizeof (Ptr<Socket>) + 4 * sizeof (void *);
+}
+
+uint64_t
+PacketSink::GetTotalTx (void) const
+{
+  return m_totalTx;
+}
+
+uint64_t
+PacketSink::GetWriteCount (void) const
+{
+  return m_writes;
+}
+
+uint64_t
+PacketSink::GetRequestCount (void) const
+{
+  return m_requests;
+}
+
+Time
+PacketSink::GetRequestCpuTime (void) const
+{
+  return NanoSeconds (m_requestCpuNs);
+}
+
+void
+PacketSink::AddFile (std::string name, std::string content)
+{
+  WaitForWork ();
+  m_store.Put (name, content);
+  // a cached GET reply would still hold the old content
+  m_prefetcher.Erase (name);
+}
+
+uint64_t
+PacketSink::GetStoredBytes (void) const
+{
+  return m_store.GetStoredBytes ();
+}
+
+uint64_t
+PacketSink::GetFileBytes (void) const
+{
+  return m_store.GetLogicalBytes ();
+}
+
+void
+PacketSink::SaveState (std::ostream &os) const
+{
+  os << "server " << m_totalRx << " " << m_totalTx << " " << m_requests << "\n";
+  m_store.Save (os);
+}
+
+bool
+PacketSink::LoadState (std::istream &is, Time at)
+{
+  std::string word;
+  WaitForWork ();
+  if (!(is >> word >> m_totalRx >> m_totalTx >> m_requests) || word != "server"
+      || !m_store.Load (is))
+    {
+      return false;
+    }
+  m_prefetcher.Clear ();
+  if (Application::m_startTime < at)
+    {
+      SetStartTime (at);
+    }
+  return true;
+}
+
+void
+PacketSink::SetDedupChunkSize (uint32_t bytes)
+{
+  WaitForWork ();
+  m_store.SetAverageChunkSize (bytes);
+}
+
+uint32_t
+PacketSink::GetDedupChunkSize (void) const
+{
+  return m_store.GetAverageChunkSize ();
+}
+
+void
+PacketSink::SetReplyCacheSize (uint32_t bytes)
+{
+  m_prefetcher.SetCacheSize (bytes);
+}
+
+uint32_t
+PacketSink::GetReplyCacheSize (void) const
+{
+  return m_prefetcher.GetCacheSize ();
+}
+
+const MftpPrefetcher::Stats &
+PacketSink::GetPrefetchStats (void) const
+{
+  return m_prefetcher.GetStats ();
+}
+
+MftpWorkPool::Stats
+PacketSink::GetWorkStats (void) const
+{
+  if (m_pool)
+    {
+      return m_pool->GetStats ();
+    }
+  return MftpWorkPool::Stats ();
+}
+
+uint32_t
+PacketSink::GetActiveTransfers (void) const
+{
+  return m_activeTransfers;
+}
+
+uint32_t
+PacketSink::GetQueueDepth (void) const
+{
+  return m_scheduler.GetSize ();
+}
+
 void PacketSink::DoDispose (void)
 {
   NS_LOG_INFO("SERVER DoDispose");
   NS_LOG_FUNCTION (this);
   m_socket = 0;
   m_socketList.clear ();
+  m_connections.clear ();
+  // workers still running read the file store
+  delete m_pool;
+  m_pool = 0;
 
   // chain up
   Application::DoDispose ();
@@ -121,10 +476,20 @@ void PacketSink::StartApplication ()    // Called at time specified by Start
   NS_LOG_INFO("SERVER StartApplication");
   NS_LOG_FUNCTION (this);
   m_running = true;
+  m_scheduler.SetQuantum (m_quantum);
+  m_scheduler.SetCapacity (m_maxPending);
+  m_pump.SetWeight (MftpTransferScheduler::CONTROL, m_controlWeight);
+  m_pump.SetWeight (MftpTransferScheduler::INTERACTIVE, m_interactiveWeight);
+  m_pump.SetWeight (MftpTransferScheduler::BULK, m_bulkWeight);
+  if (m_workers > 0 && !m_pool)
+    {
+      m_pool = new MftpWorkPool (m_workers);
+    }
   // Create the socket if not already
   if (!m_socket)
     {
-      m_socket = Socket::CreateSocket (GetNode (), m_tid);
+      m_socket = MftpCreateSocket (GetNode (), m_tid, m_tcpVariant,
+                                   m_sndBufSize, m_rcvBufSize);
       m_socket->Bind (m_local);
       m_socket->Listen ();
       //m_socket->ShutdownSend ();
@@ -145,6 +510,8 @@ void PacketSink::StartApplication ()    // Called at time specified by Start
     }
 
   m_socket->SetRecvCallback (MakeCallback (&PacketSink::HandleRead, this));
+  m_socket->SetDataSentCallback (MakeCallback (&PacketSink::HandleDataSent, this));
+  m_socket->SetSendCallback (MakeCallback (&PacketSink::HandleSend, this));
   m_socket->SetAcceptCallback (
     MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
     MakeCallback (&PacketSink::HandleAccept, this));
@@ -164,11 +531,13 @@ void PacketSink::StopApplication ()     // Called at time specified by Stop
   }
 
 
-  while(!m_socketList.empty ()) //these are accepted sockets, close them
+  // these are accepted sockets, close them; closing may call back into
+  // ReleaseConnection, so work on a copy
+  std::vector<Ptr<Socket> > accepted;
+  accepted.swap (m_socketList);
+  for (std::vector<Ptr<Socket> >::iterator i = accepted.begin (); i != accepted.end (); ++i)
     {
-      Ptr<Socket> acceptedSocket = m_socketList.front ();
-      m_socketList.pop_front ();
-      acceptedSocket->Close ();
+      (*i)->Close ();
     }
   if (m_socket) 
     {
@@ -179,7 +548,7 @@ void PacketSink::StopApplication ()     // Called at time specified by Stop
 
 void PacketSink::SendPacket(Ptr<Socket> socket, const char *payload, uint32_t payload_length)
 {
-  NS_LOG_INFO("SERVER SendPacket " << payload);
+  NS_LOG_INFO("SERVER SendPacket " << std::string (payload, payload_length));
   Ptr<Packet> packet = Create<Packet> ((const uint8_t*)payload , payload_length);
   socket->Send (packet);
 }
@@ -204,61 +573,42 @@ void PacketSink::HandleRead (Ptr<Socket> socket)
   Ptr<Packet> packet;
   Address from;
   while ((packet = socket->RecvFrom (from))){
-      
-      uint8_t  *buffer = new uint8_t [packet->GetSize()];
-      packet->CopyData(buffer, packet->GetSize());
-      std::string s = std::string((char*)buffer);
-      delete [] buffer;
-      NS_LOG_INFO ("SERVER Received Packet. Payload = '" << s <<"'");
-
-// do analysis of incoming packet and reply here
-//      if(s == "GET hello.mp3"){
-//        SendPacket(socket, s.c_str(),s.size()+1);
-//      }
-      std::string outgoing = "";
-      if (0 != s.substr(0,4).compare("GET "))
-      {
-// there is only one legal command, and they did not send it
-// bounce them with 202 Command Not Implemented
-          outgoing = "202 Command Not Implemented\n\n";
-      }
-      else
-      { 
-         s.erase(0,4);
-         if (0==s.compare("little.txt\n\n"))
-         {
-           outgoing = "200 OK 1\n\nA";
-         }
-         else if (0==s.compare("big.txt\n\n"))
-         {
-           outgoing = "200 OK 11\n\nA big file.";
-         }
-	 else if (0==s.compare("huge.txt\n\n"))
-         {
-           outgoing = "200 OK 31\n\nAn even bigger file.\nAnd more!";
-         }
-         else if (0==s.compare("giant.txt\n\n"))
-         {
-           outgoing = "200 OK 12\n\nJolly, Green";
-         }
-         else
-         {
-           outgoing = "550 File Unavailable\n\n";
-         }
-      }
-     
-// do the reply here
-      std::cout << "Server outgoing = '" << outgoing << "'\n";
-      if (outgoing.size()>0)
-      {
-        std::cout << "Server sending '" << outgoing << "'" << std::endl;
-        SendPacket(socket, outgoing.c_str(), outgoing.size()+1);
-      }
-	
+
       if (packet->GetSize () == 0)
         { //EOF
           break;
         }
+
+      uint8_t  *buffer = new uint8_t [packet->GetSize()];
+      packet->CopyData(buffer, packet->GetSize());
+      // TCP may split or coalesce commands, so they are reassembled per
+      // connection and split on the "\n\n" terminator
+      std::string &pending = GetConnection (socket).rxBuffer;
+      pending.append ((char*)buffer, packet->GetSize());
+      delete [] buffer;
+
+      std::string::size_type end;
+      while ((end = pending.find ("\n\n")) != std::string::npos)
+        {
+          // clients terminate each command with a NUL
+          std::string::size_type begin = pending.find_first_not_of ('\0');
+          std::string s = pending.substr (begin, end + 2 - begin);
+          pending.erase (0, end + 2);
+          NS_LOG_INFO ("SERVER Received Packet. Payload = '" << s <<"'");
+          struct timespec cpuStart, cpuEnd;
+          if (m_measureCpu)
+            {
+              clock_gettime (CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+            }
+          HandleRequest (socket, s);
+          if (m_measureCpu)
+            {
+              clock_gettime (CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+              m_requestCpuNs += (cpuEnd.tv_sec - cpuStart.tv_sec) * 1000000000LL
+                + (cpuEnd.tv_nsec - cpuStart.tv_nsec);
+            }
+        }
+
       m_totalRx += packet->GetSize ();
       if (InetSocketAddress::IsMatchingType (from))
         {
@@ -278,26 +628,898 @@ void PacketSink::HandleRead (Ptr<Socket> socket)
                        << " port " << Inet6SocketAddress::ConvertFrom (from).GetPort ()
                        << " total Rx " << m_totalRx << " bytes");
         }
-	
-//      if(s == "GET hello.mp3"){
-//	NS_LOG_INFO("SERVER Sending MSG 'hello.mp3' to CLIENT");	
-//      }
 
       m_rxTrace (packet, from); // receives packet source address
     }
 }
 
+std::string
+PacketSink::BuildReply (Ptr<Socket> socket, const MftpCommand &command)
+{
+  switch (command.verb)
+    {
+    case MFTP_VERB_GET:
+      break;
+    case MFTP_VERB_DELTA:
+      return BuildDeltaReply (command);
+    case MFTP_VERB_MANIFEST:
+    case MFTP_VERB_CHUNK:
+    case MFTP_VERB_HAVE:
+      return BuildSwarmReply (socket, command);
+    case MFTP_VERB_PUSHED:
+      {
+        Connection &connection = GetConnection (socket);
+        std::map<std::string, uint32_t>::iterator push
+          = connection.pushed.find (std::string (command.args.data, command.args.size));
+        if (push != connection.pushed.end ())
+          {
+            m_prefetcher.CountPushHit (push->second);
+            connection.pushed.erase (push);
+          }
+        return "250 Noted\n\n";
+      }
+    default:
+      // bounce anything else with 202 Command Not Implemented
+      return "202 Command Not Implemented\n\n";
+    }
+
+  // the whole argument is the name
+  std::string name (command.args.data, command.args.size);
+  const std::string *cached = m_prefetcher.Lookup (name);
+  if (cached)
+    {
+      return *cached;
+    }
+  std::string reply;
+  if (!RenderFile (name, reply))
+    {
+      return "550 File Unavailable\n\n";
+    }
+  m_prefetcher.Insert (name, reply, false);
+  return reply;
+}
+
+bool
+PacketSink::RenderFile (const std::string &name, std::string &reply) const
+{
+  std::string content;
+  if (!m_store.Get (name, content))
+    {
+      return false;
+    }
+  std::ostringstream header;
+  header << "200 OK " << content.size () << "\n\n";
+  reply = header.str () + content;
+  return true;
+}
+
+void
+PacketSink::Prefetch (Ptr<Socket> socket, const std::string &file, uint32_t stream)
+{
+  Connection &connection = GetConnection (socket);
+  std::string client;
+  if (m_prefetchPerClient && InetSocketAddress::IsMatchingType (connection.peer))
+    {
+      // by host: a client that reconnects comes from another port
+      std::ostringstream host;
+      host << InetSocketAddress::ConvertFrom (connection.peer).GetIpv4 ();
+      client = host.str ();
+    }
+  else if (m_prefetchPerClient && Inet6SocketAddress::IsMatchingType (connection.peer))
+    {
+      std::ostringstream host;
+      host << Inet6SocketAddress::ConvertFrom (connection.peer).GetIpv6 ();
+      client = host.str ();
+    }
+  if (!connection.lastFile.empty ())
+    {
+      m_prefetcher.Observe (client, connection.lastFile, file);
+    }
+  connection.lastFile = file;
+
+  std::string next;
+  if (m_prefetcher.Predict (client, file, next) < m_prefetchThreshold || next == file)
+    {
+      return;
+    }
+  std::string reply;
+  const std::string *cached = m_prefetcher.Peek (next);
+  if (cached)
+    {
+      reply = *cached;
+    }
+  else if (RenderFile (next, reply))
+    {
+      m_prefetcher.Insert (next, reply, true);
+    }
+  else
+    {
+      return;
+    }
+
+  // a push needs a stream to go on, and one at a time per connection
+  // keeps it to spare capacity
+  if (!m_push || stream == 0 || connection.pushed.count (next)
+      || Simulator::Now () < m_pushAllowedAt)
+    {
+      return;
+    }
+  for (uint32_t i = 0; i < connection.transfers.size (); i++)
+    {
+      if (!connection.transfers[i].push.empty ())
+        {
+          return;
+        }
+    }
+  Transfer transfer;
+  transfer.data = reply;
+  transfer.data.push_back ('\0');
+  transfer.push = next;
+  transfer.written = 0;
+  transfer.stream = connection.nextPush++;
+  transfer.credit = connection.window;
+  transfer.cls = MftpTransferScheduler::BULK;
+  transfer.admitted = false;
+  connection.pushed[next] = transfer.data.size ();
+  m_prefetcher.CountPush (transfer.data.size ());
+  m_pushAllowedAt = Simulator::Now () + m_pushRate.CalculateBytesTxTime (transfer.data.size ());
+  NS_LOG_INFO ("SERVER Pushing " << next << " on stream " << transfer.stream);
+  connection.transfers.push_back (transfer);
+  Schedule (socket, connection);
+  Pump ();
+}
+
+std::string
+PacketSink::BuildDeltaReply (const MftpCommand &command) const
+{
+  MftpToken rest = command.args;
+  MftpToken word;
+  MftpNextWord (rest, word);
+  const std::vector<uint64_t> *recipe = m_store.GetRecipe (std::string (word.data, word.size));
+  if (!recipe)
+    {
+      return "550 File Unavailable\n\n";
+    }
+  std::vector<uint64_t> held;
+  uint64_t id;
+  while (MftpNextWord (rest, word))
+    {
+      if (!MftpWordToNumber (word, 16, id))
+        {
+          return "501 Syntax Error\n\n";
+        }
+      held.push_back (id);
+    }
+  std::sort (held.begin (), held.end ());
+
+  std::ostringstream body;
+  uint64_t size = 0;
+  for (uint32_t i = 0; i < recipe->size (); i++)
+    {
+      size += m_store.GetChunk ((*recipe)[i])->size ();
+    }
+  body << size << " " << recipe->size () << "\n";
+  for (uint32_t i = 0; i < recipe->size (); i++)
+    {
+      uint64_t id = (*recipe)[i];
+      char hex[17];
+      std::snprintf (hex, sizeof (hex), "%016llx", (unsigned long long) id);
+      if (std::binary_search (held.begin (), held.end (), id))
+        {
+          body << "= " << hex << "\n";
+        }
+      else
+        {
+          const std::string *chunk = m_store.GetChunk (id);
+          body << "+ " << hex << " " << chunk->size () << "\n" << *chunk;
+        }
+    }
+  std::ostringstream reply;
+  reply << "200 OK " << body.str ().size () << "\n\n" << body.str ();
+  return reply.str ();
+}
+
+std::string
+PacketSink::BuildSwarmReply (Ptr<Socket> socket, const MftpCommand &command)
+{
+  MftpToken rest = command.args;
+  MftpToken word;
+  MftpNextWord (rest, word);
+  std::string name (word.data, word.size);
+  std::string content;
+  if (!m_store.Get (name, content))
+    {
+      return "550 File Unavailable\n\n";
+    }
+  uint32_t chunks = (content.size () + m_chunkSize - 1) / m_chunkSize;
+  std::vector<std::vector<Address> > &holders = m_holders[name];
+  holders.resize (chunks);
+
+  if (command.verb == MFTP_VERB_MANIFEST)
+    {
+      // list the latest holders of each chunk, leaving out the asker
+      const Address &asker = GetConnection (socket).peer;
+      std::ostringstream body;
+      body << content.size () << " " << m_chunkSize << " " << chunks << "\n";
+      for (uint32_t c = 0; c < chunks; c++)
+        {
+          std::ostringstream line;
+          uint32_t listed = 0;
+          for (std::vector<Address>::reverse_iterator h = holders[c].rbegin ();
+               h != holders[c].rend () && listed < m_manifestPeers; ++h)
+            {
+              if (!MftpSameHost (*h, asker))
+                {
+                  line << " " << MftpFormatPeer (*h);
+                  listed++;
+                }
+            }
+          if (listed > 0)
+            {
+              body << c << line.str () << "\n";
+            }
+        }
+      std::ostringstream reply;
+      reply << "200 OK " << body.str ().size () << "\n\n" << body.str ();
+      return reply.str ();
+    }
+
+  uint64_t chunk;
+  if (!MftpNextWord (rest, word) || !MftpWordToNumber (word, 10, chunk) || chunk >= chunks)
+    {
+      return "550 File Unavailable\n\n";
+    }
+  if (command.verb == MFTP_VERB_CHUNK)
+    {
+      std::string body = content.substr (chunk * m_chunkSize, m_chunkSize);
+      std::ostringstream reply;
+      reply << "200 OK " << body.size () << "\n\n" << body;
+      return reply.str ();
+    }
+
+  // HAVE: the client serves the chunk from its own port
+  uint64_t port;
+  const Address &peer = GetConnection (socket).peer;
+  if (!MftpNextWord (rest, word) || !MftpWordToNumber (word, 10, port)
+      || port > 0xffff || peer.IsInvalid ())
+    {
+      return "501 Syntax Error\n\n";
+    }
+  Address holder;
+  if (InetSocketAddress::IsMatchingType (peer))
+    {
+      holder = InetSocketAddress (InetSocketAddress::ConvertFrom (peer).GetIpv4 (), port);
+    }
+  else
+    {
+      holder = Inet6SocketAddress (Inet6SocketAddress::ConvertFrom (peer).GetIpv6 (), port);
+    }
+  std::vector<Address> &list = holders[chunk];
+  if (std::find (list.begin (), list.end (), holder) == list.end ())
+    {
+      list.push_back (holder);
+      if (list.size () > 2 * m_manifestPeers)
+        {
+          // only the latest are ever listed
+          list.erase (list.begin ());
+        }
+    }
+  return "250 Noted\n\n";
+}
+
+void
+PacketSink::HandleRequest (Ptr<Socket> socket, std::string s)
+{
+  const char *data = s.data ();
+  uint32_t size = s.size ();
+  uint32_t stream = MftpParseStream (data, size);
+  MftpCommand command;
+  if (MftpParseCommand (data, size, command) == MFTP_VERB_CREDIT)
+    {
+      // flow control only, never answered
+      HandleCredit (socket, command);
+      return;
+    }
+  if (m_pool && Defer (socket, s, command))
+    {
+      return;
+    }
+  Respond (socket, s, stream, command, BuildReply (socket, command));
+}
+
+void
+PacketSink::Respond (Ptr<Socket> socket, const std::string &s, uint32_t stream,
+                     const MftpCommand &command, const std::string &outgoing)
+{
+  std::cout << "Server outgoing = '" << outgoing << "'\n";
+  if (outgoing.size () == 0)
+    {
+      return;
+    }
+  // CREDIT frames and anything else left unanswered are not counted
+  m_requests++;
+  MftpTraceWriter::Record (MFTP_EV_SERVER_REQUEST, GetNode ()->GetId (), 0,
+                           std::atoi (outgoing.c_str ()), s.size ());
+
+  // control replies are cheap and never wait for a slot; files are
+  // served in arrival order while transfer slots are free, then wait in
+  // the fair queue, and once that fills the client is told to back off
+  if (Classify (outgoing) == MftpTransferScheduler::CONTROL)
+    {
+      QueueTransfer (socket, outgoing, false, stream);
+    }
+  else if (CanStartTransfer () && m_scheduler.IsEmpty ())
+    {
+      StartTransfer (socket, outgoing, stream);
+    }
+  else if (m_scheduler.Enqueue (socket, outgoing, stream))
+    {
+      NS_LOG_INFO ("SERVER Queued request, " << m_scheduler.GetSize ()
+                   << " pending");
+      m_queueDepth = m_scheduler.GetSize ();
+    }
+  else
+    {
+      NS_LOG_INFO ("SERVER Request queue full, rejecting");
+      MftpTraceWriter::Record (MFTP_EV_REJECT, GetNode ()->GetId (), 0, 421, 0);
+      QueueTransfer (socket, "421 Busy\n\n", false, stream);
+    }
+
+  if (m_prefetch && (command.verb == MFTP_VERB_GET || command.verb == MFTP_VERB_PUSHED))
+    {
+      Prefetch (socket, std::string (command.args.data, command.args.size), stream);
+    }
+}
+
+std::string
+PacketSink::RenderJob (std::string name) const
+{
+  std::string reply;
+  RenderFile (name, reply);
+  return reply;
+}
+
+std::string
+PacketSink::DeltaJob (std::string args) const
+{
+  MftpCommand command;
+  command.verb = MFTP_VERB_DELTA;
+  command.args.data = args.data ();
+  command.args.size = args.size ();
+  return BuildDeltaReply (command);
+}
+
+bool
+PacketSink::Defer (Ptr<Socket> socket, const std::string &s, const MftpCommand &command)
+{
+  Connection &connection = GetConnection (socket);
+  Deferred deferred;
+  deferred.request = s;
+  deferred.due = true;
+  std::string args (command.args.data, command.args.size);
+  if (command.verb == MFTP_VERB_GET && !m_prefetcher.Peek (args))
+    {
+      deferred.job = m_pool->Submit (std::bind (&PacketSink::RenderJob, this, args));
+    }
+  else if (command.verb == MFTP_VERB_DELTA)
+    {
+      deferred.job = m_pool->Submit (std::bind (&PacketSink::DeltaJob, this, args));
+    }
+  if (!deferred.job && connection.deferred.empty ())
+    {
+      return false;
+    }
+  if (deferred.job)
+    {
+      // a fixed delay, not the thread's finish, orders what follows
+      deferred.due = false;
+      Simulator::Schedule (m_workDelay, &PacketSink::CompleteWork, this, socket);
+    }
+  // later commands wait too, so replies keep command order
+  connection.deferred.push_back (deferred);
+  return true;
+}
+
+void
+PacketSink::CompleteWork (Ptr<Socket> socket)
+{
+  std::map<Ptr<Socket>, Connection>::iterator it = m_connections.find (socket);
+  if (it == m_connections.end ())
+    {
+      return;
+    }
+  std::vector<Deferred> &deferred = it->second.deferred;
+  for (uint32_t i = 0; i < deferred.size (); i++)
+    {
+      if (!deferred[i].due)
+        {
+          deferred[i].due = true;
+          break;
+        }
+    }
+
+  while (true)
+    {
+      // answering may close the connection, so look it up each time
+      it = m_connections.find (socket);
+      if (it == m_connections.end () || it->second.deferred.empty ()
+          || !it->second.deferred.front ().due)
+        {
+          return;
+        }
+      Deferred next = it->second.deferred.front ();
+      it->second.deferred.erase (it->second.deferred.begin ());
+
+      const char *data = next.request.data ();
+      uint32_t size = next.request.size ();
+      uint32_t stream = MftpParseStream (data, size);
+      MftpCommand command;
+      MftpParseCommand (data, size, command);
+      std::string outgoing;
+      if (!next.job)
+        {
+          outgoing = BuildReply (socket, command);
+        }
+      else if (command.verb == MFTP_VERB_DELTA)
+        {
+          outgoing = m_pool->Wait (next.job);
+        }
+      else
+        {
+          // the cache counts the GET as it would inline; the worker's
+          // reply goes unused if an earlier one filled it meanwhile
+          std::string name (command.args.data, command.args.size);
+          const std::string *cached = m_prefetcher.Lookup (name);
+          const std::string &built = m_pool->Wait (next.job);
+          if (cached)
+            {
+              outgoing = *cached;
+            }
+          else if (built.empty ())
+            {
+              outgoing = "550 File Unavailable\n\n";
+            }
+          else
+            {
+              outgoing = built;
+              m_prefetcher.Insert (name, outgoing, false);
+            }
+        }
+      Respond (socket, next.request, stream, command, outgoing);
+    }
+}
+
+void
+PacketSink::WaitForWork (void)
+{
+  if (!m_pool)
+    {
+      return;
+    }
+  for (std::map<Ptr<Socket>, Connection>::iterator i = m_connections.begin ();
+       i != m_connections.end (); ++i)
+    {
+      for (uint32_t d = 0; d < i->second.deferred.size (); d++)
+        {
+          if (i->second.deferred[d].job)
+            {
+              m_pool->Wait (i->second.deferred[d].job);
+            }
+        }
+    }
+}
+
+MftpTransferScheduler::Class
+PacketSink::Classify (const std::string &reply) const
+{
+  if (0 != reply.compare (0, 7, "200 OK "))
+    {
+      return MftpTransferScheduler::CONTROL;
+    }
+  uint32_t length = std::strtoul (reply.c_str () + 7, 0, 10);
+  if (length <= m_smallFileThreshold)
+    {
+      return MftpTransferScheduler::INTERACTIVE;
+    }
+  return MftpTransferScheduler::BULK;
+}
+
+void
+PacketSink::StartTransfer (Ptr<Socket> socket, const std::string &reply, uint32_t stream)
+{
+  m_activeTransfers++;
+  std::cout << "Server sending '" << reply << "'" << std::endl;
+  QueueTransfer (socket, reply, true, stream);
+}
+
+void
+PacketSink::QueueTransfer (Ptr<Socket> socket, const std::string &reply, bool admitted,
+                           uint32_t stream)
+{
+  Connection &connection = GetConnection (socket);
+  Transfer transfer;
+  transfer.data = reply;
+  transfer.data.push_back ('\0');
+  transfer.written = 0;
+  transfer.stream = stream;
+  transfer.credit = stream != 0 ? connection.window : UINT32_MAX;
+  transfer.cls = Classify (reply);
+  transfer.admitted = admitted;
+
+  connection.transfers.push_back (transfer);
+  Schedule (socket, connection);
+  Pump ();
+}
+
+int
+PacketSink::NextTransfer (const Connection &connection) const
+{
+  int next = -1;
+  for (uint32_t i = 0; i < connection.transfers.size (); i++)
+    {
+      const Transfer &transfer = connection.transfers[i];
+      if (transfer.stream == 0)
+        {
+          // unframed replies keep their order, so only the first may go
+          return next == -1 ? i : next;
+        }
+      if (transfer.credit == 0)
+        {
+          continue;
+        }
+      // pushes only take what replies asked for leave
+      if (next == -1
+          || (transfer.push.empty () && !connection.transfers[next].push.empty ())
+          || (transfer.push.empty () == connection.transfers[next].push.empty ()
+              && transfer.cls < connection.transfers[next].cls))
+        {
+          next = i;
+        }
+    }
+  return next;
+}
+
+void
+PacketSink::Schedule (Ptr<Socket> socket, Connection &connection)
+{
+  if (connection.scheduled || connection.blocked)
+    {
+      return;
+    }
+  int next = NextTransfer (connection);
+  if (next >= 0)
+    {
+      m_pump.Push (connection.transfers[next].cls, socket);
+      connection.scheduled = true;
+    }
+}
+
+void
+PacketSink::Pump (void)
+{
+  Ptr<Socket> socket;
+  while (m_running && (m_txBudget == 0 || m_txBudgetUsed < m_txBudget)
+         && m_pump.Pop (socket))
+    {
+      Connection &connection = m_connections[socket];
+      connection.scheduled = false;
+      int next = NextTransfer (connection);
+      if (next < 0)
+        {
+          continue;
+        }
+      Transfer &transfer = connection.transfers[next];
+      uint32_t available = socket->GetTxAvailable ();
+
+      // bulk replies, and every multiplexed reply, go out a chunk at a
+      // time so that smaller replies can get in between
+      uint32_t chunk = transfer.data.size () - transfer.written;
+      if (transfer.cls == MftpTransferScheduler::BULK || transfer.stream != 0)
+        {
+          chunk = std::min (chunk, GetWriteSize (connection));
+        }
+      std::string frame;
+      if (transfer.stream != 0)
+        {
+          chunk = std::min (chunk, transfer.credit);
+          std::ostringstream header;
+          if (transfer.written == 0 && !transfer.push.empty ())
+            {
+              // a push is announced ahead of its first frame
+              header << "P" << transfer.stream << " " << transfer.push << "\n";
+            }
+          header << "D" << transfer.stream << " ";
+          std::string prefix = header.str ();
+          header << chunk << "\n";
+          frame = header.str ();
+          if (available <= frame.size ())
+            {
+              available = 0;
+            }
+          else if (available < frame.size () + chunk)
+            {
+              chunk = available - frame.size ();
+              std::ostringstream length;
+              length << chunk << "\n";
+              frame = prefix + length.str ();
+            }
+        }
+      if (available == 0)
+        {
+          // HandleSend puts the connection back once the buffer drains
+          connection.blocked = true;
+          continue;
+        }
+      chunk = std::min (chunk, available);
+
+      if (transfer.stream != 0)
+        {
+          frame.append (transfer.data, transfer.written, chunk);
+          SendPacket (socket, frame.data (), frame.size ());
+          transfer.credit -= chunk;
+        }
+      else
+        {
+          SendPacket (socket, transfer.data.data () + transfer.written, chunk);
+        }
+      uint32_t wire = transfer.stream != 0 ? frame.size () : chunk;
+      m_writes++;
+      transfer.written += chunk;
+      connection.written += wire;
+      m_txBudgetUsed += wire;
+
+      if (transfer.written == transfer.data.size ())
+        {
+          Completion completion;
+          completion.end = connection.written;
+          completion.size = transfer.data.size ();
+          completion.status = std::atoi (transfer.data.c_str ());
+          completion.admitted = transfer.admitted;
+          connection.completions.push_back (completion);
+          connection.transfers.erase (connection.transfers.begin () + next);
+        }
+      else if (transfer.stream != 0)
+        {
+          // streams of the same class take turns
+          std::rotate (connection.transfers.begin () + next,
+                       connection.transfers.begin () + next + 1,
+                       connection.transfers.end ());
+        }
+      Schedule (socket, connection);
+    }
+}
+
+void
+PacketSink::HandleCredit (Ptr<Socket> socket, const MftpCommand &command)
+{
+  MftpToken rest = command.args;
+  MftpToken word;
+  uint64_t stream;
+  uint64_t bytes;
+  if (!MftpNextWord (rest, word) || !MftpWordToNumber (word, 10, stream)
+      || !MftpNextWord (rest, word) || !MftpWordToNumber (word, 10, bytes))
+    {
+      return;
+    }
+  Connection &connection = GetConnection (socket);
+  bytes = std::min<uint64_t> (bytes, UINT32_MAX);
+  if (stream == 0)
+    {
+      connection.window = std::max<uint64_t> (bytes, 1);
+      return;
+    }
+  for (std::vector<Transfer>::iterator t = connection.transfers.begin ();
+       t != connection.transfers.end (); ++t)
+    {
+      if (t->stream == stream)
+        {
+          t->credit = std::min<uint64_t> ((uint64_t) t->credit + bytes, UINT32_MAX);
+          Schedule (socket, connection);
+          Pump ();
+          return;
+        }
+    }
+}
+
+bool
+PacketSink::CanStartTransfer (void) const
+{
+  return m_maxActiveTransfers == 0 || m_activeTransfers < m_maxActiveTransfers;
+}
+
+void
+PacketSink::ServePending (void)
+{
+  MftpRequestScheduler::Request request;
+  while (m_running && CanStartTransfer () && m_scheduler.Dequeue (request))
+    {
+      m_queueDepth = m_scheduler.GetSize ();
+      m_queueWait = Simulator::Now () - request.enqueued;
+      StartTransfer (request.socket, request.reply, request.stream);
+    }
+}
+
+void
+PacketSink::HandleDataSent (Ptr<Socket> socket, uint32_t bytes)
+{
+  std::map<Ptr<Socket>, Connection>::iterator it = m_connections.find (socket);
+  if (it == m_connections.end ())
+    {
+      // rejected connections are not tracked
+      return;
+    }
+
+  Connection &connection = it->second;
+  connection.sent += bytes;
+  m_totalTx += bytes;
+  if (connection.probeEnd == 0)
+    {
+      // time the last byte just sent until its buffer space comes back
+      uint32_t available = socket->GetTxAvailable ();
+      connection.probeEnd = connection.sent;
+      connection.probeSent = Simulator::Now ();
+      uint64_t queued = connection.bufferSize - std::min (available, connection.bufferSize);
+      connection.probeAcked = connection.written - std::min (connection.written, queued);
+      connection.probeBusy = connection.written > connection.sent;
+    }
+  m_txBudgetUsed -= std::min<uint64_t> (bytes, m_txBudgetUsed);
+  while (!connection.completions.empty ()
+         && connection.sent >= connection.completions.front ().end)
+    {
+      const Completion &completion = connection.completions.front ();
+      MftpTraceWriter::Record (MFTP_EV_SERVER_REPLY, GetNode ()->GetId (), 0,
+                               completion.status, completion.size);
+      if (completion.admitted)
+        {
+          m_activeTransfers--;
+        }
+      connection.completions.erase (connection.completions.begin ());
+    }
+  ServePending ();
+  Pump ();
+}
+
+void
+PacketSink::HandleSend (Ptr<Socket> socket, uint32_t available)
+{
+  std::map<Ptr<Socket>, Connection>::iterator it = m_connections.find (socket);
+  if (it == m_connections.end ())
+    {
+      return;
+    }
+  // called as acknowledgements free buffer space
+  MeasurePath (it->second, available);
+  if (!it->second.blocked)
+    {
+      return;
+    }
+  it->second.blocked = false;
+  Schedule (socket, it->second);
+  Pump ();
+}
+
+void
+PacketSink::MeasurePath (Connection &connection, uint32_t available)
+{
+  uint64_t queued = connection.bufferSize - std::min (available, connection.bufferSize);
+  uint64_t acked = connection.written - std::min (connection.written, queued);
+  if (connection.probeEnd == 0 || acked < connection.probeEnd)
+    {
+      return;
+    }
+  Time rtt = Simulator::Now () - connection.probeSent;
+  connection.probeEnd = 0;
+  if (!rtt.IsStrictlyPositive ())
+    {
+      return;
+    }
+  connection.srtt = connection.srtt.IsZero () ? rtt : (connection.srtt * 7 + rtt) / 8;
+
+  // bytes delivered over the probe's round trip; when the application
+  // left the socket idle that understates the path, so such samples
+  // may only raise the estimate
+  double rate = (acked - connection.probeAcked) / rtt.GetSeconds ();
+  if (connection.rate == 0 || rate > connection.rate)
+    {
+      connection.rate = rate;
+    }
+  else if (connection.probeBusy)
+    {
+      connection.rate = (connection.rate * 7 + rate) / 8;
+    }
+}
+
+uint32_t
+PacketSink::GetWriteSize (const Connection &connection) const
+{
+  if (!m_adaptiveWrites || connection.rate == 0)
+    {
+      return m_packetSize;
+    }
+  // larger writes mean fewer calls per byte, smaller ones less for a
+  // control reply to wait behind
+  Time drain = Max (m_writeLatency, connection.srtt);
+  double bytes = connection.rate * drain.GetSeconds ();
+  return (uint32_t) std::max<double> (m_minWriteSize, std::min<double> (m_maxWriteSize, bytes));
+}
+
+PacketSink::Connection &
+PacketSink::GetConnection (Ptr<Socket> socket)
+{
+  std::map<Ptr<Socket>, Connection>::iterator it = m_connections.find (socket);
+  if (it == m_connections.end ())
+    {
+      Connection connection;
+      connection.written = 0;
+      connection.sent = 0;
+      connection.rate = 0;
+      connection.probeEnd = 0;
+      connection.probeAcked = 0;
+      connection.bufferSize = socket->GetTxAvailable ();
+      connection.probeBusy = false;
+      connection.window = m_streamWindow;
+      // above any stream a client numbers its commands with
+      connection.nextPush = 0x80000000u;
+      connection.blocked = false;
+      connection.scheduled = false;
+      it = m_connections.insert (std::make_pair (socket, connection)).first;
+    }
+  return it->second;
+}
+
+void
+PacketSink::ReleaseConnection (Ptr<Socket> socket)
+{
+  std::map<Ptr<Socket>, Connection>::iterator it = m_connections.find (socket);
+  if (it != m_connections.end ())
+    {
+      Connection &connection = it->second;
+      // a job still running would outlive the connection and race the
+      // next change to the file store
+      for (uint32_t d = 0; d < connection.deferred.size (); d++)
+        {
+          if (connection.deferred[d].job)
+            {
+              m_pool->Wait (connection.deferred[d].job);
+            }
+        }
+      for (std::vector<Transfer>::iterator t = connection.transfers.begin ();
+           t != connection.transfers.end (); ++t)
+        {
+          m_activeTransfers -= t->admitted ? 1 : 0;
+        }
+      for (std::vector<Completion>::iterator c = connection.completions.begin ();
+           c != connection.completions.end (); ++c)
+        {
+          m_activeTransfers -= c->admitted ? 1 : 0;
+        }
+      uint64_t unsent = connection.written - connection.sent;
+      m_txBudgetUsed -= std::min<uint64_t> (unsent, m_txBudgetUsed);
+      m_connections.erase (it);
+    }
+  MftpTraceWriter::Record (MFTP_EV_CLOSE, GetNode ()->GetId (), 0, 0, 0);
+  m_pump.Remove (socket);
+  m_scheduler.Remove (socket);
+  m_queueDepth = m_scheduler.GetSize ();
+  m_socketList.erase (std::remove (m_socketList.begin (), m_socketList.end (), socket),
+                      m_socketList.end ());
+  ServePending ();
+  Pump ();
+}
+
 
 void PacketSink::HandlePeerClose (Ptr<Socket> socket)
 {
   NS_LOG_INFO("SERVER HandlePeerClose");
   NS_LOG_FUNCTION (this << socket);
+  ReleaseConnection (socket);
 }
  
 void PacketSink::HandlePeerError (Ptr<Socket> socket)
 {
   NS_LOG_INFO("SERVER HandlePeerError");
   NS_LOG_FUNCTION (this << socket);
+  ReleaseConnection (socket);
 }
  
 
@@ -305,8 +1527,25 @@ void PacketSink::HandleAccept (Ptr<Socket> s, const Address& from)
 {
   NS_LOG_INFO("SERVER HandleAccept");
   NS_LOG_FUNCTION (this << s << from);
+  if (m_maxConnections > 0 && m_socketList.size () >= m_maxConnections)
+    {
+      NS_LOG_INFO ("SERVER Connection limit reached, rejecting");
+      MftpTraceWriter::Record (MFTP_EV_REJECT, GetNode ()->GetId (), 0, 421, 0);
+      std::string busy = "421 Busy\n\n";
+      SendPacket (s, busy.c_str (), busy.size () + 1);
+      s->Close ();
+      return;
+    }
+  MftpTraceWriter::Record (MFTP_EV_ACCEPT, GetNode ()->GetId (), 0, 0, 0);
+  GetConnection (s).peer = from;
   s->SetRecvCallback (MakeCallback (&PacketSink::HandleRead, this));
+  s->SetDataSentCallback (MakeCallback (&PacketSink::HandleDataSent, this));
+  s->SetSendCallback (MakeCallback (&PacketSink::HandleSend, this));
+  s->SetCloseCallbacks (
+    MakeCallback (&PacketSink::HandlePeerClose, this),
+    MakeCallback (&PacketSink::HandlePeerError, this));
   m_socketList.push_back (s);
+  m_peakConnections = std::max<uint32_t> (m_peakConnections, m_socketList.size ());
 }
 
 } // Namespace ns3
@@ -21,12 +21,23 @@
 #ifndef PACKET_SINK_H
 #define PACKET_SINK_H
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 #include "ns3/data-rate.h"
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
+#include "ns3/nstime.h"
 #include "ns3/address.h"
+#include "mftp_scheduler.h"
+#include "mftp_chunk_store.h"
+#include "mftp_prefetch.h"
+#include "mftp_command.h"
+#include "mftp_work_pool.h"
 
 namespace ns3 {
 
@@ -57,13 +68,152 @@ public:
   Ptr<Socket> GetListeningSocket (void) const;
 
   /**
-   * \return list of pointers to accepted sockets
+   * \return the accepted sockets that are still open
    */
-  std::list<Ptr<Socket> > GetAcceptedSockets (void) const;
+  const std::vector<Ptr<Socket> > &GetAcceptedSockets (void) const;
+
+  /**
+   * \return the largest number of connections open at once
+   */
+  uint32_t GetPeakConnections (void) const;
+
+  /**
+   * \return bytes of per-connection application state, not counting
+   * buffered data or the socket itself
+   */
+  static uint32_t GetConnectionFootprint (void);
+
+  /**
+   * \return the number of replies currently being transmitted
+   */
+  uint32_t GetActiveTransfers (void) const;
+
+  /**
+   * \return the number of requests waiting for a transfer slot
+   */
+  uint32_t GetQueueDepth (void) const;
+
+  /**
+   * \return the total reply bytes reported sent by this sink app
+   */
+  uint64_t GetTotalTx (void) const;
+
+  /**
+   * \return the number of writes reply bytes took
+   */
+  uint64_t GetWriteCount (void) const;
+
+  /**
+   * \return the number of commands answered
+   */
+  uint64_t GetRequestCount (void) const;
+
+  /**
+   * \return the thread CPU time spent handling commands, zero unless
+   * the MeasureCpu attribute is set
+   */
+  Time GetRequestCpuTime (void) const;
+
+  /**
+   * \brief Add or replace a file served by GET
+   * \param name the file name clients ask for
+   * \param content the file body
+   */
+  void AddFile (std::string name, std::string content);
+
+  /**
+   * \return bytes of distinct chunks in the file store
+   */
+  uint64_t GetStoredBytes (void) const;
+
+  /**
+   * \return bytes of all files served, as if each were stored whole
+   */
+  uint64_t GetFileBytes (void) const;
+
+  /**
+   * \return reply cache, prefetch and push counters
+   */
+  const MftpPrefetcher::Stats &GetPrefetchStats (void) const;
+
+  /**
+   * \return worker pool counters, all zero without workers
+   */
+  MftpWorkPool::Stats GetWorkStats (void) const;
+
+  /**
+   * \brief Write the file store and counters, for MftpCheckpoint
+   * \param os the stream to write to
+   */
+  void SaveState (std::ostream &os) const;
+
+  /**
+   * \brief Restore what SaveState wrote and start no earlier than the
+   * checkpoint.  Connections are not restored: clients reconnect.
+   * \param is the stream to read from
+   * \param at the time the checkpoint was taken
+   * \return false on a malformed stream
+   */
+  bool LoadState (std::istream &is, Time at);
  
 protected:
   virtual void DoDispose (void);
 private:
+  /// A reply being written to a connection.
+  struct Transfer
+  {
+    std::string data;     //!< Reply bytes, including the trailing NUL
+    std::string push;     //!< File pushed unasked, empty for a reply
+    uint32_t    written;  //!< Bytes already handed to the socket
+    uint32_t    stream;   //!< Multiplexed stream, 0 to send unframed
+    uint32_t    credit;   //!< Bytes the client will still accept
+    MftpTransferScheduler::Class cls; //!< Request class
+    bool        admitted; //!< Holds one of the MaxActiveTransfers slots
+  };
+
+  /// A reply fully handed to the socket but not yet sent.
+  struct Completion
+  {
+    uint64_t end;      //!< Connection byte offset just past the reply
+    uint32_t size;     //!< Reply size, including the trailing NUL
+    uint16_t status;   //!< Reply status code
+    bool     admitted; //!< Holds one of the MaxActiveTransfers slots
+  };
+
+  /// A command answered once the work ahead of it is done.
+  struct Deferred
+  {
+    std::string request; //!< The command, as received
+    std::shared_ptr<MftpWorkPool::Job> job; //!< Reply computed by a worker, null if none
+    bool        due;     //!< The job's completion event has run
+  };
+
+  /// Per-connection state, created on accept or on the first request.
+  struct Connection
+  {
+    // short, so vectors are cheaper than deques here
+    std::vector<Transfer>   transfers;   //!< Replies not yet fully written
+    std::vector<Deferred>   deferred;    //!< Commands waiting for workers, in order
+    std::vector<Completion> completions; //!< Written replies not yet sent
+    std::string rxBuffer; //!< Partial command
+    std::string lastFile; //!< File asked for last, for the successor table
+    std::map<std::string, uint32_t> pushed; //!< Pushed files not yet used, and their sizes
+    Address  peer;    //!< Client address, for the swarm tracker
+    Time     srtt;    //!< Smoothed round trip time, zero until measured
+    Time     probeSent; //!< When the probed byte was sent
+    double   rate;    //!< Delivery rate in bytes per second, 0 until measured
+    uint64_t written; //!< Bytes handed to the socket
+    uint64_t sent;    //!< Bytes the socket reported sent
+    uint64_t probeEnd; //!< Offset just past the probed byte, 0 for no probe
+    uint64_t probeAcked; //!< Bytes acknowledged when the probe was sent
+    uint32_t bufferSize; //!< Send buffer size, seen when it was empty
+    uint32_t window;  //!< Initial credit of each new stream
+    uint32_t nextPush; //!< Stream of the next push
+    bool     blocked; //!< Waiting for send buffer space
+    bool     scheduled; //!< Queued in the transfer scheduler
+    bool     probeBusy; //!< Data waited in the socket when the probe was sent
+  };
+
   // inherited from Application base class.
   virtual void StartApplication (void);    // Called at time specified by Start
   virtual void StopApplication (void);     // Called at time specified by Stop
@@ -89,24 +239,267 @@ private:
    * \param socket the connected socket
    */
   void HandlePeerError (Ptr<Socket> socket);
+  /**
+   * \brief Account for reply bytes handed to the network
+   * \param socket the connected socket
+   * \param bytes the number of bytes sent
+   */
+  void HandleDataSent (Ptr<Socket> socket, uint32_t bytes);
+
+  /**
+   * \brief Build the reply to a single command
+   * \param socket the connected socket
+   * \param command the parsed command
+   * \return the reply payload
+   */
+  std::string BuildReply (Ptr<Socket> socket, const MftpCommand &command);
+  /**
+   * \brief Build the reply to a GET from the file store
+   * \param name the file name
+   * \param reply set to the reply
+   * \return false if there is no such file
+   */
+  bool RenderFile (const std::string &name, std::string &reply) const;
+  /**
+   * \brief Learn from a file request and act on the prediction it gives:
+   * warm the reply cache and, if allowed, push the file to the client
+   * \param socket the connected socket
+   * \param file the file asked for, or used from a push
+   * \param stream the stream of the request, 0 if not multiplexed
+   */
+  void Prefetch (Ptr<Socket> socket, const std::string &file, uint32_t stream);
+  /**
+   * \brief Answer a swarm command
+   * \param socket the connected socket
+   * \param command the parsed MANIFEST, CHUNK or HAVE
+   * \return the reply
+   */
+  std::string BuildSwarmReply (Ptr<Socket> socket, const MftpCommand &command);
+  /**
+   * \brief Answer DELTA with the chunks the client does not list
+   * \param command the parsed DELTA
+   * \return the reply
+   */
+  std::string BuildDeltaReply (const MftpCommand &command) const;
+  /**
+   * \brief Worker task: RenderFile
+   * \param name the file name
+   * \return the reply, empty if there is no such file
+   */
+  std::string RenderJob (std::string name) const;
+  /**
+   * \brief Worker task: BuildDeltaReply
+   * \param args the arguments of the DELTA
+   * \return the reply
+   */
+  std::string DeltaJob (std::string args) const;
+  /**
+   * \brief Hand a command's reply computation to the workers, or queue
+   * the command behind commands that were
+   * \param socket the connected socket
+   * \param s the command, as received
+   * \param command s parsed
+   * \return false if the command is to be answered now
+   */
+  bool Defer (Ptr<Socket> socket, const std::string &s, const MftpCommand &command);
+  /**
+   * \brief The oldest outstanding job of a connection is due: answer
+   * every command up to the next job still outstanding
+   * \param socket the connected socket
+   */
+  void CompleteWork (Ptr<Socket> socket);
+  /**
+   * \brief Wait for every outstanding job, before the file store changes
+   */
+  void WaitForWork (void);
+  /**
+   * \param bytes mean chunk size of the file store
+   */
+  void SetDedupChunkSize (uint32_t bytes);
+  /**
+   * \return mean chunk size of the file store
+   */
+  uint32_t GetDedupChunkSize (void) const;
+  /**
+   * \param bytes capacity of the reply cache
+   */
+  void SetReplyCacheSize (uint32_t bytes);
+  /**
+   * \return capacity of the reply cache
+   */
+  uint32_t GetReplyCacheSize (void) const;
+  /**
+   * \brief Admit, queue or reject a parsed command
+   * \param socket the connected socket
+   * \param s the command, including its "\n\n" terminator and any
+   * stream prefix
+   */
+  void HandleRequest (Ptr<Socket> socket, std::string s);
+  /**
+   * \brief Admit, queue or reject the reply to a command
+   * \param socket the connected socket
+   * \param s the command, as received
+   * \param stream the stream of the command, 0 if not multiplexed
+   * \param command s parsed
+   * \param outgoing the reply
+   */
+  void Respond (Ptr<Socket> socket, const std::string &s, uint32_t stream,
+                const MftpCommand &command, const std::string &outgoing);
+  /**
+   * \brief Add flow-control credit to a stream, or set the initial
+   * credit of new streams
+   * \param socket the connected socket
+   * \param command the parsed CREDIT
+   */
+  void HandleCredit (Ptr<Socket> socket, const MftpCommand &command);
+  /**
+   * \brief Handle free space in a connection's send buffer
+   * \param socket the connected socket
+   * \param available the bytes of free space
+   */
+  void HandleSend (Ptr<Socket> socket, uint32_t available);
+  /**
+   * \brief Close the round trip probe once the probed byte is
+   * acknowledged, sampling the round trip time and delivery rate
+   * \param connection the connection
+   * \param available free bytes in its send buffer
+   */
+  void MeasurePath (Connection &connection, uint32_t available);
+  /**
+   * \param connection the connection
+   * \return bytes to write to it at a time
+   */
+  uint32_t GetWriteSize (const Connection &connection) const;
+
+  /**
+   * \brief Work out the request class of a reply
+   * \param reply the reply payload
+   * \return the class the reply is scheduled in
+   */
+  MftpTransferScheduler::Class Classify (const std::string &reply) const;
+  /**
+   * \brief Start a reply that holds a transfer slot
+   * \param socket the connected socket
+   * \param reply the reply payload
+   * \param stream the multiplexed stream, 0 for none
+   */
+  void StartTransfer (Ptr<Socket> socket, const std::string &reply, uint32_t stream);
+  /**
+   * \brief Queue a reply on a connection's send path
+   * \param socket the connected socket
+   * \param reply the reply payload
+   * \param admitted whether the reply holds a transfer slot
+   * \param stream the multiplexed stream, 0 for none
+   */
+  void QueueTransfer (Ptr<Socket> socket, const std::string &reply, bool admitted,
+                      uint32_t stream);
+  /**
+   * \brief Pick the reply a connection writes next.
+   *
+   * Unframed replies go out whole and in order.  Among multiplexed
+   * streams with credit left, the most urgent class goes first, and
+   * streams of one class take turns a frame at a time.
+   *
+   * \param connection the connection
+   * \return index into its transfers, or -1 if none may be written
+   */
+  int NextTransfer (const Connection &connection) const;
+  /**
+   * \brief Queue a connection in the transfer scheduler if it has a reply
+   * it may write
+   * \param socket the connected socket
+   * \param connection its state
+   */
+  void Schedule (Ptr<Socket> socket, Connection &connection);
+  /**
+   * \brief Write replies and bulk chunks while the send budget allows
+   */
+  void Pump (void);
+  /**
+   * \brief Start queued transfers while slots are free
+   */
+  void ServePending (void);
+  /**
+   * \return true if another transfer may start now
+   */
+  bool CanStartTransfer (void) const;
+  /**
+   * \brief Find or create the state of a connection
+   * \param socket the connected socket
+   * \return the connection state
+   */
+  Connection &GetConnection (Ptr<Socket> socket);
+  /**
+   * \brief Forget all state held for a connection
+   * \param socket the connected socket
+   */
+  void ReleaseConnection (Ptr<Socket> socket);
 
 //  void ScheduleTx(Ptr<Socket> socket, const char *payload, uint32_t payload_length);
   void SendPacket(Ptr<Socket> socket, const char *payload, uint32_t payload_length);
   // In the case of TCP, each socket accept returns a new socket, so the 
   // listening socket is stored separately from the accepted sockets
-  uint32_t        m_packetSize;
+  uint32_t        m_packetSize;   //!< Bytes per write, or before any measurement
   DataRate        m_dataRate;
   EventId         m_sendEvent;
   bool            m_running;
   Ptr<Socket>     m_socket;       //!< Listening socket
-  std::list<Ptr<Socket> > m_socketList; //!< the accepted sockets
+  std::vector<Ptr<Socket> > m_socketList; //!< the accepted sockets
+  uint32_t        m_peakConnections; //!< Most accepted sockets open at once
 
   Address         m_local;        //!< Local address to bind to
   uint64_t        m_totalRx;      //!< Total bytes received
+  uint64_t        m_totalTx;      //!< Total reply bytes sent
+  uint64_t        m_requests;     //!< Commands handled
+  uint64_t        m_writes;       //!< Writes of reply bytes
+  bool            m_adaptiveWrites; //!< Size writes from the measured path
+  Time            m_writeLatency; //!< Longest a write should take to drain
+  uint32_t        m_minWriteSize; //!< Smallest adaptive write
+  uint32_t        m_maxWriteSize; //!< Largest adaptive write
+  bool            m_measureCpu;   //!< Time command handling on the CPU
+  int64_t         m_requestCpuNs; //!< CPU time spent handling commands
   TypeId          m_tid;          //!< Protocol TypeId
+  std::string     m_tcpVariant;   //!< TCP congestion control, empty for default
+  uint32_t        m_sndBufSize;   //!< TCP send buffer, 0 for default
+  uint32_t        m_rcvBufSize;   //!< TCP receive buffer, 0 for default
+
+  uint32_t        m_maxConnections;     //!< Accepted connection limit, 0 for none
+  uint32_t        m_maxActiveTransfers; //!< Concurrent transfer limit, 0 for none
+  uint32_t        m_maxPending;         //!< Pending request queue limit
+  uint32_t        m_quantum;            //!< DRR quantum, in bytes
+  uint32_t        m_activeTransfers;    //!< Replies currently being transmitted
+  uint32_t        m_smallFileThreshold; //!< Largest interactive body, in bytes
+  uint32_t        m_controlWeight;      //!< Picks per round for control replies
+  uint32_t        m_interactiveWeight;  //!< Picks per round for small files
+  uint32_t        m_bulkWeight;         //!< Picks per round for bulk chunks
+  uint32_t        m_txBudget;           //!< Unsent bytes allowed over all sockets
+  uint32_t        m_txBudgetUsed;       //!< Bytes written but not yet sent
+  uint32_t        m_streamWindow;       //!< Default initial credit per stream
+  bool            m_prefetch;           //!< Learn successors and warm the cache
+  bool            m_prefetchPerClient;  //!< One successor table per client address
+  bool            m_push;               //!< Push predicted files to multiplexing clients
+  double          m_prefetchThreshold;  //!< Least confidence acted on
+  DataRate        m_pushRate;           //!< Cap on pushed bytes over all connections
+  Time            m_pushAllowedAt;      //!< Earliest next push under the cap
+  MftpPrefetcher  m_prefetcher;         //!< Successor tables and reply cache
+  MftpWorkPool   *m_pool;               //!< Workers building replies, null for none
+  uint32_t        m_workers;            //!< Worker threads started with the app
+  Time            m_workDelay;          //!< Simulated time an offloaded reply takes
+  MftpRequestScheduler m_scheduler;     //!< Requests waiting for a transfer slot
+  MftpTransferScheduler m_pump;         //!< Connections ready to write
+  std::map<Ptr<Socket>, Connection> m_connections; //!< Per-connection send state
+  MftpChunkStore  m_store;              //!< Files served by GET, deduplicated
+  uint32_t        m_chunkSize;          //!< Swarm chunk size, in bytes
+  uint32_t        m_manifestPeers;      //!< Holders listed per chunk
+  /// Swarm tracker: per file and chunk, the clients serving it, oldest first
+  std::map<std::string, std::vector<std::vector<Address> > > m_holders;
 
   /// Traced Callback: received packets, source address.
   TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
+  /// Number of requests waiting for a transfer slot.
+  TracedValue<uint32_t> m_queueDepth;
+  /// Queueing delay of the most recently started transfer.
+  TracedValue<Time> m_queueWait;
 
 };
 
@@ -0,0 +1,76 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_socket.h"
+#include "ns3/log.h"
+#include "ns3/tcp-l4-protocol.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MftpSocket");
+
+namespace {
+
+void
+ApplyBuffers (Ptr<Socket> socket, uint32_t sndBufSize, uint32_t rcvBufSize)
+{
+  // not every socket type has both buffers
+  if (sndBufSize > 0)
+    {
+      socket->SetAttributeFailSafe ("SndBufSize", UintegerValue (sndBufSize));
+    }
+  if (rcvBufSize > 0)
+    {
+      socket->SetAttributeFailSafe ("RcvBufSize", UintegerValue (rcvBufSize));
+    }
+}
+
+} // anonymous namespace
+
+Ptr<Socket>
+MftpCreateSocket (Ptr<Node> node, TypeId tid, std::string tcpVariant,
+                  uint32_t sndBufSize, uint32_t rcvBufSize)
+{
+  if (tid != TcpSocketFactory::GetTypeId ())
+    {
+      Ptr<Socket> socket = Socket::CreateSocket (node, tid);
+      ApplyBuffers (socket, sndBufSize, rcvBufSize);
+      return socket;
+    }
+
+  Ptr<Socket> socket;
+  if (tcpVariant.empty ())
+    {
+      socket = Socket::CreateSocket (node, tid);
+    }
+  else
+    {
+      TypeId variant;
+      if (!TypeId::LookupByNameFailSafe (tcpVariant, &variant))
+        {
+          NS_FATAL_ERROR ("Unknown TCP variant " << tcpVariant);
+        }
+      socket = node->GetObject<TcpL4Protocol> ()->CreateSocket (variant);
+    }
+  ApplyBuffers (socket, sndBufSize, rcvBufSize);
+  NS_LOG_LOGIC ("Socket on node " << node->GetId () << " variant '" << tcpVariant
+                << "' buffers " << sndBufSize << "/" << rcvBufSize);
+  return socket;
+}
+
+} // namespace ns3
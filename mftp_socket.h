@@ -0,0 +1,50 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_SOCKET_H
+#define MFTP_SOCKET_H
+
+#include <string>
+#include "ns3/node.h"
+#include "ns3/ptr.h"
+#include "ns3/socket.h"
+#include "ns3/type-id.h"
+
+namespace ns3 {
+
+/**
+ * \brief Create an application socket with per-application TCP tuning.
+ *
+ * For TcpSocketFactory sockets the congestion control algorithm and the
+ * buffer sizes can be chosen per socket instead of through the node-wide
+ * TcpL4Protocol::SocketType and TcpSocket defaults.  Sockets accepted
+ * from a listening socket inherit its settings.  Other protocols ignore
+ * the variant; the buffer sizes are applied where the socket type has
+ * such attributes.
+ *
+ * \param node the node to create the socket on
+ * \param tid the socket factory TypeId
+ * \param tcpVariant TcpCongestionOps type name, e.g. "ns3::TcpWestwood";
+ * empty for the node default
+ * \param sndBufSize send buffer size in bytes, 0 for the default
+ * \param rcvBufSize receive buffer size in bytes, 0 for the default
+ * \return the new socket
+ */
+Ptr<Socket> MftpCreateSocket (Ptr<Node> node, TypeId tid, std::string tcpVariant,
+                              uint32_t sndBufSize, uint32_t rcvBufSize);
+
+} // namespace ns3
+
+#endif /* MFTP_SOCKET_H */
@@ -0,0 +1,77 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_swarm.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include <sstream>
+
+namespace ns3 {
+
+std::string
+MftpFormatPeer (const Address &peer)
+{
+  std::ostringstream out;
+  if (InetSocketAddress::IsMatchingType (peer))
+    {
+      InetSocketAddress inet = InetSocketAddress::ConvertFrom (peer);
+      out << inet.GetIpv4 () << " " << inet.GetPort ();
+    }
+  else
+    {
+      Inet6SocketAddress inet6 = Inet6SocketAddress::ConvertFrom (peer);
+      out << inet6.GetIpv6 () << " " << inet6.GetPort ();
+    }
+  return out.str ();
+}
+
+bool
+MftpParsePeer (std::istream &in, Address &peer)
+{
+  std::string host;
+  uint32_t port;
+  if (!(in >> host >> port) || port > 0xffff)
+    {
+      return false;
+    }
+  if (host.find (':') != std::string::npos)
+    {
+      peer = Inet6SocketAddress (Ipv6Address (host.c_str ()), port);
+    }
+  else
+    {
+      peer = InetSocketAddress (Ipv4Address (host.c_str ()), port);
+    }
+  return true;
+}
+
+bool
+MftpSameHost (const Address &a, const Address &b)
+{
+  if (InetSocketAddress::IsMatchingType (a) && InetSocketAddress::IsMatchingType (b))
+    {
+      return InetSocketAddress::ConvertFrom (a).GetIpv4 ()
+             == InetSocketAddress::ConvertFrom (b).GetIpv4 ();
+    }
+  if (Inet6SocketAddress::IsMatchingType (a) && Inet6SocketAddress::IsMatchingType (b))
+    {
+      return Inet6SocketAddress::ConvertFrom (a).GetIpv6 ()
+             == Inet6SocketAddress::ConvertFrom (b).GetIpv6 ();
+    }
+  return false;
+}
+
+} // namespace ns3
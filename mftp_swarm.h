@@ -0,0 +1,61 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_SWARM_H
+#define MFTP_SWARM_H
+
+#include <iostream>
+#include <string>
+#include "ns3/address.h"
+
+/*
+ * Swarm mode extends MiniFTP with three commands, answered by PacketSink
+ * acting as tracker:
+ *
+ *   MANIFEST <file>            200 OK with "<size> <chunkSize> <chunks>\n"
+ *                              then one "<chunk> <peer>...\n" line for
+ *                              every chunk some client holds
+ *   CHUNK <file> <chunk>       200 OK with the chunk body
+ *   HAVE <file> <chunk> <port> 250 Noted; the sender now serves the
+ *                              chunk on that port
+ *
+ * Clients serve CHUNK to each other the same way.  A peer is written as
+ * "<address> <port>".
+ */
+
+namespace ns3 {
+
+/**
+ * \param peer an InetSocketAddress or Inet6SocketAddress
+ * \return the peer as written in a manifest
+ */
+std::string MftpFormatPeer (const Address &peer);
+
+/**
+ * \brief Read one peer written by MftpFormatPeer.
+ * \param in the stream to read from
+ * \param peer set to the peer
+ * \return false at the end of the stream or on a malformed peer
+ */
+bool MftpParsePeer (std::istream &in, Address &peer);
+
+/**
+ * \return true if both socket addresses have the same IP address
+ */
+bool MftpSameHost (const Address &a, const Address &b);
+
+} // namespace ns3
+
+#endif /* MFTP_SWARM_H */
@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_timer_wheel.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+MftpTimerWheel::MftpTimerWheel (Time tick, uint32_t slots)
+  : m_slots (slots),
+    m_tick (tick),
+    m_current (0),
+    m_size (0),
+    m_ticking (false)
+{
+  NS_ASSERT (tick.IsStrictlyPositive () && slots > 0);
+}
+
+void
+MftpTimerWheel::Schedule (Time delay, ExpireCallback expire, uint64_t cookie)
+{
+  int64_t tick = m_tick.GetTimeStep ();
+  if (m_size == 0 && !m_ticking)
+    {
+      // the wheel was idle: restart it at the current tick
+      m_current = Simulator::Now ().GetTimeStep () / tick;
+      Time next = TimeStep ((m_current + 1) * tick) - Simulator::Now ();
+      m_event = Simulator::Schedule (next, &MftpTimerWheel::Tick, Ptr<MftpTimerWheel> (this));
+    }
+
+  // round up so that a timer never fires early
+  uint64_t due = (Simulator::Now () + delay).GetTimeStep ();
+  due = (due + tick - 1) / tick;
+  if (due <= m_current)
+    {
+      due = m_current + 1;
+    }
+
+  Timer timer;
+  timer.expire = expire;
+  timer.cookie = cookie;
+  timer.due = due;
+  m_slots[due % m_slots.size ()].push_back (timer);
+  m_size++;
+}
+
+uint32_t
+MftpTimerWheel::GetSize (void) const
+{
+  return m_size;
+}
+
+void
+MftpTimerWheel::Tick (void)
+{
+  m_current++;
+  m_ticking = true;
+
+  // expiry handlers may arm new timers, possibly in this very slot, so
+  // work on a detached copy of it
+  std::vector<Timer> slot;
+  slot.swap (m_slots[m_current % m_slots.size ()]);
+  std::vector<Timer> &keep = m_slots[m_current % m_slots.size ()];
+  for (std::vector<Timer>::iterator i = slot.begin (); i != slot.end (); ++i)
+    {
+      if (i->due > m_current)
+        {
+          // due in a later turn
+          keep.push_back (*i);
+          continue;
+        }
+      m_size--;
+      i->expire (i->cookie);
+    }
+  m_ticking = false;
+
+  if (m_size > 0)
+    {
+      m_event = Simulator::Schedule (m_tick, &MftpTimerWheel::Tick, Ptr<MftpTimerWheel> (this));
+    }
+}
+
+} // namespace ns3
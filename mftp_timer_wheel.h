@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_TIMER_WHEEL_H
+#define MFTP_TIMER_WHEEL_H
+
+#include <vector>
+#include "ns3/callback.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/simple-ref-count.h"
+
+namespace ns3 {
+
+/**
+ * \brief Hashed timing wheel for request timeouts.
+ *
+ * Timers are bucketed into slots of one tick each.  The wheel runs a
+ * single simulator event per tick while any timer is armed, however many
+ * timers there are, and arming a timer is a push onto a slot.  Timers
+ * fire up to one tick late.
+ *
+ * Timers cannot be cancelled.  Owners pass a cookie that identifies what
+ * the timer guards and ignore expiries that no longer apply, which keeps
+ * arming and completing a request free of any search.
+ */
+class MftpTimerWheel : public SimpleRefCount<MftpTimerWheel>
+{
+public:
+  /// Called with the cookie of an expired timer.
+  typedef Callback<void, uint64_t> ExpireCallback;
+
+  /**
+   * \param tick resolution of the wheel
+   * \param slots number of slots; timers further out than one turn
+   * stay in their slot for several turns
+   */
+  MftpTimerWheel (Time tick, uint32_t slots);
+
+  /**
+   * \brief Arm a timer.
+   * \param delay time until expiry
+   * \param expire the function to call on expiry
+   * \param cookie passed back to expire
+   */
+  void Schedule (Time delay, ExpireCallback expire, uint64_t cookie);
+
+  /**
+   * \return the number of armed timers, including stale ones
+   */
+  uint32_t GetSize (void) const;
+
+private:
+  /**
+   * \brief Advance one tick and fire the timers due in it.
+   */
+  void Tick (void);
+
+  /// An armed timer.
+  struct Timer
+  {
+    ExpireCallback expire; //!< Expiry function
+    uint64_t       cookie; //!< Passed to expire
+    uint64_t       due;    //!< Tick at which the timer fires
+  };
+
+  std::vector<std::vector<Timer> > m_slots; //!< One bucket per tick
+  Time     m_tick;    //!< Tick length
+  uint64_t m_current; //!< Number of the last tick processed
+  uint32_t m_size;    //!< Armed timers
+  EventId  m_event;   //!< Next tick, while timers are armed
+  bool     m_ticking; //!< Inside Tick, which reschedules itself
+};
+
+} // namespace ns3
+
+#endif /* MFTP_TIMER_WHEEL_H */
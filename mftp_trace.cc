@@ -0,0 +1,148 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_trace.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MftpTrace");
+
+int      MftpTraceWriter::m_fd = -1;
+char    *MftpTraceWriter::m_window = 0;
+uint64_t MftpTraceWriter::m_windowStart = 0;
+uint32_t MftpTraceWriter::m_windowSize = 0;
+uint32_t MftpTraceWriter::m_windowUsed = 0;
+
+void
+MftpTraceWriter::Enable (std::string filename, uint32_t windowBytes)
+{
+  Disable ();
+
+  m_fd = open (filename.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (m_fd < 0)
+    {
+      NS_FATAL_ERROR ("Cannot open trace file " << filename);
+    }
+
+  uint32_t page = sysconf (_SC_PAGESIZE);
+  m_windowSize = ((windowBytes + page - 1) / page) * page;
+  m_windowStart = 0;
+  MapWindow ();
+
+  MftpTraceFileHeader header;
+  std::memcpy (header.magic, MFTP_TRACE_MAGIC, sizeof (header.magic));
+  header.version = MFTP_TRACE_VERSION;
+  header.recordSize = sizeof (MftpTraceRecord);
+  std::memcpy (m_window, &header, sizeof (header));
+  m_windowUsed = sizeof (header);
+}
+
+void
+MftpTraceWriter::Disable (void)
+{
+  if (m_fd < 0)
+    {
+      return;
+    }
+  uint64_t length = m_windowStart + m_windowUsed;
+  UnmapWindow ();
+  if (ftruncate (m_fd, length) != 0)
+    {
+      NS_LOG_WARN ("Cannot trim trace file");
+    }
+  close (m_fd);
+  m_fd = -1;
+}
+
+bool
+MftpTraceWriter::IsEnabled (void)
+{
+  return m_fd >= 0;
+}
+
+void
+MftpTraceWriter::Record (uint8_t event, uint32_t node, uint32_t request,
+                         uint16_t status, uint32_t bytes)
+{
+  if (m_fd < 0)
+    {
+      return;
+    }
+
+  MftpTraceRecord record;
+  record.time = Simulator::Now ().GetNanoSeconds ();
+  record.node = node;
+  record.bytes = bytes;
+  record.request = request;
+  record.status = status;
+  record.event = event;
+  record.reserved = 0;
+
+  // windows are page sized, so a record may straddle two of them
+  const char *data = (const char *) &record;
+  uint32_t left = sizeof (record);
+  while (left > 0)
+    {
+      if (m_windowUsed == m_windowSize)
+        {
+          UnmapWindow ();
+          m_windowStart += m_windowSize;
+          MapWindow ();
+        }
+      uint32_t n = std::min (left, m_windowSize - m_windowUsed);
+      std::memcpy (m_window + m_windowUsed, data, n);
+      m_windowUsed += n;
+      data += n;
+      left -= n;
+    }
+}
+
+void
+MftpTraceWriter::MapWindow (void)
+{
+  if (ftruncate (m_fd, m_windowStart + m_windowSize) != 0)
+    {
+      NS_FATAL_ERROR ("Cannot grow trace file");
+    }
+  void *window = mmap (0, m_windowSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       m_fd, m_windowStart);
+  if (window == MAP_FAILED)
+    {
+      NS_FATAL_ERROR ("Cannot map trace file");
+    }
+  m_window = (char *) window;
+  m_windowUsed = 0;
+}
+
+void
+MftpTraceWriter::UnmapWindow (void)
+{
+  if (m_window)
+    {
+      // the kernel writes the pages back on its own schedule
+      munmap (m_window, m_windowSize);
+      m_window = 0;
+    }
+}
+
+} // namespace ns3
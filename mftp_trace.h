@@ -0,0 +1,81 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_TRACE_H
+#define MFTP_TRACE_H
+
+#include <string>
+#include "mftp_trace_format.h"
+
+namespace ns3 {
+
+/**
+ * \brief Append-only binary event log shared by every MiniFTP application.
+ *
+ * Records are written straight into a memory-mapped window of the log
+ * file.  When the window fills, the file is grown and the next window is
+ * mapped, so one run costs one open file and no per-event system call
+ * regardless of the number of nodes.  Use tools/mftp_trace_reader.cc to
+ * turn a log into statistics.
+ */
+class MftpTraceWriter
+{
+public:
+  /**
+   * \brief Start logging to a file, replacing any previous contents.
+   * \param filename the log file
+   * \param windowBytes size of each mapped window, rounded to whole pages
+   */
+  static void Enable (std::string filename, uint32_t windowBytes = 1 << 20);
+  /**
+   * \brief Unmap the last window, trim the file and stop logging.
+   */
+  static void Disable (void);
+  /**
+   * \return true if events are being logged
+   */
+  static bool IsEnabled (void);
+
+  /**
+   * \brief Log an event at the current simulation time.
+   * \param event the MftpTraceEvent
+   * \param node id of the node the event happened on
+   * \param request per-client request sequence number
+   * \param status reply status code, 0 if not applicable
+   * \param bytes payload bytes involved
+   */
+  static void Record (uint8_t event, uint32_t node, uint32_t request,
+                      uint16_t status, uint32_t bytes);
+
+private:
+  /**
+   * \brief Map the window starting at the current end of the log.
+   */
+  static void MapWindow (void);
+  /**
+   * \brief Unmap the current window.
+   */
+  static void UnmapWindow (void);
+
+  static int      m_fd;          //!< Log file descriptor, -1 when disabled
+  static char    *m_window;      //!< Current mapped window
+  static uint64_t m_windowStart; //!< File offset of the window
+  static uint32_t m_windowSize;  //!< Bytes in each window
+  static uint32_t m_windowUsed;  //!< Bytes written into the window
+};
+
+} // namespace ns3
+
+#endif /* MFTP_TRACE_H */
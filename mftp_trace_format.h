@@ -0,0 +1,64 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_TRACE_FORMAT_H
+#define MFTP_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * On-disk layout of the MiniFTP binary event log.  This header has no
+ * ns-3 dependency so that the offline tools in tools/ can share it.
+ *
+ * A log is one MftpTraceFileHeader followed by fixed-size
+ * MftpTraceRecords in the order they were written, in host byte order.
+ */
+
+#define MFTP_TRACE_MAGIC "MFTPTRC1"
+#define MFTP_TRACE_VERSION 1
+
+/// Event types recorded in the log.
+enum MftpTraceEvent
+{
+  MFTP_EV_REQUEST_START = 1, //!< Client sent a command
+  MFTP_EV_REQUEST_END = 2,   //!< Client received the complete reply
+  MFTP_EV_SERVER_REQUEST = 3,//!< Server parsed a command
+  MFTP_EV_SERVER_REPLY = 4,  //!< Server finished sending a reply
+  MFTP_EV_ACCEPT = 5,        //!< Server accepted a connection
+  MFTP_EV_REJECT = 6,        //!< Server turned a connection or request away
+  MFTP_EV_CLOSE = 7          //!< Connection closed or failed
+};
+
+/// File header, written once at offset 0.
+struct MftpTraceFileHeader
+{
+  char     magic[8];    //!< MFTP_TRACE_MAGIC, not NUL terminated
+  uint32_t version;     //!< MFTP_TRACE_VERSION
+  uint32_t recordSize;  //!< sizeof (MftpTraceRecord)
+};
+
+/// One event.
+struct MftpTraceRecord
+{
+  int64_t  time;        //!< Simulation time, in nanoseconds
+  uint32_t node;        //!< Node id of the application that logged it
+  uint32_t bytes;       //!< Payload bytes involved, if any
+  uint32_t request;     //!< Per-client request sequence number
+  uint16_t status;      //!< Reply status code, 0 if not applicable
+  uint8_t  event;       //!< MftpTraceEvent
+  uint8_t  reserved;    //!< Zero
+};
+
+#endif /* MFTP_TRACE_FORMAT_H */
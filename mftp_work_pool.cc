@@ -0,0 +1,179 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "mftp_work_pool.h"
+
+namespace ns3 {
+
+MftpWorkPool::Job::Job (const Task &task)
+  : m_task (task),
+    m_taken (false),
+    m_done (false)
+{
+}
+
+MftpWorkPool::MftpWorkPool (uint32_t threads)
+  : m_queued (0),
+    m_submitted (0),
+    m_stolen (0),
+    m_inlined (0),
+    m_next (0),
+    m_stopping (false)
+{
+  for (uint32_t i = 0; i < (threads > 0 ? threads : 1); i++)
+    {
+      m_queues.push_back (std::unique_ptr<Queue> (new Queue));
+    }
+  for (uint32_t i = 0; i < threads; i++)
+    {
+      m_threads.push_back (std::thread (&MftpWorkPool::Work, this, i));
+    }
+}
+
+MftpWorkPool::~MftpWorkPool ()
+{
+  {
+    std::lock_guard<std::mutex> lock (m_idleMutex);
+    m_stopping = true;
+  }
+  m_idle.notify_all ();
+  for (uint32_t i = 0; i < m_threads.size (); i++)
+    {
+      m_threads[i].join ();
+    }
+}
+
+std::shared_ptr<MftpWorkPool::Job>
+MftpWorkPool::Submit (const Task &task)
+{
+  std::shared_ptr<Job> job = std::make_shared<Job> (task);
+  Queue &queue = *m_queues[m_next++ % m_queues.size ()];
+  {
+    std::lock_guard<std::mutex> lock (queue.mutex);
+    queue.jobs.push_back (job);
+  }
+  {
+    // under the lock, so a worker about to sleep sees the count or the wake-up
+    std::lock_guard<std::mutex> lock (m_idleMutex);
+    m_queued++;
+  }
+  m_idle.notify_one ();
+  m_submitted++;
+  return job;
+}
+
+const std::string &
+MftpWorkPool::Wait (const std::shared_ptr<Job> &job)
+{
+  // still queued: the entry left behind is dropped by whoever takes it
+  if (Run (*job))
+    {
+      m_inlined++;
+      return job->m_result;
+    }
+  std::unique_lock<std::mutex> lock (job->m_mutex);
+  while (!job->m_done)
+    {
+      job->m_ready.wait (lock);
+    }
+  return job->m_result;
+}
+
+uint32_t
+MftpWorkPool::GetThreads (void) const
+{
+  return m_threads.size ();
+}
+
+MftpWorkPool::Stats
+MftpWorkPool::GetStats (void) const
+{
+  Stats stats;
+  stats.submitted = m_submitted;
+  stats.stolen = m_stolen;
+  stats.inlined = m_inlined;
+  return stats;
+}
+
+void
+MftpWorkPool::Work (uint32_t self)
+{
+  for (;;)
+    {
+      std::shared_ptr<Job> job = Take (self);
+      if (job)
+        {
+          Run (*job);
+          continue;
+        }
+      std::unique_lock<std::mutex> lock (m_idleMutex);
+      while (!m_stopping && m_queued == 0)
+        {
+          m_idle.wait (lock);
+        }
+      if (m_stopping && m_queued == 0)
+        {
+          return;
+        }
+    }
+}
+
+std::shared_ptr<MftpWorkPool::Job>
+MftpWorkPool::Take (uint32_t self)
+{
+  for (uint32_t i = 0; i < m_queues.size (); i++)
+    {
+      Queue &queue = *m_queues[(self + i) % m_queues.size ()];
+      std::lock_guard<std::mutex> lock (queue.mutex);
+      if (queue.jobs.empty ())
+        {
+          continue;
+        }
+      std::shared_ptr<Job> job;
+      if (i == 0)
+        {
+          job = queue.jobs.front ();
+          queue.jobs.pop_front ();
+        }
+      else
+        {
+          job = queue.jobs.back ();
+          queue.jobs.pop_back ();
+          m_stolen++;
+        }
+      m_queued--;
+      return job;
+    }
+  return std::shared_ptr<Job> ();
+}
+
+bool
+MftpWorkPool::Run (Job &job)
+{
+  if (job.m_taken.exchange (true))
+    {
+      return false;
+    }
+  std::string result = job.m_task ();
+  std::lock_guard<std::mutex> lock (job.m_mutex);
+  job.m_result.swap (result);
+  job.m_task = Task ();
+  job.m_done = true;
+  job.m_ready.notify_all ();
+  return true;
+}
+
+} // namespace ns3
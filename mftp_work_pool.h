@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MFTP_WORK_POOL_H
+#define MFTP_WORK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \brief Work-stealing thread pool for the pure computations behind
+ * server replies.
+ *
+ * Submit hands a task to one worker's queue, round robin.  Workers take
+ * their own tasks oldest first and, when idle, steal the newest from the
+ * others.  Wait blocks until a task is done, running it on the calling
+ * thread if no worker has picked it up yet, so a pool always makes
+ * progress, even one without threads.
+ *
+ * Tasks must only read state the caller leaves alone until they are
+ * waited for.  The pool never touches the simulator: when a result is
+ * used is up to the caller, which keeps runs reproducible.
+ */
+class MftpWorkPool
+{
+public:
+  /// A computation that produces a reply.
+  typedef std::function<std::string (void)> Task;
+
+  /// A submitted task and, once done, its result.
+  class Job
+  {
+  public:
+    /**
+     * \param task the computation
+     */
+    explicit Job (const Task &task);
+
+  private:
+    friend class MftpWorkPool;
+    Task                    m_task;   //!< The computation
+    std::string             m_result; //!< What it returned
+    std::atomic<bool>       m_taken;  //!< Some thread started it
+    bool                    m_done;   //!< m_result is set
+    std::mutex              m_mutex;  //!< Guards m_done
+    std::condition_variable m_ready;  //!< Signalled when m_done is set
+  };
+
+  /**
+   * \param threads worker threads to start, 0 to run every task in Wait
+   */
+  explicit MftpWorkPool (uint32_t threads);
+  /**
+   * \brief Finish the queued tasks and join the workers
+   */
+  ~MftpWorkPool ();
+
+  /**
+   * \param task the computation
+   * \return the job to wait for
+   */
+  std::shared_ptr<Job> Submit (const Task &task);
+  /**
+   * \brief Block until a job is done
+   * \param job a job this pool returned
+   * \return its result, valid as long as the job is
+   */
+  const std::string &Wait (const std::shared_ptr<Job> &job);
+
+  /**
+   * \return the number of worker threads
+   */
+  uint32_t GetThreads (void) const;
+
+  /// Counters for the report.
+  struct Stats
+  {
+    uint64_t submitted; //!< Tasks submitted
+    uint64_t stolen;    //!< Tasks a worker took from another's queue
+    uint64_t inlined;   //!< Tasks run by Wait, no worker having got to them
+  };
+  /**
+   * \return the counters so far
+   */
+  Stats GetStats (void) const;
+
+private:
+  /// One worker's tasks; the owner takes the front, thieves the back.
+  struct Queue
+  {
+    std::deque<std::shared_ptr<Job> > jobs; //!< Tasks not yet taken off
+    std::mutex mutex;                       //!< Guards jobs
+  };
+
+  /**
+   * \brief Worker thread body
+   * \param self index of the worker's own queue
+   */
+  void Work (uint32_t self);
+  /**
+   * \brief Take a job off a queue
+   * \param self the queue to look in first
+   * \return the job, null if every queue was empty
+   */
+  std::shared_ptr<Job> Take (uint32_t self);
+  /**
+   * \brief Run a job unless another thread already started it
+   * \param job the job
+   * \return true if this call ran it
+   */
+  static bool Run (Job &job);
+
+  std::vector<std::unique_ptr<Queue> > m_queues; //!< One per worker, at least one
+  std::vector<std::thread> m_threads;  //!< Workers
+  std::mutex               m_idleMutex; //!< Orders wake-ups with m_queued and m_stopping
+  std::condition_variable  m_idle;     //!< Wakes workers for new tasks
+  std::atomic<uint64_t>    m_queued;   //!< Tasks in the queues
+  std::atomic<uint64_t>    m_submitted; //!< Tasks submitted
+  std::atomic<uint64_t>    m_stolen;   //!< Tasks stolen
+  std::atomic<uint64_t>    m_inlined;  //!< Tasks run by Wait
+  uint32_t                 m_next;     //!< Queue of the next task
+  bool                     m_stopping; //!< The destructor is waiting for the workers
+};
+
+} // namespace ns3
+
+#endif /* MFTP_WORK_POOL_H */
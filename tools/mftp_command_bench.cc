@@ -0,0 +1,289 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Fuzzer and throughput benchmark for the server's command parser in
+ * mftp_command.h.  Builds without ns-3:
+ *
+ *   g++ -O2 -std=c++11 -I.. -o mftp_command_bench mftp_command_bench.cc
+ *   ./mftp_command_bench [--fuzz N] [--bench N]
+ *
+ * Add -fsanitize=address,undefined to have the fuzz pass catch reads
+ * outside the command buffer.
+ */
+
+#include "mftp_command.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <time.h>
+
+namespace {
+
+/// Commands as clients send them.
+const char *g_samples[] = {
+  "GET little.txt\n\n", "GET giant.txt\n\n", "GET UNKNOWNFILE\n\n", "Foobar\n\n",
+  "MANIFEST huge.txt\n\n", "CHUNK huge.txt 12\n\n", "HAVE huge.txt 12 8081\n\n",
+  "DELTA big.txt 00000000deadbeef 0123456789abcdef\n\n", "CREDIT 3 65536\n\n",
+  "S4 GET big.txt\n\n", "S5 PUSHED huge.txt\n\n"
+};
+const size_t g_nSamples = sizeof (g_samples) / sizeof (g_samples[0]);
+
+uint32_t g_state = 12345;
+
+uint32_t
+Random (void)
+{
+  g_state = g_state * 1103515245 + 12345;
+  return g_state >> 8;
+}
+
+double
+Now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * The dispatch PacketSink used before mftp_command.h: prefix compares and
+ * a substr for the argument.
+ */
+MftpVerb
+ParseByCompare (const std::string &s, std::string &name)
+{
+  MftpVerb verb = MFTP_VERB_UNKNOWN;
+  size_t skip = 0;
+  if (0 == s.compare (0, 9, "MANIFEST "))
+    {
+      verb = MFTP_VERB_MANIFEST;
+      skip = 9;
+    }
+  else if (0 == s.compare (0, 6, "CHUNK "))
+    {
+      verb = MFTP_VERB_CHUNK;
+      skip = 6;
+    }
+  else if (0 == s.compare (0, 5, "HAVE "))
+    {
+      verb = MFTP_VERB_HAVE;
+      skip = 5;
+    }
+  else if (0 == s.compare (0, 7, "CREDIT "))
+    {
+      verb = MFTP_VERB_CREDIT;
+      skip = 7;
+    }
+  else if (0 == s.compare (0, 7, "PUSHED "))
+    {
+      verb = MFTP_VERB_PUSHED;
+      skip = 7;
+    }
+  else if (0 == s.compare (0, 6, "DELTA "))
+    {
+      verb = MFTP_VERB_DELTA;
+      skip = 6;
+    }
+  else if (0 == s.substr (0, 4).compare ("GET "))
+    {
+      verb = MFTP_VERB_GET;
+      skip = 4;
+    }
+  if (verb != MFTP_VERB_UNKNOWN)
+    {
+      name = s.substr (skip, s.size () - skip - 2);
+    }
+  return verb;
+}
+
+/*
+ * Check what the parser promises for any input: tokens stay inside the
+ * buffer and a recognised command really starts with its verb.
+ */
+bool
+Check (const char *data, uint32_t size)
+{
+  const char *start = data;
+  uint32_t stream = MftpParseStream (data, size);
+  if (data < start || (stream == 0) != (data == start))
+    {
+      return false;
+    }
+  MftpCommand command;
+  MftpVerb verb = MftpParseCommand (data, size, command);
+  if (verb != command.verb)
+    {
+      return false;
+    }
+  if (verb == MFTP_VERB_UNKNOWN)
+    {
+      return command.args.size == 0;
+    }
+  if (command.args.data < data || command.args.data + command.args.size > data + size
+      || command.args.size == 0 || memchr (command.args.data, '\n', command.args.size))
+    {
+      return false;
+    }
+  const MftpVerbName &name = g_mftpVerbs[verb - 1];
+  if (name.verb != verb || memcmp (data, name.name, name.length) != 0 || data[name.length] != ' ')
+    {
+      return false;
+    }
+
+  MftpToken rest = command.args;
+  MftpToken word;
+  uint64_t value;
+  while (MftpNextWord (rest, word))
+    {
+      if (word.size == 0 || word.data < command.args.data
+          || word.data + word.size > command.args.data + command.args.size)
+        {
+          return false;
+        }
+      MftpWordToNumber (word, 16, value);
+      MftpWordToNumber (word, 10, value);
+    }
+  return true;
+}
+
+uint64_t
+Fuzz (uint64_t iterations)
+{
+  const char alphabet[] = "GETDLAMNIFSCHUKVRPgetx0123456789abcdef \n\0\xff";
+  uint64_t failures = 0;
+  std::vector<char> buffer;
+  for (uint64_t i = 0; i < iterations; i++)
+    {
+      // half mutated samples, half random bytes
+      if (i % 2 == 0)
+        {
+          const char *sample = g_samples[Random () % g_nSamples];
+          buffer.assign (sample, sample + strlen (sample));
+          uint32_t edits = 1 + Random () % 4;
+          for (uint32_t e = 0; e < edits && !buffer.empty (); e++)
+            {
+              uint32_t at = Random () % buffer.size ();
+              switch (Random () % 3)
+                {
+                case 0:
+                  buffer[at] = alphabet[Random () % (sizeof (alphabet) - 1)];
+                  break;
+                case 1:
+                  buffer.erase (buffer.begin () + at);
+                  break;
+                default:
+                  buffer.insert (buffer.begin () + at, alphabet[Random () % (sizeof (alphabet) - 1)]);
+                  break;
+                }
+            }
+          // cut short, as a partial read would
+          buffer.resize (Random () % (buffer.size () + 1));
+        }
+      else
+        {
+          buffer.resize (Random () % 24);
+          for (size_t k = 0; k < buffer.size (); k++)
+            {
+              buffer[k] = alphabet[Random () % (sizeof (alphabet) - 1)];
+            }
+        }
+      // a separate allocation per input, so the sanitizer sees overruns
+      char *data = new char[buffer.size () + 1];
+      std::copy (buffer.begin (), buffer.end (), data);
+      if (!Check (data, buffer.size ()))
+        {
+          failures++;
+          if (failures <= 10)
+            {
+              std::cerr << "bad parse of '" << std::string (data, buffer.size ()) << "'" << std::endl;
+            }
+        }
+      delete [] data;
+    }
+  return failures;
+}
+
+void
+Bench (uint64_t iterations)
+{
+  std::vector<std::string> commands;
+  for (size_t i = 0; i < 1024; i++)
+    {
+      commands.push_back (g_samples[Random () % g_nSamples]);
+    }
+
+  uint64_t checksum = 0;
+  double start = Now ();
+  for (uint64_t i = 0; i < iterations; i++)
+    {
+      const std::string &s = commands[i & 1023];
+      const char *data = s.data ();
+      uint32_t size = s.size ();
+      MftpCommand command;
+      checksum += MftpParseStream (data, size);
+      checksum += MftpParseCommand (data, size, command) + command.args.size;
+    }
+  double table = Now () - start;
+
+  std::string name;
+  start = Now ();
+  for (uint64_t i = 0; i < iterations; i++)
+    {
+      const std::string &s = commands[i & 1023];
+      checksum += ParseByCompare (s, name) + name.size ();
+    }
+  double compare = Now () - start;
+
+  std::cout << "hashed table: " << iterations / table / 1e6 << " M commands/s" << std::endl;
+  std::cout << "compare chain: " << iterations / compare / 1e6 << " M commands/s" << std::endl;
+  std::cout << "(checksum " << checksum << ")" << std::endl;
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint64_t fuzz = 1000000;
+  uint64_t bench = 20000000;
+  for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg == "--fuzz" && i + 1 < argc)
+        {
+          fuzz = std::strtoull (argv[++i], 0, 10);
+        }
+      else if (arg == "--bench" && i + 1 < argc)
+        {
+          bench = std::strtoull (argv[++i], 0, 10);
+        }
+      else
+        {
+          std::cerr << "usage: " << argv[0] << " [--fuzz N] [--bench N]" << std::endl;
+          return 2;
+        }
+    }
+
+  uint64_t failures = Fuzz (fuzz);
+  std::cout << fuzz << " fuzzed commands, " << failures << " bad parses" << std::endl;
+  Bench (bench);
+  return failures == 0 ? 0 : 1;
+}
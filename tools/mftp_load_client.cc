@@ -0,0 +1,378 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Real-socket MiniFTP peer for runs with --emulate.  Builds without ns-3:
+ *
+ *   g++ -O2 -o mftp_load_client mftp_load_client.cc
+ *
+ * Drive the simulated server 0 through the TAP device:
+ *
+ *   ./mftp_load_client 10.1.1.1 8080 --connections 8 --rounds 50
+ *
+ * or stand in for a real server the simulated clients talk to
+ * (--emuTarget=host), listening on the host side of the TAP device:
+ *
+ *   ./mftp_load_client 10.1.1.13 8080 --serve
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+/// The commands MyApp sends by default.
+const char *g_commands[] = {
+  "Foobar", "GET UNKNOWNFILE", "GET little.txt",
+  "GET big.txt", "GET huge.txt", "GET giant.txt"
+};
+const size_t g_nCommands = sizeof (g_commands) / sizeof (g_commands[0]);
+
+double
+Now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool
+SendAll (int fd, const std::string &data)
+{
+  size_t done = 0;
+  while (done < data.size ())
+    {
+      ssize_t n = send (fd, data.data () + done, data.size () - done, 0);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n <= 0)
+        {
+          return false;
+        }
+      done += n;
+    }
+  return true;
+}
+
+/*
+ * Read one reply: "200 OK <len>\n\n<body>" or a bare status line, each
+ * followed by a NUL.  Leftover bytes stay in buffer.
+ */
+bool
+ReadReply (int fd, std::string &buffer, std::string &reply)
+{
+  for (;;)
+    {
+      std::string::size_type nul = buffer.find ('\0');
+      if (nul != std::string::npos)
+        {
+          reply = buffer.substr (0, nul);
+          buffer.erase (0, nul + 1);
+          return true;
+        }
+      char chunk[4096];
+      ssize_t n = recv (fd, chunk, sizeof (chunk), 0);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n <= 0)
+        {
+          return false;
+        }
+      buffer.append (chunk, n);
+    }
+}
+
+/*
+ * Read one command, terminated by a blank line and a NUL.
+ */
+bool
+ReadCommand (int fd, std::string &buffer, std::string &command)
+{
+  for (;;)
+    {
+      std::string::size_type end = buffer.find ("\n\n");
+      if (end != std::string::npos)
+        {
+          command = buffer.substr (0, end);
+          buffer.erase (0, end + 2);
+          // drop the NUL terminators
+          while (!buffer.empty () && buffer[0] == '\0')
+            {
+              buffer.erase (0, 1);
+            }
+          command.erase (std::remove (command.begin (), command.end (), '\0'), command.end ());
+          return true;
+        }
+      char chunk[4096];
+      ssize_t n = recv (fd, chunk, sizeof (chunk), 0);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n <= 0)
+        {
+          return false;
+        }
+      buffer.append (chunk, n);
+    }
+}
+
+double
+Percentile (const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty ())
+    {
+      return 0;
+    }
+  size_t i = std::min (sorted.size () - 1, (size_t) (p * sorted.size ()));
+  return sorted[i] * 1000;
+}
+
+/*
+ * Answer commands the way PacketSink does, one process per connection.
+ */
+int
+Serve (const sockaddr_in &addr)
+{
+  std::map<std::string, std::string> files;
+  files["little.txt"] = "A";
+  files["big.txt"] = "A big file.";
+  files["huge.txt"] = "An even bigger file.\nAnd more!";
+  files["giant.txt"] = "Jolly, Green";
+
+  int listener = socket (AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt (listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+  if (bind (listener, (const sockaddr *) &addr, sizeof (addr)) != 0
+      || listen (listener, 64) != 0)
+    {
+      std::perror ("listen");
+      return 1;
+    }
+  // children exit on their own; do not leave zombies
+  signal (SIGCHLD, SIG_IGN);
+  std::cout << "serving MiniFTP on " << inet_ntoa (addr.sin_addr)
+            << ":" << ntohs (addr.sin_port) << std::endl;
+
+  for (;;)
+    {
+      int fd = accept (listener, 0, 0);
+      if (fd < 0)
+        {
+          continue;
+        }
+      if (fork () != 0)
+        {
+          close (fd);
+          continue;
+        }
+      close (listener);
+      std::string buffer;
+      std::string command;
+      uint64_t served = 0;
+      while (ReadCommand (fd, buffer, command))
+        {
+          std::string reply;
+          if (command.compare (0, 4, "GET ") == 0)
+            {
+              std::map<std::string, std::string>::const_iterator f = files.find (command.substr (4));
+              if (f == files.end ())
+                {
+                  reply = "550 File Unavailable\n\n";
+                }
+              else
+                {
+                  char header[32];
+                  std::snprintf (header, sizeof (header), "200 OK %u\n\n", (unsigned) f->second.size ());
+                  reply = header + f->second;
+                }
+            }
+          else
+            {
+              reply = "202 Command Not Implemented\n\n";
+            }
+          reply.push_back ('\0');
+          if (!SendAll (fd, reply))
+            {
+              break;
+            }
+          served++;
+        }
+      std::cout << "connection closed after " << served << " commands" << std::endl;
+      close (fd);
+      _exit (0);
+    }
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 3)
+    {
+      std::cerr << "usage: " << argv[0]
+                << " <address> <port> [--connections N] [--rounds N] [--serve]" << std::endl;
+      return 2;
+    }
+
+  sockaddr_in addr;
+  std::memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons (std::atoi (argv[2]));
+  if (inet_pton (AF_INET, argv[1], &addr.sin_addr) != 1)
+    {
+      std::cerr << argv[1] << ": not an IPv4 address" << std::endl;
+      return 2;
+    }
+
+  unsigned connections = 1;
+  unsigned rounds = 1;
+  bool serve = false;
+  for (int i = 3; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg == "--connections" && i + 1 < argc)
+        {
+          connections = std::atoi (argv[++i]);
+        }
+      else if (arg == "--rounds" && i + 1 < argc)
+        {
+          rounds = std::atoi (argv[++i]);
+        }
+      else if (arg == "--serve")
+        {
+          serve = true;
+        }
+      else
+        {
+          std::cerr << "unknown option " << arg << std::endl;
+          return 2;
+        }
+    }
+  if (serve)
+    {
+      return Serve (addr);
+    }
+
+  // open every connection first so the server sees them concurrently,
+  // then send the command list over each one in turn
+  std::vector<int> fds;
+  for (unsigned c = 0; c < connections; c++)
+    {
+      int fd = socket (AF_INET, SOCK_STREAM, 0);
+      int one = 1;
+      setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+      if (connect (fd, (const sockaddr *) &addr, sizeof (addr)) != 0)
+        {
+          std::perror ("connect");
+          close (fd);
+          continue;
+        }
+      fds.push_back (fd);
+    }
+  if (fds.empty ())
+    {
+      return 1;
+    }
+
+  std::vector<double> latencies;
+  std::map<std::string, uint64_t> statuses;
+  std::vector<std::string> buffers (fds.size ());
+  uint64_t failed = 0;
+  double start = Now ();
+  for (unsigned r = 0; r < rounds; r++)
+    {
+      for (size_t c = 0; c < fds.size (); c++)
+        {
+          if (fds[c] < 0)
+            {
+              continue;
+            }
+          for (size_t k = 0; k < g_nCommands; k++)
+            {
+              std::string command = g_commands[k];
+              command += "\n\n";
+              command.push_back ('\0');
+              double sent = Now ();
+              std::string reply;
+              if (!SendAll (fds[c], command) || !ReadReply (fds[c], buffers[c], reply))
+                {
+                  failed++;
+                  close (fds[c]);
+                  fds[c] = -1;
+                  break;
+                }
+              latencies.push_back (Now () - sent);
+              statuses[reply.substr (0, 3)]++;
+            }
+        }
+    }
+  double elapsed = Now () - start;
+  for (size_t c = 0; c < fds.size (); c++)
+    {
+      if (fds[c] >= 0)
+        {
+          close (fds[c]);
+        }
+    }
+
+  std::sort (latencies.begin (), latencies.end ());
+  std::cout << latencies.size () << " replies over " << fds.size ()
+            << " connections in " << elapsed << " s";
+  if (elapsed > 0)
+    {
+      std::cout << " (" << latencies.size () / elapsed << " req/s)";
+    }
+  std::cout << ", " << failed << " connections failed" << std::endl;
+  if (!latencies.empty ())
+    {
+      double sum = 0;
+      for (size_t i = 0; i < latencies.size (); i++)
+        {
+          sum += latencies[i];
+        }
+      std::cout << "Latency (ms): mean " << sum / latencies.size () * 1000
+                << "  p50 " << Percentile (latencies, 0.50)
+                << "  p95 " << Percentile (latencies, 0.95)
+                << "  p99 " << Percentile (latencies, 0.99)
+                << "  max " << latencies.back () * 1000 << std::endl;
+    }
+  std::cout << "Reply status codes:" << std::endl;
+  for (std::map<std::string, uint64_t>::const_iterator i = statuses.begin (); i != statuses.end (); ++i)
+    {
+      std::cout << "  " << i->first << ": " << i->second << std::endl;
+    }
+  return 0;
+}
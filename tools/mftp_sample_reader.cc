@@ -0,0 +1,131 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/*
+ * Offline reader for the MiniFTP metrics time series written with
+ * --sampleInterval.  Prints one row per interval with the rates over it,
+ * then where the servers first queued requests, peaked and where the
+ * simulator ran slowest.  Builds without ns-3, and may be run on a
+ * series that is still being written:
+ *
+ *   g++ -O2 -I.. -o mftp_sample_reader mftp_sample_reader.cc
+ *   ./mftp_sample_reader project_4.samples
+ */
+
+#include "mftp_sample_format.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+int
+main (int argc, char *argv[])
+{
+  if (argc != 2)
+    {
+      std::cerr << "usage: " << argv[0] << " <sample file>" << std::endl;
+      return 2;
+    }
+
+  FILE *f = std::fopen (argv[1], "rb");
+  if (!f)
+    {
+      std::perror (argv[1]);
+      return 1;
+    }
+
+  MftpSampleFileHeader header;
+  if (std::fread (&header, sizeof (header), 1, f) != 1
+      || std::memcmp (header.magic, MFTP_SAMPLE_MAGIC, sizeof (header.magic)) != 0
+      || header.version != MFTP_SAMPLE_VERSION
+      || header.recordSize != sizeof (MftpSampleRecord))
+    {
+      std::cerr << argv[1] << ": not a MiniFTP sample series" << std::endl;
+      std::fclose (f);
+      return 1;
+    }
+
+  std::printf ("%10s %8s %7s %12s %6s %6s %6s %6s %10s %10s %10s %9s\n",
+               "time_s", "wall_s", "speed", "events/s", "conns", "send", "queue", "outst",
+               "rx_kbps", "tx_kbps", "client_kbps", "replies/s");
+
+  MftpSampleRecord last;
+  MftpSampleRecord r;
+  uint64_t records = 0;
+  int64_t firstQueued = -1;
+  double peakTx = 0;
+  int64_t peakTxAt = 0;
+  double slowest = -1;
+  int64_t slowestAt = 0;
+  while (std::fread (&r, sizeof (r), 1, f) == 1)
+    {
+      if (firstQueued < 0 && r.queueDepth > 0)
+        {
+          firstQueued = r.time;
+        }
+      if (records++ == 0)
+        {
+          last = r;
+          continue;
+        }
+      double sim = (r.time - last.time) / 1e9;
+      double wall = (r.wall - last.wall) / 1e9;
+      if (sim <= 0)
+        {
+          last = r;
+          continue;
+        }
+      // simulated seconds per wall-clock second
+      double speed = wall > 0 ? sim / wall : 0;
+      double tx = (r.serverTx - last.serverTx) * 8 / sim / 1000;
+      std::printf ("%10.3f %8.2f %7.2f %12.0f %6u %6u %6u %6u %10.1f %10.1f %10.1f %9.1f\n",
+                   r.time / 1e9, r.wall / 1e9, speed,
+                   wall > 0 ? (r.events - last.events) / wall : 0,
+                   r.connections, r.activeTransfers, r.queueDepth, r.outstanding,
+                   (r.serverRx - last.serverRx) * 8 / sim / 1000, tx,
+                   (r.clientRx - last.clientRx) * 8 / sim / 1000,
+                   (r.replies - last.replies) / sim);
+      if (tx > peakTx)
+        {
+          peakTx = tx;
+          peakTxAt = r.time;
+        }
+      if (wall > 0 && (slowest < 0 || speed < slowest))
+        {
+          slowest = speed;
+          slowestAt = r.time;
+        }
+      last = r;
+    }
+  std::fclose (f);
+
+  std::cout << records << " samples, every " << header.interval / 1e9 << "s" << std::endl;
+  if (firstQueued >= 0)
+    {
+      std::cout << "Requests first queued for a transfer slot at "
+                << firstQueued / 1e9 << "s" << std::endl;
+    }
+  if (peakTx > 0)
+    {
+      std::cout << "Peak server tx " << peakTx << " kbps in the interval ending at "
+                << peakTxAt / 1e9 << "s" << std::endl;
+    }
+  if (slowest >= 0)
+    {
+      std::cout << "Slowest interval: " << slowest << " simulated s per wall s, ending at "
+                << slowestAt / 1e9 << "s" << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,213 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Offline reader for the MiniFTP binary event log written with
+ * --tracing=binary.  Builds without ns-3:
+ *
+ *   g++ -O2 -I.. -o mftp_trace_reader mftp_trace_reader.cc
+ *   ./mftp_trace_reader project_4.mftp
+ */
+
+#include "mftp_trace_format.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// Per-node counters.
+struct NodeStats
+{
+  uint64_t requests;  //!< Client requests sent or server requests parsed
+  uint64_t replies;   //!< Replies completed
+  uint64_t rejects;   //!< Server rejections
+  uint64_t bytes;     //!< Reply bytes
+  NodeStats () : requests (0), replies (0), rejects (0), bytes (0) {}
+};
+
+double
+Percentile (const std::vector<int64_t> &sorted, double p)
+{
+  if (sorted.empty ())
+    {
+      return 0;
+    }
+  size_t i = std::min (sorted.size () - 1, (size_t) (p * sorted.size ()));
+  return sorted[i] / 1e6;
+}
+
+const char *
+EventName (uint8_t event)
+{
+  switch (event)
+    {
+    case MFTP_EV_REQUEST_START: return "request-start";
+    case MFTP_EV_REQUEST_END: return "request-end";
+    case MFTP_EV_SERVER_REQUEST: return "server-request";
+    case MFTP_EV_SERVER_REPLY: return "server-reply";
+    case MFTP_EV_ACCEPT: return "accept";
+    case MFTP_EV_REJECT: return "reject";
+    case MFTP_EV_CLOSE: return "close";
+    default: return "unknown";
+    }
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  if (argc != 2)
+    {
+      std::cerr << "usage: " << argv[0] << " <trace file>" << std::endl;
+      return 2;
+    }
+
+  FILE *f = std::fopen (argv[1], "rb");
+  if (!f)
+    {
+      std::perror (argv[1]);
+      return 1;
+    }
+
+  MftpTraceFileHeader header;
+  if (std::fread (&header, sizeof (header), 1, f) != 1
+      || std::memcmp (header.magic, MFTP_TRACE_MAGIC, sizeof (header.magic)) != 0
+      || header.version != MFTP_TRACE_VERSION
+      || header.recordSize != sizeof (MftpTraceRecord))
+    {
+      std::cerr << argv[1] << ": not a MiniFTP trace" << std::endl;
+      std::fclose (f);
+      return 1;
+    }
+
+  std::map<uint8_t, uint64_t> events;
+  std::map<uint32_t, NodeStats> clients;
+  std::map<uint32_t, NodeStats> servers;
+  std::map<uint16_t, uint64_t> statuses;
+  std::map<std::pair<uint32_t, uint32_t>, int64_t> started;
+  std::vector<int64_t> latencies;
+  int64_t first = 0;
+  int64_t last = 0;
+  uint64_t records = 0;
+
+  MftpTraceRecord buffer[4096];
+  size_t n;
+  while ((n = std::fread (buffer, sizeof (MftpTraceRecord), 4096, f)) > 0)
+    {
+      for (size_t i = 0; i < n; i++)
+        {
+          const MftpTraceRecord &r = buffer[i];
+          if (records++ == 0)
+            {
+              first = r.time;
+            }
+          last = r.time;
+          events[r.event]++;
+
+          std::pair<uint32_t, uint32_t> key (r.node, r.request);
+          switch (r.event)
+            {
+            case MFTP_EV_REQUEST_START:
+              clients[r.node].requests++;
+              started[key] = r.time;
+              break;
+            case MFTP_EV_REQUEST_END:
+              {
+                NodeStats &c = clients[r.node];
+                c.replies++;
+                c.bytes += r.bytes;
+                statuses[r.status]++;
+                std::map<std::pair<uint32_t, uint32_t>, int64_t>::iterator it = started.find (key);
+                if (it != started.end ())
+                  {
+                    latencies.push_back (r.time - it->second);
+                    started.erase (it);
+                  }
+              }
+              break;
+            case MFTP_EV_SERVER_REQUEST:
+              servers[r.node].requests++;
+              break;
+            case MFTP_EV_SERVER_REPLY:
+              servers[r.node].replies++;
+              servers[r.node].bytes += r.bytes;
+              break;
+            case MFTP_EV_REJECT:
+              servers[r.node].rejects++;
+              break;
+            default:
+              break;
+            }
+        }
+    }
+  std::fclose (f);
+
+  std::cout << records << " events from " << first / 1e9 << "s to "
+            << last / 1e9 << "s" << std::endl;
+  for (std::map<uint8_t, uint64_t>::const_iterator i = events.begin (); i != events.end (); ++i)
+    {
+      std::cout << "  " << EventName (i->first) << ": " << i->second << std::endl;
+    }
+
+  std::sort (latencies.begin (), latencies.end ());
+  double sum = 0;
+  for (size_t i = 0; i < latencies.size (); i++)
+    {
+      sum += latencies[i] / 1e6;
+    }
+  std::cout << "Requests completed: " << latencies.size ()
+            << ", unanswered: " << started.size () << std::endl;
+  if (!latencies.empty ())
+    {
+      std::cout << "Latency (ms): mean " << sum / latencies.size ()
+                << "  p50 " << Percentile (latencies, 0.50)
+                << "  p95 " << Percentile (latencies, 0.95)
+                << "  p99 " << Percentile (latencies, 0.99)
+                << "  max " << latencies.back () / 1e6 << std::endl;
+    }
+  std::cout << "Reply status codes:" << std::endl;
+  for (std::map<uint16_t, uint64_t>::const_iterator i = statuses.begin (); i != statuses.end (); ++i)
+    {
+      std::cout << "  " << i->first << ": " << i->second << std::endl;
+    }
+
+  double seconds = (last - first) / 1e9;
+  for (std::map<uint32_t, NodeStats>::const_iterator i = servers.begin (); i != servers.end (); ++i)
+    {
+      std::cout << "Server node " << i->first << ": " << i->second.requests
+                << " requests, " << i->second.replies << " replies, "
+                << i->second.rejects << " rejected, " << i->second.bytes << " B sent";
+      if (seconds > 0)
+        {
+          std::cout << " (" << i->second.bytes * 8 / seconds / 1000 << " kbps)";
+        }
+      std::cout << std::endl;
+    }
+  uint64_t clientBytes = 0;
+  for (std::map<uint32_t, NodeStats>::const_iterator i = clients.begin (); i != clients.end (); ++i)
+    {
+      clientBytes += i->second.bytes;
+    }
+  std::cout << clients.size () << " clients received " << clientBytes << " B" << std::endl;
+  return 0;
+}